@@ -8,35 +8,112 @@
 #include <fc/thread/future.hpp>
 #include <fc/io/iostream.hpp>
 
+#include <atomic>
+#include <type_traits>
+
 namespace fc { 
 /**
  *  @brief defines fc wrappers for boost::asio functions.
  */
 namespace asio {
+    /**
+     *  @brief memory for the operation object asio wraps around a completion
+     *  handler, reused from one operation to the next
+     *
+     *  Give a socket one per direction and pass it to read_some()/write_some(),
+     *  then steady state reads and writes do not allocate the operation; the
+     *  promise they complete comes from the recycled promise storage.  Only one
+     *  operation uses it at a time, one that finds it taken, or that does not
+     *  fit, is allocated the way asio normally does.
+     *
+     *  It is reference counted, every handler using it holds a reference, so
+     *  an operation that is aborted after its socket is gone still has the
+     *  memory to give back.
+     */
+    class handler_memory : public fc::retainable
+    {
+      public:
+        typedef fc::shared_ptr<handler_memory> ptr;
+
+        handler_memory():_in_use(false){}
+
+        /** @return the storage if it is free and big enough, otherwise nullptr */
+        void* try_allocate( size_t size )
+        {
+          if( size > sizeof(_storage) || _in_use.exchange(true) )
+            return nullptr;
+          return &_storage;
+        }
+
+        /** @return false if @p p is not this storage */
+        bool try_deallocate( void* p )
+        {
+          if( p != &_storage )
+            return false;
+          _in_use.store(false);
+          return true;
+        }
+
+      private:
+        handler_memory( const handler_memory& );
+        handler_memory& operator=( const handler_memory& );
+
+        std::aligned_storage<256>::type  _storage;
+        std::atomic<bool>                _in_use;
+    };
+
     /**
      *  @brief internal implementation types/methods for fc::asio
      */
     namespace detail {
         using namespace fc;
 
+        /** the asio_handler_allocate() hook of the handlers below */
+        template<typename Handler>
+        void* allocate_handler( const handler_memory::ptr& memory, size_t size, Handler* h )
+        {
+          void* p = memory ? memory->try_allocate( size ) : nullptr;
+          return p ? p : boost::asio::asio_handler_allocate( size, h );
+        }
+
+        template<typename Handler>
+        void deallocate_handler( const handler_memory::ptr& memory, void* p, size_t size, Handler* h )
+        {
+          if( !memory || !memory->try_deallocate( p ) )
+            boost::asio::asio_handler_deallocate( p, size, h );
+        }
+
         class read_write_handler
         {
         public:
-          read_write_handler(const promise<size_t>::ptr& p);
+          read_write_handler(const promise<size_t>::ptr& p, const handler_memory::ptr& memory = handler_memory::ptr());
           void operator()(const boost::system::error_code& ec, size_t bytes_transferred);
+
+          friend void* asio_handler_allocate( size_t size, read_write_handler* h )
+          { return allocate_handler( h->_memory, size, h ); }
+          friend void asio_handler_deallocate( void* p, size_t size, read_write_handler* h )
+          { deallocate_handler( h->_memory, p, size, h ); }
         private:
           promise<size_t>::ptr _completion_promise;
+          handler_memory::ptr  _memory;
         };
 
         class read_write_handler_with_buffer
         {
         public:
           read_write_handler_with_buffer(const promise<size_t>::ptr& p, 
-                                         const std::shared_ptr<const char>& buffer);
+                                         const std::shared_ptr<const char>& buffer,
+                                         const handler_memory::ptr& memory = handler_memory::ptr());
           void operator()(const boost::system::error_code& ec, size_t bytes_transferred);
+
+          friend void* asio_handler_allocate( size_t size, read_write_handler_with_buffer* h )
+          { return allocate_handler( h->_memory, size, h ); }
+          friend void asio_handler_deallocate( void* p, size_t size, read_write_handler_with_buffer* h )
+          { deallocate_handler( h->_memory, p, size, h ); }
         private:
           promise<size_t>::ptr _completion_promise;
           std::shared_ptr<const char> _buffer;
+          handler_memory::ptr  _memory;
         };
 
         //void read_write_handler( const promise<size_t>::ptr& p, 
@@ -54,7 +131,7 @@ namespace asio {
         template<typename C>
         struct non_blocking { 
           bool operator()( C& c ) { return c.non_blocking(); } 
-          bool operator()( C& c, bool s ) { c.non_blocking(s); return true; } 
+          bool operator()( C& c, bool s ) { boost::system::error_code ec; c.non_blocking(s, ec); return !ec; } 
         };
 
         #if WIN32  // windows stream handles do not support non blocking!
@@ -66,14 +143,126 @@ namespace asio {
         };
         #endif 
     }
+    namespace detail {
+        /**
+         *  Counts the reads and writes the calling thread tries without
+         *  waiting, every max_synchronous_io of them it yields, so a fiber on
+         *  a socket that always has data still lets the other fibers of its
+         *  thread run.
+         */
+        void pace_synchronous_io();
+        enum { max_synchronous_io = 16 };
+
+        /**
+         *  Reads what the kernel already has for @p s without waiting, switching
+         *  the stream to non blocking mode first if it supports that.  A
+         *  message that is already there then costs a system call instead of a
+         *  round trip through the io_service thread and a context switch.
+         *
+         *  @return the bytes read, 0 if the read would block or failed, the
+         *  caller then takes the async path, which also reports any error
+         */
+        template<typename Stream, typename Buffers>
+        size_t try_read_some( Stream& s, const Buffers& buf )
+        {
+          pace_synchronous_io();
+          if( !non_blocking<Stream>()( s ) && !non_blocking<Stream>()( s, true ) )
+            return 0;
+          boost::system::error_code ec;
+          const size_t bytes_read = s.read_some( buf, ec );
+          return ec ? 0 : bytes_read;
+        }
+
+        /** @see try_read_some() */
+        template<typename Stream, typename Buffers>
+        size_t try_write_some( Stream& s, const Buffers& buf )
+        {
+          pace_synchronous_io();
+          if( !non_blocking<Stream>()( s ) && !non_blocking<Stream>()( s, true ) )
+            return 0;
+          boost::system::error_code ec;
+          const size_t bytes_written = s.write_some( buf, ec );
+          return ec ? 0 : bytes_written;
+        }
+    }
+
     /**
      * @return the default boost::asio::io_service for use with fc::asio
      * 
      * This IO service is automatically running in its own thread to service asynchronous
-     * requests without blocking any other threads.
+     * requests without blocking any other threads.  It is the first io_service of the
+     * pool, see set_io_service_pool_size().
      */
     boost::asio::io_service& default_io_service(bool cleanup = false);
 
+    /** how socket_io_service() spreads sockets over the io_services */
+    enum io_service_assignment
+    {
+       by_thread,   ///< every socket of an fc::thread uses the io_service that thread was given first
+       round_robin  ///< each new socket takes the next io_service
+    };
+
+    /**
+     *  @brief runs fc::asio on @p threads io_services, each with an OS thread of its own
+     *
+     *  With a single io_service, the default, the completion handlers of every
+     *  socket in the process run on one thread.  More of them let network I/O
+     *  use more cores.  Completions still set promises, so the fibers waiting on
+     *  a socket keep running on their own fc::thread either way.
+     *
+     *  by_thread keeps all the sockets of an fc::thread on one I/O thread, the
+     *  fc::threads being handed out round robin; round_robin spreads the sockets
+     *  of a single busy fc::thread too.
+     *
+     *  @throws invalid_operation_exception once any fc::asio io_service is in
+     *  use, call it at startup before doing any networking
+     */
+    void set_io_service_pool_size( uint32_t threads, io_service_assignment assignment = by_thread );
+
+    /** @return the number of io_services fc::asio runs */
+    uint32_t io_service_pool_size();
+
+    /**
+     *  @return the io_service a new socket of the calling fc::thread should use,
+     *  default_io_service() unless set_io_service_pool_size() asked for more
+     */
+    boost::asio::io_service& socket_io_service();
+
+    /**
+     *  @brief pins the threads that run fc::asio's io_services to @p cpus
+     *
+     *  With the fc::threads pinned elsewhere this gives I/O completions cores
+     *  of their own.  Waits until the I/O threads have pinned themselves.
+     *  @see fc::thread::set_cpu_affinity()
+     */
+    void set_io_thread_affinity( const std::vector<uint32_t>& cpus );
+
+    /**
+     *  @brief keeps the threads that run fc::asio's io_services on NUMA node
+     *  @p node, pinned to the node's cpus and preferring its memory
+     *  @see fc::thread::set_numa_node()
+     */
+    void set_io_thread_numa_node( uint32_t node );
+
+    /** what fc::tcp_socket reads and writes with */
+    enum class io_backend
+    {
+       reactor,  ///< boost::asio's reactor on the io_services above, the default
+       io_uring  ///< the ring of fc/io/uring.hpp, Linux only
+    };
+
+    /**
+     *  @brief selects the backend fc::tcp_socket reads and writes with
+     *
+     *  Stays with the reactor if @p backend is io_uring and fc::uring::available()
+     *  is false.  Connecting and accepting go through boost::asio either way.
+     *  Open sockets switch at their next read or write.
+     *
+     *  @return the backend now in use
+     */
+    io_backend set_io_backend( io_backend backend );
+    io_backend io_backend_in_use();
+
     /** 
      *  @brief wraps boost::asio::async_read
      *  @pre s.non_blocking() == true
@@ -101,6 +290,8 @@ namespace asio {
     template<typename AsyncReadStream, typename MutableBufferSequence>
     future<size_t> read_some(AsyncReadStream& s, const MutableBufferSequence& buf)
     {
+      if( size_t bytes_read = detail::try_read_some( s, buf ) )
+        return make_ready_future( bytes_read );
       promise<size_t>::ptr completion_promise(new promise<size_t>("fc::asio::async_read_some"));
       s.async_read_some(buf, detail::read_write_handler(completion_promise));
       return completion_promise;//->wait();
@@ -109,21 +300,49 @@ namespace asio {
     template<typename AsyncReadStream>
     future<size_t> read_some(AsyncReadStream& s, char* buffer, size_t length, size_t offset = 0)
     {
+      if( size_t bytes_read = detail::try_read_some( s, boost::asio::buffer(buffer + offset, length) ) )
+        return make_ready_future( bytes_read );
       promise<size_t>::ptr completion_promise(new promise<size_t>("fc::asio::async_read_some"));
       s.async_read_some(boost::asio::buffer(buffer + offset, length), 
                         detail::read_write_handler(completion_promise));
       return completion_promise;//->wait();
     }
 
+    /** like read_some(s,buffer,length), asio's operation lives in @p memory if it is free */
+    template<typename AsyncReadStream>
+    future<size_t> read_some(AsyncReadStream& s, char* buffer, size_t length, const handler_memory::ptr& memory)
+    {
+      if( size_t bytes_read = detail::try_read_some( s, boost::asio::buffer(buffer, length) ) )
+        return make_ready_future( bytes_read );
+      promise<size_t>::ptr completion_promise(new promise<size_t>("fc::asio::async_read_some"));
+      s.async_read_some(boost::asio::buffer(buffer, length), 
+                        detail::read_write_handler(completion_promise, memory));
+      return completion_promise;
+    }
+
     template<typename AsyncReadStream>
     future<size_t> read_some(AsyncReadStream& s, const std::shared_ptr<char>& buffer, size_t length, size_t offset)
     {
+      if( size_t bytes_read = detail::try_read_some( s, boost::asio::buffer(buffer.get() + offset, length) ) )
+        return make_ready_future( bytes_read );
       promise<size_t>::ptr completion_promise(new promise<size_t>("fc::asio::async_read_some"));
       s.async_read_some(boost::asio::buffer(buffer.get() + offset, length), 
                         detail::read_write_handler_with_buffer(completion_promise, buffer));
       return completion_promise;//->wait();
     }
 
+    template<typename AsyncReadStream>
+    future<size_t> read_some(AsyncReadStream& s, const std::shared_ptr<char>& buffer, size_t length, size_t offset,
+                             const handler_memory::ptr& memory)
+    {
+      if( size_t bytes_read = detail::try_read_some( s, boost::asio::buffer(buffer.get() + offset, length) ) )
+        return make_ready_future( bytes_read );
+      promise<size_t>::ptr completion_promise(new promise<size_t>("fc::asio::async_read_some"));
+      s.async_read_some(boost::asio::buffer(buffer.get() + offset, length), 
+                        detail::read_write_handler_with_buffer(completion_promise, buffer, memory));
+      return completion_promise;
+    }
+
     template<typename AsyncReadStream, typename MutableBufferSequence>
     void async_read_some(AsyncReadStream& s, const MutableBufferSequence& buf, promise<size_t>::ptr completion_promise)
     {
@@ -170,27 +389,64 @@ namespace asio {
      */
     template<typename AsyncWriteStream, typename ConstBufferSequence>
     future<size_t> write_some( AsyncWriteStream& s, const ConstBufferSequence& buf ) {
+        if( size_t bytes_written = detail::try_write_some( s, buf ) )
+          return make_ready_future( bytes_written );
         promise<size_t>::ptr p(new promise<size_t>("fc::asio::write_some"));
         s.async_write_some( buf, detail::read_write_handler(p));
         return p; //->wait();
     }
 
+    /** like write_some(s,buf), asio's operation lives in @p memory if it is free */
+    template<typename AsyncWriteStream, typename ConstBufferSequence>
+    future<size_t> write_some( AsyncWriteStream& s, const ConstBufferSequence& buf, const handler_memory::ptr& memory ) {
+        if( size_t bytes_written = detail::try_write_some( s, buf ) )
+          return make_ready_future( bytes_written );
+        promise<size_t>::ptr p(new promise<size_t>("fc::asio::write_some"));
+        s.async_write_some( buf, detail::read_write_handler(p, memory));
+        return p;
+    }
+
     template<typename AsyncWriteStream>
     future<size_t> write_some( AsyncWriteStream& s, const char* buffer, 
                                size_t length, size_t offset = 0) {
+        if( size_t bytes_written = detail::try_write_some( s, boost::asio::buffer(buffer + offset, length) ) )
+          return make_ready_future( bytes_written );
         promise<size_t>::ptr p(new promise<size_t>("fc::asio::write_some"));
         s.async_write_some( boost::asio::buffer(buffer + offset, length), detail::read_write_handler(p));
         return p; //->wait();
     }
 
+    /** like write_some(s,buffer,length), asio's operation lives in @p memory if it is free */
+    template<typename AsyncWriteStream>
+    future<size_t> write_some( AsyncWriteStream& s, const char* buffer, 
+                               size_t length, const handler_memory::ptr& memory ) {
+        if( size_t bytes_written = detail::try_write_some( s, boost::asio::buffer(buffer, length) ) )
+          return make_ready_future( bytes_written );
+        promise<size_t>::ptr p(new promise<size_t>("fc::asio::write_some"));
+        s.async_write_some( boost::asio::buffer(buffer, length), detail::read_write_handler(p, memory));
+        return p;
+    }
+
     template<typename AsyncWriteStream>
     future<size_t> write_some( AsyncWriteStream& s, const std::shared_ptr<const char>& buffer, 
                                size_t length, size_t offset ) {
+        if( size_t bytes_written = detail::try_write_some( s, boost::asio::buffer(buffer.get() + offset, length) ) )
+          return make_ready_future( bytes_written );
         promise<size_t>::ptr p(new promise<size_t>("fc::asio::write_some"));
         s.async_write_some( boost::asio::buffer(buffer.get() + offset, length), detail::read_write_handler_with_buffer(p, buffer));
         return p; //->wait();
     }
 
+    template<typename AsyncWriteStream>
+    future<size_t> write_some( AsyncWriteStream& s, const std::shared_ptr<const char>& buffer, 
+                               size_t length, size_t offset, const handler_memory::ptr& memory ) {
+        if( size_t bytes_written = detail::try_write_some( s, boost::asio::buffer(buffer.get() + offset, length) ) )
+          return make_ready_future( bytes_written );
+        promise<size_t>::ptr p(new promise<size_t>("fc::asio::write_some"));
+        s.async_write_some( boost::asio::buffer(buffer.get() + offset, length), detail::read_write_handler_with_buffer(p, buffer, memory));
+        return p;
+    }
+
     /**
     *  @pre s.non_blocking() == true
     *  @brief wraps boost::asio::async_write_some
@@ -261,19 +517,20 @@ namespace asio {
     {
        public:
           istream( std::shared_ptr<AsyncReadStream> str )
-          :_stream( fc::move(str) ){}
+          :_stream( fc::move(str) ),_memory( new handler_memory() ){}
 
           virtual size_t readsome( char* buf, size_t len )
           {
-             return fc::asio::read_some(*_stream, buf, len).wait();
+             return fc::asio::read_some(*_stream, buf, len, _memory).wait();
           }
           virtual size_t readsome( const std::shared_ptr<char>& buf, size_t len, size_t offset )
           {
-             return fc::asio::read_some(*_stream, buf, len, offset).wait();
+             return fc::asio::read_some(*_stream, buf, len, offset, _memory).wait();
           }
     
        private:
           std::shared_ptr<AsyncReadStream> _stream;
+          handler_memory::ptr              _memory;
     };
 
     template<typename AsyncWriteStream>
@@ -281,22 +538,23 @@ namespace asio {
     {
        public:
           ostream( std::shared_ptr<AsyncWriteStream> str )
-          :_stream( fc::move(str) ){}
+          :_stream( fc::move(str) ),_memory( new handler_memory() ){}
 
           virtual size_t writesome( const char* buf, size_t len )
           {
-             return fc::asio::write_some(*_stream, buf, len).wait();
+             return fc::asio::write_some(*_stream, buf, len, _memory).wait();
           }
     
           virtual size_t     writesome( const std::shared_ptr<const char>& buf, size_t len, size_t offset )
           {
-             return fc::asio::write_some(*_stream, buf, len, offset).wait();
+             return fc::asio::write_some(*_stream, buf, len, offset, _memory).wait();
           }
     
           virtual void       close(){ _stream->close(); }
           virtual void       flush() {}
        private:
           std::shared_ptr<AsyncWriteStream> _stream;
+          handler_memory::ptr               _memory;
     };
 
 
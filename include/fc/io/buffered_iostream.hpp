@@ -63,6 +63,8 @@ namespace fc
          */
         virtual size_t  writesome( const char* buf, size_t len );
         virtual size_t  writesome( const std::shared_ptr<const char>& buf, size_t len, size_t offset );
+        /** buffers all of @p buffers like the other writesome()s */
+        virtual size_t  writesome( const const_buffer* buffers, size_t count );
 
         virtual void close();
         virtual void flush();
@@ -2,6 +2,7 @@
 #include <fc/utility.hpp>
 #include <fc/string.hpp>
 #include <memory>
+#include <vector>
 
 namespace fc {
 
@@ -35,6 +36,16 @@ namespace fc {
   };
   typedef std::shared_ptr<istream> istream_ptr;
 
+  /** one piece of a gathered write, like a POSIX iovec */
+  struct const_buffer
+  {
+     const_buffer( const char* d = nullptr, size_t s = 0 ):data(d),size(s){}
+
+     const char* data;
+     size_t      size;
+  };
+  typedef std::vector<const_buffer> const_buffers;
+
   /**
    *  Provides a fc::thread friendly cooperatively multi-tasked stream that
    *  will block 'cooperatively' instead of hard blocking.
@@ -45,6 +56,15 @@ namespace fc {
        virtual ~ostream(){};
        virtual size_t     writesome( const char* buf, size_t len ) = 0;
        virtual size_t     writesome( const std::shared_ptr<const char>& buf, size_t len, size_t offset ) = 0;
+
+       /**
+        *  Writes as much of @p count buffers, in order, as the stream takes at
+        *  once.  Streams that can gather them into a single write override
+        *  this, the default writes from the first nonempty buffer only.
+        *
+        *  @return the bytes written, across buffer boundaries
+        */
+       virtual size_t     writesome( const const_buffer* buffers, size_t count );
        virtual void       close() = 0;
        virtual void       flush() = 0;
 
@@ -55,6 +75,10 @@ namespace fc {
         **/
        ostream&   write( const char* buf, size_t len );
        ostream&   write( const std::shared_ptr<const char>& buf, size_t len, size_t offset = 0 );
+
+       /** implemented in terms of the gathering writesome, guarantees all of @p buffers are sent */
+       ostream&   write_all( const const_buffer* buffers, size_t count );
+       ostream&   write_all( const const_buffers& buffers ) { return write_all( buffers.data(), buffers.size() ); }
   };
 
   typedef std::shared_ptr<ostream> ostream_ptr;
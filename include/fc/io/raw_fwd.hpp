@@ -22,7 +22,7 @@ namespace fc {
    template<typename... Types> class static_variant;
 
    template<typename IntType, typename EnumType> class enum_type;
-   namespace ip { class endpoint; }
+   namespace ip { class endpoint; class any_address; class any_endpoint; }
 
    namespace ecc { class public_key; class private_key; }
    namespace raw {
@@ -69,6 +69,10 @@ namespace fc {
     template<typename Stream> inline void unpack( Stream& s, path& v );
     template<typename Stream> inline void pack( Stream& s, const ip::endpoint& v );
     template<typename Stream> inline void unpack( Stream& s, ip::endpoint& v );
+    template<typename Stream> inline void pack( Stream& s, const ip::any_address& v );
+    template<typename Stream> inline void unpack( Stream& s, ip::any_address& v );
+    template<typename Stream> inline void pack( Stream& s, const ip::any_endpoint& v );
+    template<typename Stream> inline void unpack( Stream& s, ip::any_endpoint& v );
 
 
     template<typename Stream, typename T> void unpack( Stream& s, fc::optional<T>& v ); 
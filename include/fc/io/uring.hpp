@@ -0,0 +1,77 @@
+#pragma once
+#include <fc/thread/future.hpp>
+#include <fc/io/iostream.hpp>
+
+#include <memory>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace fc {
+/**
+ *  @brief socket and file I/O through a Linux io_uring
+ *
+ *  One ring serves the whole process.  Fibers put their requests on its
+ *  submission queue and wait on the returned futures, an OS thread of the
+ *  ring submits whatever has queued up in a single io_uring_enter() and sets
+ *  the promises of the completions, the way fc::asio's io_service threads do.
+ *  Under load the requests of many sockets share one system call and the
+ *  busy ring thread is never woken up.  An idle one is, which costs a single
+ *  connection more latency than the reactor.
+ *
+ *  Unlike the asio reactor, file reads and writes do not block the calling
+ *  thread either.
+ *
+ *  Every function throws invalid_operation_exception if available() is
+ *  false.  Select the ring for fc::tcp_socket with
+ *  fc::asio::set_io_backend().
+ */
+namespace uring {
+    /**
+     *  @return true if the kernel supports io_uring with what fc needs (Linux
+     *  5.7 or later), the ring is set up the first time this is called
+     */
+    bool available();
+
+    /** reads what a stream socket has, throws eof_exception once the peer closed it */
+    fc::future<size_t> recv( int fd, char* buf, size_t len );
+    fc::future<size_t> recv( int fd, const std::shared_ptr<char>& buf, size_t len, size_t offset );
+
+    fc::future<size_t> send( int fd, const char* buf, size_t len );
+    fc::future<size_t> send( int fd, const std::shared_ptr<const char>& buf, size_t len, size_t offset );
+    /** gathers @p count buffers into one sendmsg() */
+    fc::future<size_t> send( int fd, const const_buffer* buffers, size_t count );
+
+    /** pass as file offset to read or write at the file's position and advance it */
+    const uint64_t current_position = uint64_t(-1);
+
+    /**
+     *  Reads from or writes to a file at @p file_offset.  Requests in flight at
+     *  the same time may be carried out in any order, so writes that have to
+     *  land one after the other either wait for each other or give each its
+     *  own offset.
+     */
+    fc::future<size_t> read( int fd, char* buf, size_t len, uint64_t file_offset );
+    fc::future<size_t> write( int fd, const char* buf, size_t len, uint64_t file_offset );
+    fc::future<size_t> write( int fd, const std::shared_ptr<const char>& buf, size_t len, size_t offset, uint64_t file_offset );
+
+    /**
+     *  Registers @p buffers with the kernel, which then maps them once rather
+     *  than for every request.  Pass a buffer's index to read_fixed() or
+     *  write_fixed() along with memory inside of it.  Only one set can be
+     *  registered at a time.
+     */
+    void register_buffers( const std::vector<std::pair<char*,size_t>>& buffers );
+    void unregister_buffers();
+
+    fc::future<size_t> read_fixed( int fd, char* buf, size_t len, uint64_t file_offset, uint16_t buffer_index );
+    fc::future<size_t> write_fixed( int fd, const char* buf, size_t len, uint64_t file_offset, uint16_t buffer_index );
+
+    /**
+     *  Cancels every request on @p fd, they fail with an exception.  A request
+     *  in flight keeps the file open, call this before closing it.  Waits until
+     *  the ring has processed the cancellation, not for the requests' futures.
+     */
+    void cancel( int fd );
+
+} } // namespace fc::uring
@@ -4,7 +4,7 @@
 #include <memory>
 
 namespace fc { 
-  namespace ip { class endpoint; }
+  namespace ip { class endpoint; class any_endpoint; }
   class tcp_socket;
 
   namespace http {
@@ -47,6 +47,7 @@ namespace fc { namespace http {
          void on_connection( const on_connection_handler& handler);
          void listen( uint16_t port );
          void listen( const fc::ip::endpoint& ep );
+         void listen( const fc::ip::any_endpoint& ep );
          void start_accept();
 
       private:
@@ -65,6 +66,7 @@ namespace fc { namespace http {
          void on_connection( const on_connection_handler& handler);
          void listen( uint16_t port );
          void listen( const fc::ip::endpoint& ep );
+         void listen( const fc::ip::any_endpoint& ep );
          void start_accept();
 
       private:
@@ -5,6 +5,9 @@
 #include <fc/crypto/city.hpp>
 #include <fc/reflect/reflect.hpp>
 
+#include <array>
+#include <string.h>
+
 namespace fc {
 
   namespace ip {
@@ -71,6 +74,89 @@ namespace fc {
         address  _ip;
     };
 
+    /**
+     *  @brief an IPv4 or IPv6 address
+     *
+     *  address and endpoint stay IPv4 only, their raw form is part of existing
+     *  protocols.  An IPv4 address is kept as the IPv4 mapped IPv6 address
+     *  ::ffff:a.b.c.d, so a peer that reaches a dual stack socket over IPv4
+     *  compares equal to the same peer reached through an IPv4 socket.
+     */
+    class any_address {
+      public:
+        typedef std::array<unsigned char,16> bytes_type;
+
+        any_address();  ///< 0.0.0.0
+        any_address( const address& v4 );
+        explicit any_address( const bytes_type& v6 );
+        /** parses either dotted IPv4 or IPv6 notation */
+        explicit any_address( const fc::string& s );
+
+        static any_address v6_any();       ///< ::
+        static any_address v6_loopback();  ///< ::1
+
+        bool is_v4()const;  ///< also true for a v4 mapped IPv6 address
+        bool is_v6()const { return !is_v4(); }
+
+        /** @throws invalid_operation_exception unless is_v4() */
+        address            to_v4()const;
+        const bytes_type&  to_bytes()const { return _bytes; }
+
+        /** dotted notation for IPv4, RFC 5952 notation otherwise */
+        operator fc::string()const;
+
+        bool is_loopback_address()const;
+        /**
+         *  @return true for the private IPv4 ranges of address::is_private_address(),
+         *  IPv6 unique local addresses fc00::/7 and link local addresses fe80::/10
+         */
+        bool is_private_address()const;
+        /** 224.0.0.0/4 or ff00::/8 */
+        bool is_multicast_address()const;
+        /** !private & !multicast */
+        bool is_public_address()const;
+
+        friend bool operator==( const any_address& a, const any_address& b ) { return a._bytes == b._bytes; }
+        friend bool operator!=( const any_address& a, const any_address& b ) { return a._bytes != b._bytes; }
+        friend bool operator< ( const any_address& a, const any_address& b ) { return a._bytes <  b._bytes; }
+
+      private:
+        bytes_type _bytes;
+    };
+
+    /** @brief an IPv4 or IPv6 address and a port */
+    class any_endpoint {
+      public:
+        any_endpoint():_port(0){}
+        any_endpoint( const any_address& a, uint16_t p = 0 ):_ip(a),_port(p){}
+        any_endpoint( const endpoint& ep ):_ip(ep.get_address()),_port(ep.port()){}
+
+        /** converts "a.b.c.d:PORT" or "[IPv6]:PORT" to an endpoint */
+        static any_endpoint from_string( const string& s );
+        /** @return "a.b.c.d:PORT" or "[IPv6]:PORT" */
+        operator string()const;
+
+        void               set_port( uint16_t p ) { _port = p; }
+        uint16_t           port()const        { return _port; }
+        const any_address& get_address()const { return _ip; }
+
+        bool     is_v4()const { return _ip.is_v4(); }
+        bool     is_v6()const { return _ip.is_v6(); }
+        /** @throws invalid_operation_exception unless is_v4() */
+        endpoint to_v4()const { return endpoint( _ip.to_v4(), _port ); }
+
+        friend bool operator==( const any_endpoint& a, const any_endpoint& b ) { return a._port == b._port && a._ip == b._ip; }
+        friend bool operator!=( const any_endpoint& a, const any_endpoint& b ) { return !(a == b); }
+        friend bool operator< ( const any_endpoint& a, const any_endpoint& b )
+        {
+           return a._ip < b._ip || (a._ip == b._ip && a._port < b._port);
+        }
+
+      private:
+        any_address _ip;
+        uint16_t    _port;
+    };
+
   }
   class variant;
   void to_variant( const ip::endpoint& var,  variant& vo );
@@ -79,6 +165,12 @@ namespace fc {
   void to_variant( const ip::address& var,  variant& vo );
   void from_variant( const variant& var,  ip::address& vo );
 
+  void to_variant( const ip::any_endpoint& var,  variant& vo );
+  void from_variant( const variant& var,  ip::any_endpoint& vo );
+
+  void to_variant( const ip::any_address& var,  variant& vo );
+  void from_variant( const variant& var,  ip::any_address& vo );
+
 
   namespace raw 
   {
@@ -111,10 +203,42 @@ namespace fc {
        v = ip::endpoint(a,p);
     }
 
+    /** always the 16 bytes of the IPv6 form, IPv4 addresses are v4 mapped */
+    template<typename Stream> 
+    inline void pack( Stream& s, const ip::any_address& v )
+    {
+       s.write( (const char*)v.to_bytes().data(), v.to_bytes().size() );
+    }
+    template<typename Stream> 
+    inline void unpack( Stream& s, ip::any_address& v )
+    {
+       ip::any_address::bytes_type b;
+       s.read( (char*)b.data(), b.size() );
+       v = ip::any_address(b);
+    }
+
+    template<typename Stream> 
+    inline void pack( Stream& s, const ip::any_endpoint& v )
+    {
+       fc::raw::pack( s, v.get_address() );
+       fc::raw::pack( s, v.port() );
+    }
+    template<typename Stream> 
+    inline void unpack( Stream& s, ip::any_endpoint& v )
+    {
+       ip::any_address a;
+       uint16_t p;
+       fc::raw::unpack( s, a );
+       fc::raw::unpack( s, p );
+       v = ip::any_endpoint(a,p);
+    }
+
   }
 } // namespace fc
 FC_REFLECT_TYPENAME( fc::ip::address ) 
 FC_REFLECT_TYPENAME( fc::ip::endpoint ) 
+FC_REFLECT_TYPENAME( fc::ip::any_address ) 
+FC_REFLECT_TYPENAME( fc::ip::any_endpoint ) 
 namespace std
 {
     template<>
@@ -125,4 +249,17 @@ namespace std
            return fc::city_hash_size_t( (char*)&e, sizeof(e) );
        }
     };
+
+    template<>
+    struct hash<fc::ip::any_endpoint>
+    {
+       size_t operator()( const fc::ip::any_endpoint& e )const
+       {
+           char key[18];
+           memcpy( key, e.get_address().to_bytes().data(), 16 );
+           const uint16_t port = e.port();
+           memcpy( key + 16, &port, 2 );
+           return fc::city_hash_size_t( key, sizeof(key) );
+       }
+    };
 }
@@ -1,8 +1,44 @@
 #pragma once
 #include <fc/vector.hpp>
 #include <fc/network/ip.hpp>
+#include <fc/time.hpp>
+
+#include <functional>
 
 namespace fc
 {
+  /**
+   *  @defgroup resolve host name resolution
+   *
+   *  resolve() and resolve_any() share a process wide cache, see
+   *  set_resolve_cache_ttl().  Concurrent lookups of the same host wait on a
+   *  single query to the system resolver, and hosts in regular use are
+   *  refreshed in the background before they expire.
+   *  @{
+   */
+
+  /** @return the IPv4 addresses of @p host only */
   std::vector<fc::ip::endpoint> resolve( const std::string& host, uint16_t port );
+  /** @return the IPv4 and IPv6 addresses of @p host, in the resolver's order */
+  std::vector<fc::ip::any_endpoint> resolve_any( const std::string& host, uint16_t port );
+
+  /**
+   *  Sets how long the addresses of a host (default 60 seconds) and the
+   *  failure to resolve it (default 10 seconds) are kept.  The system
+   *  resolver does not report the DNS record's TTL, so these stand in for
+   *  it.  Zero only shares the lookups in flight.
+   */
+  void set_resolve_cache_ttl( const microseconds& ttl, const microseconds& negative_ttl );
+  /** forgets every cached answer, lookups in flight still complete */
+  void clear_resolve_cache();
+
+  /** returns the addresses of a host or throws when it cannot be resolved */
+  typedef std::function<std::vector<fc::ip::any_address>( const std::string& host )> host_resolver;
+  /**
+   *  Puts @p resolver in place of the system resolver behind the cache, it
+   *  is called on an fc::asio io_service thread.  An empty function goes
+   *  back to the system resolver.  Meant for tests.
+   */
+  void set_host_resolver( host_resolver resolver );
+  /** @} */
 }
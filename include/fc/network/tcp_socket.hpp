@@ -5,7 +5,7 @@
 #include <fc/time.hpp>
 
 namespace fc {
-  namespace ip { class endpoint; }
+  namespace ip { class endpoint; class any_endpoint; }
 
   class tcp_socket_io_hooks;
 
@@ -16,12 +16,19 @@ namespace fc {
       ~tcp_socket();
 
       void     connect_to( const fc::ip::endpoint& remote_endpoint );
+      /** opens the socket for the endpoint's address family if it is not open yet */
+      void     connect_to( const fc::ip::any_endpoint& remote_endpoint );
       void     bind( const fc::ip::endpoint& local_endpoint );
+      /** the socket has to be open() for the endpoint's address family */
+      void     bind( const fc::ip::any_endpoint& local_endpoint );
       void     enable_keep_alives(const fc::microseconds& interval);
       void set_io_hooks(tcp_socket_io_hooks* new_hooks);
       void set_reuse_address(bool enable = true); // set SO_REUSEADDR
+      /** throw if the socket is connected over IPv6, use the any_ versions for those */
       fc::ip::endpoint remote_endpoint() const;
       fc::ip::endpoint local_endpoint() const;
+      fc::ip::any_endpoint remote_any_endpoint() const;
+      fc::ip::any_endpoint local_any_endpoint() const;
 
       using istream::get;
       void get( char& c )
@@ -41,20 +48,22 @@ namespace fc {
       /// @{
       virtual size_t   writesome( const char* buffer, size_t len );
       virtual size_t   writesome(const std::shared_ptr<const char>& buffer, size_t len, size_t offset);
+      virtual size_t   writesome( const const_buffer* buffers, size_t count );
       virtual void     flush();
       virtual void     close();
       /// @}
 
-      void open();
+      /** opens an IPv4 socket, or an IPv6 one if @p v6 */
+      void open( bool v6 = false );
       bool   is_open()const;
 
     private:
       friend class tcp_server;
       class impl;
       #ifdef _WIN64
-      fc::fwd<impl,0x81> my;
+      fc::fwd<impl,0x99> my;
       #else
-      fc::fwd<impl,0x54> my;
+      fc::fwd<impl,0x6c> my;
       #endif
   };
   typedef std::shared_ptr<tcp_socket> tcp_socket_ptr;
@@ -71,7 +80,13 @@ namespace fc {
       void     set_reuse_address(bool enable = true); // set SO_REUSEADDR, call before listen
       void     listen( uint16_t port );
       void     listen( const fc::ip::endpoint& ep );
+      /**
+       *  Listens on an IPv4 or IPv6 endpoint.  Listening on :: also accepts
+       *  IPv4 connections where the system allows dual stack sockets.
+       */
+      void     listen( const fc::ip::any_endpoint& ep );
       fc::ip::endpoint get_local_endpoint() const;
+      fc::ip::any_endpoint get_local_any_endpoint() const;
       uint16_t get_port()const;
     private:
       // non copyable
@@ -1,4 +1,5 @@
 #include <boost/asio.hpp>
+#include <fc/io/iostream.hpp>
 #include <memory>
 
 namespace fc
@@ -11,5 +12,13 @@ namespace fc
     virtual size_t readsome(boost::asio::ip::tcp::socket& socket, const std::shared_ptr<char>& buffer, size_t length, size_t offset) = 0;
     virtual size_t writesome(boost::asio::ip::tcp::socket& socket, const char* buffer, size_t length) = 0;
     virtual size_t writesome(boost::asio::ip::tcp::socket& socket, const std::shared_ptr<const char>& buffer, size_t length, size_t offset) = 0;
+    /** gathers @p count buffers into one write, by default writes the first nonempty one like the above */
+    virtual size_t writesome(boost::asio::ip::tcp::socket& socket, const const_buffer* buffers, size_t count)
+    {
+      for( size_t i = 0; i < count; ++i )
+        if( buffers[i].size )
+          return writesome(socket, buffers[i].data, buffers[i].size);
+      return 0;
+    }
   };
 } // namesapce fc
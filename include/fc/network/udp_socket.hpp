@@ -1,13 +1,30 @@
 #pragma once
 #include <fc/utility.hpp>
 #include <fc/shared_ptr.hpp>
+#include <fc/network/ip.hpp>
 #include <memory>
 
 namespace fc {
-  namespace ip {
-    class endpoint;
-    class address;
-  }
+
+  /** @brief one datagram of udp_socket::receive_batch() or udp_socket::send_batch() */
+  struct udp_message {
+    udp_message():data(nullptr),size(0),segment_size(0),truncated(false){}
+    udp_message( char* d, size_t s ):data(d),size(s),segment_size(0),truncated(false){}
+
+    char*                 data;
+    /** the length to send, or the room in @c data, which receive_batch() replaces with what it received */
+    size_t                size;
+    /**
+     *  Non zero has send_batch() split @c data into datagrams of this size in
+     *  the kernel (UDP GSO).  receive_batch() sets it when GRO coalesced
+     *  datagrams of this size from one peer into @c data, 0 otherwise.
+     */
+    uint16_t              segment_size;
+    /** set by receive_batch() if the datagram did not fit and was cut off */
+    bool                  truncated;
+    /** where to send to, left default on a connected socket, or who sent it */
+    fc::ip::any_endpoint  endpoint;
+  };
 
   /**
    *  The udp_socket class has reference semantics, all copies will
@@ -19,21 +36,55 @@ namespace fc {
       udp_socket( const udp_socket& s );
       ~udp_socket();
 
-      void   open();
+      /**
+       *  Opens an IPv4 socket, or an IPv6 one if @p v6.  An IPv6 socket also
+       *  sends to and receives from IPv4 peers where the system allows dual
+       *  stack sockets.
+       */
+      void   open( bool v6 = false );
       void   set_receive_buffer_size( size_t s );
       void   bind( const fc::ip::endpoint& );
+      void   bind( const fc::ip::any_endpoint& );
+      /** the ip::endpoint versions throw if the datagram came from an IPv6 peer */
       size_t receive_from( char* b, size_t l, fc::ip::endpoint& from );
       size_t receive_from( const std::shared_ptr<char>& b, size_t l, fc::ip::endpoint& from );
+      size_t receive_from( char* b, size_t l, fc::ip::any_endpoint& from );
+      size_t receive_from( const std::shared_ptr<char>& b, size_t l, fc::ip::any_endpoint& from );
       size_t send_to( const char* b, size_t l, const fc::ip::endpoint& to ); 
       size_t send_to( const std::shared_ptr<const char>& b, size_t l, const fc::ip::endpoint& to ); 
+      size_t send_to( const char* b, size_t l, const fc::ip::any_endpoint& to ); 
+      size_t send_to( const std::shared_ptr<const char>& b, size_t l, const fc::ip::any_endpoint& to ); 
       void   close();
 
       void   set_multicast_enable_loopback( bool );
       void   set_reuse_address( bool );
       void   join_multicast_group( const fc::ip::address& a );
 
+      /**
+       *  Waits until at least one datagram has arrived, then takes as many
+       *  as are waiting, up to @p count, into the caller's buffers with a
+       *  single recvmmsg() on Linux.  Concurrent batches of one socket take
+       *  turns, each caller's datagrams land in its own buffers.
+       *  @return the number of messages filled in
+       */
+      size_t receive_batch( udp_message* messages, size_t count );
+      /**
+       *  Sends every message, as many per sendmmsg() as the socket takes,
+       *  waiting while its send buffer is full.
+       *  @return @p count
+       */
+      size_t send_batch( const udp_message* messages, size_t count );
+      /**
+       *  Lets the kernel coalesce datagrams of one peer (UDP GRO, Linux 5.0),
+       *  see udp_message::segment_size.  Throws if the system does not
+       *  support it.
+       */
+      void   set_gro( bool enable );
+
       void   connect( const fc::ip::endpoint& e );
+      void   connect( const fc::ip::any_endpoint& e );
       fc::ip::endpoint local_endpoint()const;
+      fc::ip::any_endpoint local_any_endpoint()const;
 
     private:
       class                impl;
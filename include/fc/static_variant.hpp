@@ -13,6 +13,7 @@
 #include <stdexcept>
 #include <typeinfo>
 #include <fc/exception/exception.hpp>
+#include <fc/reflect/typename.hpp>
 
 namespace fc {
 
@@ -428,5 +429,34 @@ struct visitor {
       s.visit( fc::to_static_variant( ar[1] ) ); 
    }
 
+  namespace detail {
+     template<typename... T> struct append_typenames;
+     template<> struct append_typenames<> { static void append( std::string& ) {} };
+     template<typename T, typename... Ts> struct append_typenames<T, Ts...>
+     {
+        static void append( std::string& n )
+        {
+           n += get_typename<T>::name();
+           if( sizeof...(Ts) )
+              n += ",";
+           append_typenames<Ts...>::append( n );
+        }
+     };
+  }
+
+  // the fallback for any type without a name of its own, static_variant and raw::unpack need one
   template<typename... T> struct get_typename<T...>  { static const char* name()   { return typeid(static_variant<T...>).name();   } };
+
+  template<typename... T> struct get_typename< static_variant<T...> >
+  {
+     static const char* name()
+     {
+        static std::string n = [](){
+           std::string composed( "fc::static_variant<" );
+           detail::append_typenames<T...>::append( composed );
+           return composed + ">";
+        }();
+        return n.c_str();
+     }
+  };
 } // namespace fc
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+namespace fc {
+
+  /**
+   *  @file fc/thread/affinity.hpp
+   *  @brief the machine's NUMA layout, for thread::set_numa_node() and
+   *  thread::set_cpu_affinity()
+   *
+   *  Cpus and nodes are numbered the way the OS numbers them.  A machine
+   *  without NUMA, or one where the layout cannot be read, has a single node 0
+   *  holding every cpu.
+   */
+
+  /** @return the number of NUMA nodes, at least 1 */
+  uint32_t numa_node_count();
+
+  /**
+   *  @return the cpus of NUMA node @p node
+   *  @throws invalid_arg_exception if there is no such node
+   */
+  std::vector<uint32_t> numa_node_cpus( uint32_t node );
+
+} // namespace fc
@@ -0,0 +1,201 @@
+#pragma once
+/**
+ *  @file fc/thread/coroutine.hpp
+ *  @brief stackless C++20 coroutines on top of fc::thread and fc::future
+ *
+ *  The rest of fc is C++11, everything in here is only defined when the
+ *  translation unit that includes it is compiled with coroutine support.
+ *
+ *  @code
+ *  fc::co_task<size_t> echo( tcp_socket& s ) {
+ *     char buf[1024];
+ *     size_t n = co_await fc::asio::read_some( s.get_socket(), buf, sizeof(buf) );
+ *     co_await fc::co_sleep( fc::milliseconds(10) );
+ *     co_return co_await fc::asio::write_some( s.get_socket(), buf, n );
+ *  }
+ *
+ *  fc::future<size_t> f = echo(sock);   // fibers can still wait() on it
+ *  @endcode
+ */
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <fc/thread/thread.hpp>
+#include <fc/exception/exception.hpp>
+
+#include <boost/atomic.hpp>
+#include <coroutine>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace fc {
+
+   namespace detail {
+      /**
+       *  Resumes a suspended coroutine on the fc::thread it suspended on, at most
+       *  once no matter how many parties race to do it.
+       */
+      struct coroutine_resumer
+      {
+         coroutine_resumer( std::coroutine_handle<> h )
+         :handle(h),owner(&fc::thread::current()),resumed(false){}
+
+         void resume()
+         {
+            if( resumed.exchange(true) )
+               return;
+            std::coroutine_handle<> h = handle;
+            owner->async( [h](){ h.resume(); }, "co_await resume" );
+         }
+
+         std::coroutine_handle<> handle;
+         fc::thread*             owner;
+         boost::atomic<bool>     resumed;
+      };
+
+      template<typename T>
+      struct future_awaiter
+      {
+         future<T> f;
+
+         bool await_ready()const { return f.ready(); }
+
+         void await_suspend( std::coroutine_handle<> h )
+         {
+            std::shared_ptr<coroutine_resumer> r = std::make_shared<coroutine_resumer>(h);
+            f.on_complete( [r]( auto&&... ){ r->resume(); } );
+            // the promise may have completed before the handler was installed
+            if( f.ready() )
+               r->resume();
+         }
+
+         typename std::decay<decltype(std::declval<future<T>&>().wait())>::type await_resume() { return f.wait(); }
+      };
+
+      template<typename T>
+      struct co_promise_base
+      {
+         typename promise<T>::ptr prom = typename promise<T>::ptr( new promise<T>("fc::co_task") );
+
+         std::suspend_never initial_suspend()noexcept { return {}; }
+         std::suspend_never final_suspend()noexcept   { return {}; }
+
+         void unhandled_exception()
+         {
+            try { throw; }
+            catch( const fc::exception& e )
+            {
+               prom->set_exception( e.dynamic_copy_exception() );
+            }
+            catch( const std::exception& e )
+            {
+               prom->set_exception( std::make_shared<fc::unhandled_exception>( FC_LOG_MESSAGE( warn, "unhandled exception: ${what}", ("what",e.what()) ) ) );
+            }
+            catch( ... )
+            {
+               prom->set_exception( std::make_shared<fc::unhandled_exception>( FC_LOG_MESSAGE( warn, "unhandled exception" ) ) );
+            }
+         }
+      };
+   }
+
+   /**
+    *  @brief return type of a coroutine that produces a T
+    *
+    *  The coroutine starts running as soon as it is called, on the calling
+    *  fc::thread, and every co_await resumes it on that same thread.  A co_task
+    *  converts to an fc::future<T>, so fiber code can wait() on it as usual,
+    *  and other coroutines can co_await it.
+    *
+    *  Named co_task because fc::task is the fiber task type used by async().
+    */
+   template<typename T = void>
+   class co_task
+   {
+      public:
+         struct promise_type : detail::co_promise_base<T>
+         {
+            co_task get_return_object() { return co_task( this->prom ); }
+            template<typename U>
+            void return_value( U&& v ) { this->prom->set_value( std::forward<U>(v) ); }
+         };
+
+         operator future<T>()const { return future<T>( _prom ); }
+         future<T> get_future()const { return future<T>( _prom ); }
+
+         detail::future_awaiter<T> operator co_await()const { return { future<T>( _prom ) }; }
+
+      private:
+         explicit co_task( const typename promise<T>::ptr& p ):_prom(p){}
+         typename promise<T>::ptr _prom;
+   };
+
+   template<>
+   class co_task<void>
+   {
+      public:
+         struct promise_type : detail::co_promise_base<void>
+         {
+            co_task get_return_object() { return co_task( this->prom ); }
+            void return_void() { this->prom->set_value(); }
+         };
+
+         operator future<void>()const { return future<void>( _prom ); }
+         future<void> get_future()const { return future<void>( _prom ); }
+
+         detail::future_awaiter<void> operator co_await()const { return { future<void>( _prom ) }; }
+
+      private:
+         explicit co_task( const promise<void>::ptr& p ):_prom(p){}
+         promise<void>::ptr _prom;
+   };
+
+   /**
+    *  co_await on any fc::future, including the ones returned by async(),
+    *  fc::asio::read_some() and fc::asio::write_some().  The coroutine resumes
+    *  on the thread it suspended on.
+    *
+    *  @note the thread the coroutine suspended on has to outlive the future, a
+    *        coroutine whose thread quits first is never resumed.
+    */
+   template<typename T>
+   detail::future_awaiter<T> operator co_await( future<T> f ) { return { std::move(f) }; }
+
+   /**
+    *  @brief the coroutine counterpart of fc::usleep() and fc::sleep_until()
+    *
+    *  If the thread quits before the sleep is over, the coroutine is resumed
+    *  while the thread shuts down and co_await throws fc::canceled_exception,
+    *  so its frame is unwound and its co_task fails instead of leaking.
+    */
+   struct co_sleep
+   {
+      explicit co_sleep( const microseconds& d ):until(time_point::now() + d),canceled(false){}
+      explicit co_sleep( const time_point& tp ):until(tp),canceled(false){}
+
+      bool await_ready()const { return until <= time_point::now(); }
+      void await_suspend( std::coroutine_handle<> h )
+      {
+         future<void> wake = fc::thread::current().schedule( [h](){ h.resume(); }, until, "co_sleep" );
+         // once the task ran, the frame (and *this) may be gone, only look at it when the task never ran
+         wake.on_complete( [this,h]( const fc::exception_ptr& e ){
+            if( e )
+            {
+               canceled = true;
+               h.resume();
+            }
+         } );
+      }
+      void await_resume()const
+      {
+         if( canceled )
+            FC_THROW_EXCEPTION( canceled_exception, "co_sleep canceled, the thread is quitting" );
+      }
+
+      time_point until;
+      bool       canceled;
+   };
+
+} // namespace fc
+
+#endif // __cpp_impl_coroutine
@@ -6,6 +6,12 @@
 #include <fc/thread/spin_yield_lock.hpp>
 #include <fc/optional.hpp>
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
 //#define FC_TASK_NAMES_ARE_MANDATORY 1
 #ifdef FC_TASK_NAMES_ARE_MANDATORY
 # define FC_TASK_NAME_DEFAULT_ARG
@@ -27,10 +33,17 @@ namespace fc {
   class thread;
 
   namespace detail {
+     /** storage for promises and tasks, recycled through per-thread free lists */
+     void* allocate_promise_storage( size_t size );
+     void  free_promise_storage( void* p, size_t size );
+
      class completion_handler {
        public:
+          completion_handler():next(nullptr){}
           virtual ~completion_handler(){};
           virtual void on_complete( const void* v, const fc::exception_ptr& e ) = 0;
+
+          completion_handler* next; // the handler installed after this one on the same promise
      };
      
      template<typename Functor, typename T>
@@ -72,6 +85,15 @@ namespace fc {
 
       void set_exception( const fc::exception_ptr& e );
 
+      /**
+       *  True if nobody can ever see the result: the caller holds the only
+       *  reference and no completion handler is installed.
+       */
+      bool unobserved()const { return retain_count() == 1 && !_compl; }
+
+      static void* operator new( size_t size ) { return detail::allocate_promise_storage( size ); }
+      static void  operator delete( void* p, size_t size ) { detail::free_promise_storage( p, size ); }
+
     protected:
       void _wait( const microseconds& timeout_us );
       void _wait_until( const time_point& timeout_us );
@@ -81,7 +103,14 @@ namespace fc {
       void _set_timeout();
       void _set_value(const void* v);
 
-      void _on_complete( detail::completion_handler* c );
+      /**
+       *  Adds @p c to the handlers that run, in the order they were added,
+       *  when the promise completes.
+       *  @return false if it already has, @p c is not taken and the caller runs it
+       */
+      bool _on_complete( detail::completion_handler* c );
+      /** runs and deletes a handler that _on_complete() did not take */
+      void _complete_now( detail::completion_handler* c, const void* v );
       ~promise_base();
 
     private:
@@ -102,7 +131,7 @@ namespace fc {
     private:
 #endif
       const char*                 _desc;
-      detail::completion_handler* _compl;
+      detail::completion_handler* _compl;  // the first of the handlers, linked through next
   };
 
   template<typename T = void> 
@@ -132,9 +161,15 @@ namespace fc {
         _set_value(&*result);
       }
 
+      /**
+       *  Calls @p c once the promise completes, right away if it already has.
+       *  Every handler installed runs, in the order they were installed.
+       */
       template<typename CompletionHandler>
       void on_complete( CompletionHandler&& c ) {
-        _on_complete( new detail::completion_handler_impl<CompletionHandler,T>(fc::forward<CompletionHandler>(c)) );
+        detail::completion_handler* h = new detail::completion_handler_impl<CompletionHandler,T>(fc::forward<CompletionHandler>(c));
+        if( !_on_complete( h ) )
+          _complete_now( h, result.valid() ? &*result : nullptr );
       }
     protected:
       optional<T> result;
@@ -158,14 +193,33 @@ namespace fc {
       void set_value(){ this->_set_value(nullptr); }
       void set_value( const void_t&  ) { this->_set_value(nullptr); }
 
+      /** @see promise<T>::on_complete() */
       template<typename CompletionHandler>
       void on_complete( CompletionHandler&& c ) {
-        _on_complete( new detail::completion_handler_impl<CompletionHandler,void>(fc::forward<CompletionHandler>(c)) );
+        detail::completion_handler* h = new detail::completion_handler_impl<CompletionHandler,void>(fc::forward<CompletionHandler>(c));
+        if( !_on_complete( h ) )
+          _complete_now( h, nullptr );
       }
     protected:
       ~promise(){}
   };
   
+  template<typename T> class future;
+
+  namespace detail {
+     /** posts @p f to @p t, lets future::then() target a thread without seeing fc::thread */
+     void run_on_thread( thread& t, std::function<void()> f, const char* desc );
+
+     /** fails @p p with the exception being handled, the way a task does */
+     void set_current_exception( promise_base& p );
+
+     template<typename R> struct continuation;
+  }
+
+  template<typename T>
+  future<typename std::decay<T>::type> make_ready_future( T&& v );
+  inline future<void> make_ready_future();
+  
   /**
    *  @brief a placeholder for the result of an asynchronous operation.
    *
@@ -176,7 +230,7 @@ namespace fc {
    *  'wait' method you could specify a CompletionHandler which is a method that takes
    *  two parameters, a const reference to the value and an exception_ptr.  If the
    *  exception_ptr is set, the value reference is invalid and accessing it is
-   *  'undefined'.  
+   *  'undefined'.  Or chain a continuation with then().
    *
    *  Promises have pointer semantics, futures have reference semantics that
    *  contain a shared pointer to a promise.
@@ -184,6 +238,8 @@ namespace fc {
   template<typename T> 
   class future {
     public:
+      typedef T value_type;
+
       future( const fc::shared_ptr<promise<T>>& p ):m_prom(p){}
       future( fc::shared_ptr<promise<T>>&& p ):m_prom(fc::move(p)){}
       future(const future<T>& f ) : m_prom(f.m_prom){}
@@ -208,8 +264,7 @@ namespace fc {
       /// @post ready()
       /// @throws timeout
       const T& wait_until( const time_point& tp )const {
-         if( m_prom )
-           return m_prom->wait_until(tp);
+         return m_prom->wait_until(tp);
       }
 
       bool valid()const { return !!m_prom;       }
@@ -244,12 +299,43 @@ namespace fc {
        * The given completion handler will be called from some
        * arbitrary thread and should not 'block'. Generally
        * it should post an event or start a new async operation.
+       * If the future is already complete it is called right away.
+       * Several handlers can be installed, they all run.
        */
       template<typename CompletionHandler>
       void on_complete( CompletionHandler&& c ) {
         m_prom->on_complete( fc::forward<CompletionHandler>(c) );
       }
+
+      /**
+       *  @pre valid()
+       *
+       *  Chains @p f, which takes a const T&, to run once this future has a
+       *  value, without a fiber waiting for it.  Returns a future for what @p f
+       *  returns; if @p f returns a future itself, the result completes when
+       *  that one does.  If this future fails, @p f does not run and the
+       *  result fails with the same exception.
+       *
+       *  @p f runs inline on whichever thread completes this future, or right
+       *  away if it is already complete, so it must not block.  Use the
+       *  overload taking a thread for anything that might.  A future can
+       *  have any number of continuations.
+       */
+      template<typename Functor>
+      auto then( Functor&& f ) -> typename detail::continuation<typename std::decay<decltype(f(std::declval<const T&>()))>::type>::future_type {
+        return _then( fc::forward<Functor>(f), nullptr );
+      }
+
+      /** like then(f), but @p f runs as a task on @p on */
+      template<typename Functor>
+      auto then( Functor&& f, thread& on ) -> typename detail::continuation<typename std::decay<decltype(f(std::declval<const T&>()))>::type>::future_type {
+        return _then( fc::forward<Functor>(f), &on );
+      }
+
     private:
+      template<typename Functor>
+      auto _then( Functor&& f, thread* on ) -> typename detail::continuation<typename std::decay<decltype(f(std::declval<const T&>()))>::type>::future_type;
+
       friend class thread;
       fc::shared_ptr<promise<T>> m_prom;
   };
@@ -257,6 +343,8 @@ namespace fc {
   template<>
   class future<void> {
     public:
+      typedef void value_type;
+
       future( const fc::shared_ptr<promise<void>>& p ):m_prom(p){}
       future( fc::shared_ptr<promise<void>>&& p ):m_prom(fc::move(p)){}
       future(const future<void>& f ) : m_prom(f.m_prom){}
@@ -311,9 +399,349 @@ namespace fc {
         m_prom->on_complete( fc::forward<CompletionHandler>(c) );
       }
 
+      /** @see future<T>::then(), @p f takes no arguments */
+      template<typename Functor>
+      auto then( Functor&& f ) -> typename detail::continuation<typename std::decay<decltype(f())>::type>::future_type {
+        return _then( fc::forward<Functor>(f), nullptr );
+      }
+
+      template<typename Functor>
+      auto then( Functor&& f, thread& on ) -> typename detail::continuation<typename std::decay<decltype(f())>::type>::future_type {
+        return _then( fc::forward<Functor>(f), &on );
+      }
+
     private:
+      template<typename Functor>
+      auto _then( Functor&& f, thread* on ) -> typename detail::continuation<typename std::decay<decltype(f())>::type>::future_type;
+
       friend class thread;
       fc::shared_ptr<promise<void>> m_prom;
   };
-} 
 
+  /**
+   *  @return a future that already holds @p v.
+   *
+   *  fc::future has no promise-less ready state, so this still allocates a
+   *  promise and completes it before anyone sees it.  The promise comes from
+   *  the calling thread's recycled promise storage, which keeps steady state
+   *  use off the heap, but it is an allocation all the same.
+   */
+  template<typename T>
+  future<typename std::decay<T>::type> make_ready_future( T&& v )
+  {
+     typename promise<typename std::decay<T>::type>::ptr p( new promise<typename std::decay<T>::type>( "fc::make_ready_future" ) );
+     p->set_value( fc::forward<T>(v) );
+     return future<typename std::decay<T>::type>( fc::move(p) );
+  }
+
+  inline future<void> make_ready_future()
+  {
+     promise<void>::ptr p( new promise<void>( "fc::make_ready_future" ) );
+     p->set_value();
+     return future<void>( fc::move(p) );
+  }
+
+  /** @return a future that has already failed with @p e */
+  template<typename T>
+  future<T> make_exceptional_future( const fc::exception_ptr& e )
+  {
+     typename promise<T>::ptr p( new promise<T>( "fc::make_exceptional_future" ) );
+     p->set_exception( e );
+     return future<T>( p );
+  }
+
+  namespace detail {
+     /**
+      *  How a continuation's result R becomes the future then() returns:
+      *  fulfill() completes a promise with it, ready() builds a future
+      *  directly when the continuation can run right away.
+      */
+     template<typename R>
+     struct continuation
+     {
+        typedef R                            value_type;
+        typedef future<R>                    future_type;
+        typedef typename promise<R>::ptr     promise_ptr;
+
+        template<typename F>
+        static void fulfill( const promise_ptr& p, F&& f )
+        {
+           try { p->set_value( f() ); }
+           catch( ... ) { set_current_exception( *p ); }
+        }
+
+        template<typename F>
+        static future_type ready( F&& f )
+        {
+           try { return make_ready_future( f() ); }
+           catch( ... )
+           {
+              promise_ptr p( new promise<R>( "fc::future::then" ) );
+              set_current_exception( *p );
+              return future_type( p );
+           }
+        }
+     };
+
+     template<>
+     struct continuation<void>
+     {
+        typedef void                         value_type;
+        typedef future<void>                 future_type;
+        typedef promise<void>::ptr           promise_ptr;
+
+        template<typename F>
+        static void fulfill( const promise_ptr& p, F&& f )
+        {
+           try { f(); p->set_value(); }
+           catch( ... ) { set_current_exception( *p ); }
+        }
+
+        template<typename F>
+        static future_type ready( F&& f )
+        {
+           try { f(); return make_ready_future(); }
+           catch( ... )
+           {
+              promise_ptr p( new promise<void>( "fc::future::then" ) );
+              set_current_exception( *p );
+              return future_type( p );
+           }
+        }
+     };
+
+     template<typename U>
+     void forward_result( future<U>& from, const typename promise<U>::ptr& to )
+     {
+        from.on_complete( [to]( const U& v, const fc::exception_ptr& e ) {
+           if( e ) to->set_exception( e ); else to->set_value( v );
+        } );
+     }
+
+     inline void forward_result( future<void>& from, const promise<void>::ptr& to )
+     {
+        from.on_complete( [to]( const fc::exception_ptr& e ) {
+           if( e ) to->set_exception( e ); else to->set_value();
+        } );
+     }
+
+     /** a continuation that returns a future completes the future then() returned when that one does */
+     template<typename U>
+     struct continuation< future<U> >
+     {
+        typedef U                            value_type;
+        typedef future<U>                    future_type;
+        typedef typename promise<U>::ptr     promise_ptr;
+
+        template<typename F>
+        static void fulfill( const promise_ptr& p, F&& f )
+        {
+           try
+           {
+              future<U> inner = f();
+              forward_result( inner, p );
+           }
+           catch( ... ) { set_current_exception( *p ); }
+        }
+
+        template<typename F>
+        static future_type ready( F&& f )
+        {
+           try { return f(); }
+           catch( ... )
+           {
+              promise_ptr p( new promise<U>( "fc::future::then" ) );
+              set_current_exception( *p );
+              return future_type( p );
+           }
+        }
+     };
+  }
+
+  template<typename T>
+  template<typename Functor>
+  auto future<T>::_then( Functor&& f, thread* on ) -> typename detail::continuation<typename std::decay<decltype(f(std::declval<const T&>()))>::type>::future_type
+  {
+     typedef detail::continuation<typename std::decay<decltype(f(std::declval<const T&>()))>::type> cont;
+     typedef typename std::decay<Functor>::type functor_type;
+
+     if( !on && m_prom->ready() && !m_prom->error() )
+     {
+        const T& v = m_prom->wait();
+        return cont::ready( [&](){ return f( v ); } );
+     }
+
+     typename cont::promise_ptr p( new promise<typename cont::value_type>( "fc::future::then" ) );
+     functor_type fn( fc::forward<Functor>(f) );
+     if( !on )
+     {
+        m_prom->on_complete( [p,fn]( const T& v, const fc::exception_ptr& e ) mutable {
+           if( e ) { p->set_exception( e ); return; }
+           cont::fulfill( p, [&](){ return fn( v ); } );
+        } );
+        return typename cont::future_type( p );
+     }
+
+     on_complete( [p,fn,on]( const T& v, const fc::exception_ptr& e ) {
+        if( e ) { p->set_exception( e ); return; }
+        T value( v );
+        detail::run_on_thread( *on, [p,fn,value]() mutable {
+           cont::fulfill( p, [&](){ return fn( value ); } );
+        }, "fc::future::then" );
+     } );
+     return typename cont::future_type( p );
+  }
+
+  template<typename Functor>
+  auto future<void>::_then( Functor&& f, thread* on ) -> typename detail::continuation<typename std::decay<decltype(f())>::type>::future_type
+  {
+     typedef detail::continuation<typename std::decay<decltype(f())>::type> cont;
+     typedef typename std::decay<Functor>::type functor_type;
+
+     if( !on && m_prom->ready() && !m_prom->error() )
+        return cont::ready( fc::forward<Functor>(f) );
+
+     typename cont::promise_ptr p( new promise<typename cont::value_type>( "fc::future::then" ) );
+     functor_type fn( fc::forward<Functor>(f) );
+     if( !on )
+     {
+        m_prom->on_complete( [p,fn]( const fc::exception_ptr& e ) mutable {
+           if( e ) { p->set_exception( e ); return; }
+           cont::fulfill( p, fn );
+        } );
+        return typename cont::future_type( p );
+     }
+
+     on_complete( [p,fn,on]( const fc::exception_ptr& e ) {
+        if( e ) { p->set_exception( e ); return; }
+        detail::run_on_thread( *on, [p,fn]() mutable { cont::fulfill( p, fn ); }, "fc::future::then" );
+     } );
+     return typename cont::future_type( p );
+  }
+
+  namespace detail {
+     template<typename T>
+     struct when_all_state
+     {
+        when_all_state( size_t n ):values(n),remaining(n),failed(false),prom( new promise<std::vector<T>>( "fc::when_all" ) ){}
+
+        std::vector<fc::optional<T>>                 values;
+        std::atomic<size_t>                          remaining;
+        std::atomic<bool>                            failed;
+        typename promise<std::vector<T>>::ptr        prom;
+
+        void done( size_t i, const T* v, const fc::exception_ptr& e )
+        {
+           if( e )
+           {
+              if( !failed.exchange(true) )
+                 prom->set_exception( e );
+           }
+           else
+              values[i] = *v;
+           if( --remaining == 0 && !failed )
+           {
+              std::vector<T> result;
+              result.reserve( values.size() );
+              for( auto& v : values )
+                 result.push_back( fc::move(*v) );
+              prom->set_value( fc::move(result) );
+           }
+        }
+     };
+
+     struct when_all_counter
+     {
+        when_all_counter( size_t n ):remaining(n),failed(false),prom( new promise<void>( "fc::when_all" ) ){}
+
+        std::atomic<size_t>  remaining;
+        std::atomic<bool>    failed;
+        promise<void>::ptr   prom;
+
+        void done( const fc::exception_ptr& e )
+        {
+           if( e && !failed.exchange(true) )
+              prom->set_exception( e );
+           if( --remaining == 0 && !failed )
+              prom->set_value();
+        }
+     };
+
+     template<typename T>
+     void watch( const std::shared_ptr<when_all_counter>& s, future<T> f )
+     {
+        f.on_complete( [s]( const T&, const fc::exception_ptr& e ){ s->done( e ); } );
+     }
+
+     inline void watch( const std::shared_ptr<when_all_counter>& s, future<void> f )
+     {
+        f.on_complete( [s]( const fc::exception_ptr& e ){ s->done( e ); } );
+     }
+
+     inline void watch_all( const std::shared_ptr<when_all_counter>& ) {}
+
+     template<typename F, typename... Fs>
+     void watch_all( const std::shared_ptr<when_all_counter>& s, const F& f, const Fs&... rest )
+     {
+        watch( s, f );
+        watch_all( s, rest... );
+     }
+  }
+
+  /**
+   *  @return a future for the values of all of @p futures, in order, that
+   *  fails as soon as any of them fails.  Ready if they all are, without
+   *  allocating anything but the vector.
+   */
+  template<typename T>
+  future<std::vector<T>> when_all( const std::vector<future<T>>& futures )
+  {
+     bool all_ready = true;
+     for( const auto& f : futures )
+        all_ready = all_ready && f.ready() && !f.error();
+     if( all_ready )
+     {
+        std::vector<T> values;
+        values.reserve( futures.size() );
+        for( const auto& f : futures )
+           values.push_back( f.wait() );
+        return make_ready_future( fc::move(values) );
+     }
+
+     std::shared_ptr<detail::when_all_state<T>> s = std::make_shared<detail::when_all_state<T>>( futures.size() );
+     for( size_t i = 0; i < futures.size(); ++i )
+     {
+        future<T> f( futures[i] );
+        f.on_complete( [s,i]( const T& v, const fc::exception_ptr& e ){ s->done( i, e ? nullptr : &v, e ); } );
+     }
+     return future<std::vector<T>>( s->prom );
+  }
+
+  /** @return a future that completes once all of @p futures have, or one of them fails */
+  inline future<void> when_all( const std::vector<future<void>>& futures )
+  {
+     bool all_ready = true;
+     for( const auto& f : futures )
+        all_ready = all_ready && f.ready() && !f.error();
+     if( all_ready )
+        return make_ready_future();
+
+     std::shared_ptr<detail::when_all_counter> s = std::make_shared<detail::when_all_counter>( futures.size() );
+     for( const auto& f : futures )
+        detail::watch( s, f );
+     return future<void>( s->prom );
+  }
+
+  /**
+   *  @return a future that completes once all of @p futures (of any types)
+   *  have, or one of them fails.  Their values are then read from the
+   *  futures themselves, which no longer block.
+   */
+  template<typename... Ts>
+  future<void> when_all( const future<Ts>&... futures )
+  {
+     std::shared_ptr<detail::when_all_counter> s = std::make_shared<detail::when_all_counter>( sizeof...(Ts) );
+     detail::watch_all( s, futures... );
+     return future<void>( s->prom );
+  }
+}
@@ -0,0 +1,214 @@
+#pragma once
+/**
+ *  @file fc/thread/parallel.hpp
+ *  @brief data parallel loops on a thread_pool
+ *
+ *  Every algorithm splits its range into chunks of at least @c grain_size
+ *  elements and runs each chunk as a task on @c pool, thread_pool::default_pool()
+ *  unless told otherwise.  The calling fiber waits on the chunks' futures, so
+ *  it yields to the other fibers of its thread instead of blocking it, and it
+ *  is fine to call these from a pool worker.  A range of no more than
+ *  @c grain_size elements runs right away on the calling fiber.
+ *
+ *  If a chunk throws, the algorithm still waits for all the others and then
+ *  rethrows the first exception.  The chunks use the caller's functors and
+ *  range, so a canceled caller also waits for every chunk to finish before
+ *  its canceled_exception propagates.
+ *
+ *  @code
+ *  std::vector<bool> valid( sigs.size() );
+ *  fc::parallel_for( size_t(0), sigs.size(), [&]( size_t i ){ valid[i] = verify( sigs[i] ); }, 16 );
+ *  @endcode
+ */
+#include <fc/thread/thread_pool.hpp>
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+namespace fc {
+
+  namespace detail {
+    /**
+     *  Waits for every future, then rethrows the first exception any of them
+     *  failed with.  Canceling the caller does not cut the wait short, it is
+     *  rethrown once every chunk is done with the caller's stack.
+     */
+    template<typename T>
+    void wait_all( std::vector<fc::future<T>>& futures )
+    {
+      std::exception_ptr first_error;
+      std::exception_ptr canceled;
+      for( auto& f : futures )
+      {
+        for( ;; )
+        {
+          try
+          {
+            f.wait();
+            break;
+          }
+          catch( const fc::canceled_exception& )
+          {
+            if( f.ready() ) // the chunk itself was canceled
+            {
+              if( !first_error )
+                first_error = std::current_exception();
+              break;
+            }
+            if( !canceled )
+              canceled = std::current_exception();
+            fc::detail::suspend_cancellation();
+          }
+          catch( ... )
+          {
+            if( !first_error )
+              first_error = std::current_exception();
+            break;
+          }
+        }
+      }
+      if( canceled )
+      {
+        fc::detail::resume_cancellation();
+        std::rethrow_exception( canceled );
+      }
+      if( first_error )
+        std::rethrow_exception( first_error );
+    }
+
+    /** a few chunks per worker balance the load without paying for a task per element */
+    inline size_t parallel_chunk_size( size_t n, size_t grain_size, const thread_pool& pool )
+    {
+      const size_t chunks = std::max<size_t>( 1, size_t(pool.size()) * 4 );
+      return std::max<size_t>( std::max<size_t>( grain_size, 1 ), (n + chunks - 1) / chunks );
+    }
+  }
+
+  /**
+   *  Calls <code>body(i)</code> for every @p i in [first,last).  @p Index is an
+   *  integer or a random access iterator.
+   */
+  template<typename Index, typename Body>
+  void parallel_for( Index first, Index last, Body&& body, size_t grain_size = 1,
+                     thread_pool& pool = thread_pool::default_pool() )
+  {
+    if( !(first < last) )
+      return;
+    const size_t n = size_t( last - first );
+    if( n <= grain_size )
+    {
+      for( ; first != last; ++first )
+        body( first );
+      return;
+    }
+
+    const size_t chunk = detail::parallel_chunk_size( n, grain_size, pool );
+    std::vector<fc::future<void>> done;
+    done.reserve( (n + chunk - 1) / chunk );
+    for( size_t begin = 0; begin < n; begin += chunk )
+    {
+      const size_t end = std::min( n, begin + chunk );
+      done.push_back( pool.async( [&body,first,begin,end](){
+        for( size_t i = begin; i < end; ++i )
+          body( Index( first + i ) );
+      }, "parallel_for" ) );
+    }
+    detail::wait_all( done );
+  }
+
+  /**
+   *  Combines <code>transform(x)</code> of every element of [first,last) with
+   *  @p reduce, starting from @p init, like std::transform_reduce.  @p reduce
+   *  must be associative, chunks are reduced on their own and their results
+   *  are folded into @p init in order.
+   */
+  template<typename Iterator, typename T, typename Reduce, typename Transform>
+  T parallel_transform_reduce( Iterator first, Iterator last, T init, Reduce&& reduce, Transform&& transform,
+                               size_t grain_size = 1, thread_pool& pool = thread_pool::default_pool() )
+  {
+    const size_t n = size_t( std::distance( first, last ) );
+    if( n <= grain_size )
+    {
+      for( ; first != last; ++first )
+        init = reduce( std::move(init), transform( *first ) );
+      return init;
+    }
+
+    const size_t chunk = detail::parallel_chunk_size( n, grain_size, pool );
+    std::vector<fc::future<T>> partial;
+    partial.reserve( (n + chunk - 1) / chunk );
+    for( size_t begin = 0; begin < n; begin += chunk )
+    {
+      const size_t end = std::min( n, begin + chunk );
+      partial.push_back( pool.async( [&reduce,&transform,first,begin,end](){
+        Iterator itr = first + begin;
+        T acc = transform( *itr );
+        for( size_t i = begin + 1; i < end; ++i )
+          acc = reduce( std::move(acc), transform( *++itr ) );
+        return acc;
+      }, "parallel_transform_reduce" ) );
+    }
+    detail::wait_all( partial );
+
+    for( auto& p : partial )
+      init = reduce( std::move(init), p.wait() );
+    return init;
+  }
+
+  /**
+   *  Sorts [first,last) with @p comp.  Chunks are sorted with std::sort in
+   *  parallel, then neighbouring runs are merged pairwise, each round of
+   *  merges in parallel, until one run is left.  Not stable.
+   */
+  template<typename Iterator, typename Compare = std::less<typename std::iterator_traits<Iterator>::value_type>>
+  void parallel_sort( Iterator first, Iterator last, Compare comp = Compare(), size_t grain_size = 1024,
+                      thread_pool& pool = thread_pool::default_pool() )
+  {
+    const size_t n = size_t( std::distance( first, last ) );
+    if( n <= grain_size )
+    {
+      std::sort( first, last, comp );
+      return;
+    }
+
+    // run i is [bounds[i],bounds[i+1])
+    const size_t chunk = detail::parallel_chunk_size( n, grain_size, pool );
+    std::vector<size_t> bounds;
+    for( size_t begin = 0; begin < n; begin += chunk )
+      bounds.push_back( begin );
+    bounds.push_back( n );
+
+    std::vector<fc::future<void>> done;
+    for( size_t i = 0; i + 1 < bounds.size(); ++i )
+    {
+      Iterator lo = first + bounds[i];
+      Iterator hi = first + bounds[i+1];
+      done.push_back( pool.async( [&comp,lo,hi](){ std::sort( lo, hi, comp ); }, "parallel_sort" ) );
+    }
+    detail::wait_all( done );
+
+    while( bounds.size() > 2 )
+    {
+      std::vector<size_t> merged;
+      done.clear();
+      size_t i = 0;
+      for( ; i + 2 < bounds.size(); i += 2 )
+      {
+        Iterator lo  = first + bounds[i];
+        Iterator mid = first + bounds[i+1];
+        Iterator hi  = first + bounds[i+2];
+        done.push_back( pool.async( [&comp,lo,mid,hi](){ std::inplace_merge( lo, mid, hi, comp ); }, "parallel_sort merge" ) );
+        merged.push_back( bounds[i] );
+      }
+      if( i + 1 < bounds.size() ) // an odd run out waits for the next round
+        merged.push_back( bounds[i] );
+      merged.push_back( n );
+      detail::wait_all( done );
+      bounds.swap( merged );
+    }
+  }
+
+} // namespace fc
@@ -0,0 +1,39 @@
+#pragma once
+#include <fc/thread/spin_yield_lock.hpp>
+#include <stdint.h>
+
+namespace fc {
+  namespace detail { struct lock_waiter; }
+
+  /**
+   *  @brief counting semaphore for fibers
+   *
+   *  wait() takes one permit, parking the calling fiber (not the OS thread)
+   *  until one is available.  post() adds permits and hands them to parked
+   *  fibers in the order they started waiting, a fiber that calls wait() later
+   *  cannot take a permit ahead of one that is already parked.  Fibers of
+   *  different fc::threads may share one semaphore.
+   */
+  class semaphore {
+    public:
+      explicit semaphore( uint32_t initial_count = 0 );
+      ~semaphore();
+
+      void wait();
+      bool try_wait();
+      void post( uint32_t count = 1 );
+
+    private:
+      semaphore( const semaphore& );
+      semaphore& operator=( const semaphore& );
+
+      void abandon( detail::lock_waiter& w );
+      void grant_waiters( detail::lock_waiter*& granted );
+
+      fc::spin_yield_lock   _lock;
+      uint32_t              _count;  // permits nobody is waiting for
+      detail::lock_waiter*  _head;   // FIFO of parked fibers
+      detail::lock_waiter*  _tail;
+  };
+
+} // namespace fc
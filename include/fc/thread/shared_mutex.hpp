@@ -0,0 +1,66 @@
+#pragma once
+#include <fc/thread/spin_yield_lock.hpp>
+#include <stdint.h>
+
+namespace fc {
+  namespace detail { struct lock_waiter; }
+
+  /**
+   *  @brief readers/writer lock for fibers
+   *
+   *  Any number of fibers may hold the lock shared, or one fiber may hold it
+   *  exclusively.  Like fc::mutex it never blocks the OS thread, a fiber that
+   *  has to wait is parked and the other fibers of its thread keep running.
+   *  Fibers of different fc::threads may share one shared_mutex.
+   *
+   *  Waiters are served strictly in the order they arrived: a reader that
+   *  arrives while a writer waits queues behind the writer, so a steady stream
+   *  of readers cannot starve writers.  When the lock frees up, the writer at
+   *  the front of the queue gets it, or every reader up to the next writer.
+   *  Queueing and handing over the lock are O(1) per waiter.
+   *
+   *  Unlike fc::mutex the lock is not recursive.
+   */
+  class shared_mutex {
+    public:
+      shared_mutex();
+      ~shared_mutex();
+
+      void lock();
+      bool try_lock();
+      void unlock();
+
+      void lock_shared();
+      bool try_lock_shared();
+      void unlock_shared();
+
+    private:
+      shared_mutex( const shared_mutex& );
+      shared_mutex& operator=( const shared_mutex& );
+
+      void abandon( detail::lock_waiter& w );
+      void grant_waiters( detail::lock_waiter*& granted );
+
+      fc::spin_yield_lock   _lock;
+      uint32_t              _readers;  // fibers holding the lock shared
+      bool                  _writer;   // true while a fiber holds it exclusively
+      detail::lock_waiter*  _head;     // FIFO of parked fibers
+      detail::lock_waiter*  _tail;
+  };
+
+  /**
+   *  Holds a lock shared for the duration of a scope, the counterpart of
+   *  fc::scoped_lock for shared_mutex::lock_shared().
+   */
+  template<typename T>
+  class shared_lock {
+    public:
+      shared_lock( T& l ):_lock(l) { _lock.lock_shared(); }
+      ~shared_lock()               { _lock.unlock_shared(); }
+    private:
+      shared_lock( const shared_lock& );
+      shared_lock& operator=( const shared_lock& );
+      T& _lock;
+  };
+
+} // namespace fc
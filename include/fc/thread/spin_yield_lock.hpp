@@ -1,4 +1,5 @@
 #pragma once
+#include <stdint.h>
 
 namespace fc {
   class microseconds;
@@ -6,16 +7,22 @@ namespace fc {
 
   /**
    *  @class spin_yield_lock
-   *  @brief modified spin-lock that yields on failure, but becomes a 'spin lock' 
-   *         if there are no other tasks to yield to.
+   *  @brief lock for short critical sections that spins briefly, then yields
+   *         to other fibers, then parks the OS thread.
    *
    *  This kind of lock is lighter weight than a full mutex, but potentially slower
    *  than a staight spin_lock.
    *
-   *  This spin_yield_lock does not block the current thread, but instead attempts to use
-   *  an atomic operation to aquire the lock.  If unsuccessful, then it yields to
-   *  other tasks before trying again. If there are no other tasks then yield is
-   *  a no-op and spin_yield_lock becomes a spin-lock.  
+   *  An uncontended lock() is a single compare-and-swap.  A contended one spins
+   *  on a plain load with exponential backoff for a bounded number of rounds.
+   *  If the lock is still taken, the waiter yields to the other fibers of its
+   *  thread.  That is all it does when the holder is another fiber of the same
+   *  thread, because only yielding lets that holder run.  When the holder is
+   *  on another OS thread, the waiter then parks on a futex (a condition
+   *  variable where there are no futexes) for at most a millisecond.  unlock()
+   *  wakes one parked waiter.
+   *
+   *  Debug builds count acquisitions and contention per lock, see get_stats().
    */
   class spin_yield_lock {
     public:
@@ -25,11 +32,29 @@ namespace fc {
       bool try_lock_until( const time_point& abs_time );
       void lock(); 
       void unlock(); 
+
+#ifndef NDEBUG
+      /** contention counters, only written by whoever holds the lock */
+      struct stats {
+        uint32_t acquisitions;
+        uint32_t contended;    // acquisitions that did not get the lock on the first try
+        uint32_t spins;        // backoff rounds spent waiting
+        uint32_t yields;       // times a waiter yielded to other fibers
+        uint32_t parks;        // times a waiter parked its OS thread
+      };
+      stats get_stats()const { return _stats; }
+#endif
       
     private:
-      enum lock_store {locked,unlocked};
-      int _lock;
+      void lock_contended();
+      void note_acquired( uint32_t spins, uint32_t yields, uint32_t parks );
+
+      enum lock_store {locked,unlocked,locked_parked};  // locked_parked: waiters may be parked
+      int      _lock;
+      uint32_t _owner;   // id of the OS thread holding the lock, 0 if none
+#ifndef NDEBUG
+      stats    _stats;
+#endif
   };
 
 } // namespace fc
-
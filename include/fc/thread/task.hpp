@@ -4,6 +4,8 @@
 #include <fc/aligned.hpp>
 #include <fc/fwd.hpp>
 
+#include <atomic>
+
 namespace fc {
   struct context;
   class spin_lock;
@@ -25,6 +27,25 @@ namespace fc {
       };
       void* get_task_specific_data(unsigned slot);
       void set_task_specific_data(unsigned slot, void* new_value, void(*cleanup)(void*));
+
+      /**
+       *  Intrusive link for a thread's timer wheel (see src/thread/timer_wheel.hpp),
+       *  next is null while the owner is not in a wheel.
+       */
+      template<typename Node>
+      struct timer_hook
+      {
+         timer_hook() :
+            prev(nullptr),
+            next(nullptr),
+            node(nullptr),
+            level(0)
+            {}
+         timer_hook* prev;
+         timer_hook* next;
+         Node*       node;
+         uint32_t    level;
+      };
    }
 
   class task_base : virtual public promise_base {
@@ -38,6 +59,10 @@ namespace fc {
       uint64_t    _posted_num;
       priority    _prio;
       time_point  _when;
+      time_point  _posted_time;   // when async() handed the task to a thread, for thread_metrics
+      std::atomic<thread*> _scheduled_on;  // thread whose timer wheel holds this task until _when, read by cancel() from any thread
+      size_t      _stack_size;    // stack the task asked for, 0 for FC_CONTEXT_STACK_SIZE
+      detail::timer_hook<task_base> _timer;
       void        _set_active_context(context*);
       context*    _active_context;
       task_base*  _next;
@@ -53,6 +78,7 @@ namespace fc {
       // thread/thread_private
       friend class thread;
       friend class thread_d;
+      friend class thread_pool;
       fwd<spin_lock,8> _spinlock;
 
       // avoid rtti info for every possible functor...
@@ -71,17 +97,27 @@ namespace fc {
     struct functor_destructor {
       static void destroy( void* v ) { ((T*)v)->~T(); }
     };
+    /*
+     *  If the thread running the task holds the only reference, the future was
+     *  dropped (fire and forget), and unless a continuation was chained onto it
+     *  nobody can ever look at the result, so skip storing it and waking waiters.
+     */
     template<typename T>
     struct functor_run {
       static void run( void* functor, void* prom ) {
-        ((promise<decltype((*((T*)functor))())>*)prom)->set_value( (*((T*)functor))() );
+        promise<decltype((*((T*)functor))())>* p = (promise<decltype((*((T*)functor))())>*)prom;
+        if( p->unobserved() )
+          (*((T*)functor))();
+        else
+          p->set_value( (*((T*)functor))() );
       }
     };
     template<typename T>
     struct void_functor_run {
       static void run( void* functor, void* prom ) {
         (*((T*)functor))();
-        ((promise<void>*)prom)->set_value();
+        if( !((promise<void>*)prom)->unobserved() )
+          ((promise<void>*)prom)->set_value();
       }
     };
   }
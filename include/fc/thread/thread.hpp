@@ -1,6 +1,8 @@
 #pragma once
 
+#ifndef FC_CONTEXT_STACK_SIZE
 #define FC_CONTEXT_STACK_SIZE (2048*1024)
+#endif
 
 #include <fc/thread/task.hpp>
 #include <fc/vector.hpp>
@@ -9,6 +11,7 @@
 namespace fc {
   class time_point;
   class microseconds;
+  class variant_object;
 
    namespace detail
    {
@@ -17,6 +20,15 @@ namespace fc {
       unsigned get_next_unused_task_storage_slot();
       void* get_task_specific_data(unsigned slot);
       void set_task_specific_data(unsigned slot, void* new_value, void(*cleanup)(void*));
+      struct lock_waiter;
+
+      /**
+       *  Clears the cancellation of the calling task, so it can go on waiting for
+       *  work that still uses its stack.  @return true if it had been canceled
+       */
+      bool suspend_cancellation();
+      /** cancels the calling task again, its next wait or yield throws canceled_exception */
+      void resume_cancellation();
    }
 
   class thread {
@@ -43,6 +55,30 @@ namespace fc {
        *  @brief associates a name with this thread.
        */
       void        set_name( const string& n );
+
+      /**
+       *  @brief pins this thread to @p cpus, numbered the way the OS numbers them
+       *
+       *  Can be called from any thread, it waits for this one to pin itself.
+       *  @throws invalid_operation_exception if the OS refuses or cannot pin threads
+       */
+      void        set_cpu_affinity( const std::vector<uint32_t>& cpus );
+
+      /**
+       *  @brief keeps this thread and the memory it allocates on NUMA node @p node
+       *
+       *  Pins the thread to the node's cpus (see fc/thread/affinity.hpp) and,
+       *  on Linux, makes the node its preferred memory node.  The fiber stacks and
+       *  promise blocks the thread has cached are let go, so the ones it uses from
+       *  now on are faulted in on the node, and the thread only recycles promise
+       *  blocks with other threads of the same node.  Stacks of fibers that
+       *  already exist stay where they are, so call this before giving the
+       *  thread work.
+       */
+      void        set_numa_node( uint32_t node );
+
+      /** @return the node given to set_numa_node(), -1 if none was */
+      int32_t     numa_node()const;
        
       const char* current_task_desc() const;
 
@@ -64,13 +100,18 @@ namespace fc {
        *
        *  @param f the operation to perform
        *  @param prio the priority relative to other tasks
+       *  @param stack_size the stack the task needs, 0 for FC_CONTEXT_STACK_SIZE.  Tasks
+       *         that spend most of their life blocked on I/O can ask for much less
+       *         (64KB is plenty for most) so many more of them fit in memory.
        */
       template<typename Functor>
-      auto async( Functor&& f, const char* desc FC_TASK_NAME_DEFAULT_ARG, priority prio = priority()) -> fc::future<decltype(f())> {
+      auto async( Functor&& f, const char* desc FC_TASK_NAME_DEFAULT_ARG, priority prio = priority(),
+                  size_t stack_size = 0 ) -> fc::future<decltype(f())> {
          typedef decltype(f()) Result;
          typedef typename fc::deduce<Functor>::type FunctorType;
          fc::task<Result,sizeof(FunctorType)>* tsk = 
               new fc::task<Result,sizeof(FunctorType)>( fc::forward<Functor>(f), desc );
+         tsk->_stack_size = stack_size;
          fc::future<Result> r(fc::shared_ptr< fc::promise<Result> >(tsk,true) );
          async_task(tsk,prio);
          return r;
@@ -119,6 +160,22 @@ namespace fc {
       bool is_current()const;
      
       priority current_priority()const;
+
+      /**
+       *  @brief scheduler counters for this thread
+       *
+       *  Queue depths, how long tasks waited before they started and how long
+       *  they ran (as power of two histograms in microseconds), fiber context
+       *  switches and the time the thread spent parked with nothing to do.
+       *
+       *  Can be called from any thread and does not wait for this one, so it
+       *  also works on a thread that is starved or stuck in a long task.
+       */
+      variant_object get_metrics()const;
+
+      /** writes get_metrics() to the logger named @p logger_name at info level */
+      void log_metrics( const char* logger_name = "default" )const;
+
       ~thread();
 
        template<typename T1, typename T2>
@@ -133,12 +190,16 @@ namespace fc {
       friend class promise_base;
       friend class task_base;
       friend class thread_d;
+      friend class thread_pool;
       friend class mutex;
+      friend struct detail::lock_waiter;
       friend void* detail::get_thread_specific_data(unsigned slot);
       friend void detail::set_thread_specific_data(unsigned slot, void* new_value, void(*cleanup)(void*));
       friend unsigned detail::get_next_unused_task_storage_slot();
       friend void* detail::get_task_specific_data(unsigned slot);
       friend void detail::set_task_specific_data(unsigned slot, void* new_value, void(*cleanup)(void*));
+      friend bool detail::suspend_cancellation();
+      friend void detail::resume_cancellation();
 #ifndef NDEBUG
       friend class non_preemptable_scope_check;
 #endif
@@ -160,6 +221,7 @@ namespace fc {
       void async_task( task_base* t, const priority& p, const time_point& tp );
 
       void notify_task_has_been_canceled();
+      void notify_scheduled_task_canceled(task_base* t);
       void unblock(fc::context* c);
 
       class thread_d* my;
@@ -198,8 +260,9 @@ namespace fc {
    int wait_any_until( std::vector<promise_base::ptr>&& v, const time_point& tp );
 
    template<typename Functor>
-   auto async( Functor&& f, const char* desc FC_TASK_NAME_DEFAULT_ARG, priority prio = priority()) -> fc::future<decltype(f())> {
-      return fc::thread::current().async( fc::forward<Functor>(f), desc, prio );
+   auto async( Functor&& f, const char* desc FC_TASK_NAME_DEFAULT_ARG, priority prio = priority(),
+               size_t stack_size = 0 ) -> fc::future<decltype(f())> {
+      return fc::thread::current().async( fc::forward<Functor>(f), desc, prio, stack_size );
    }
    template<typename Functor>
    auto schedule( Functor&& f, const fc::time_point& t, const char* desc FC_TASK_NAME_DEFAULT_ARG, priority prio = priority()) -> fc::future<decltype(f())> {
@@ -0,0 +1,92 @@
+#pragma once
+#include <fc/thread/thread.hpp>
+#include <memory>
+
+namespace fc {
+  class thread_pool_d;
+
+  /**
+   *  @class thread_pool
+   *  @brief a fixed set of fc::threads that share the work posted to them.
+   *
+   *  Every worker keeps a deque of tasks that have never started.  A worker
+   *  runs its own fibers and tasks first, then drains its deque, and when that
+   *  is empty it steals a task from the deque of another worker.  Once a task
+   *  has started running it stays on the worker that picked it up, so
+   *  everything that task waits on (futures, mutexes, sleeps) behaves exactly
+   *  as it does on a plain fc::thread.
+   *
+   *  The API mirrors fc::thread: async() and schedule() return an fc::future
+   *  that can be waited on from any fiber.
+   */
+  class thread_pool {
+    public:
+      /**
+       *  @param num_threads number of worker threads, 0 means one per hardware thread
+       *  @param name prefix for the names of the worker threads
+       */
+      thread_pool( uint32_t num_threads = 0, const std::string& name = "pool" );
+      ~thread_pool();
+
+      /**
+       *  Posts <code>f</code> to the pool and returns a future<T> that can be
+       *  used to wait on the result.  If called from one of this pool's workers
+       *  the task is queued on that worker, otherwise workers are picked round robin.
+       *
+       *  @note the pool's deques are FIFO, @p prio only orders the task relative
+       *        to the other tasks of the worker once it has been picked up.
+       */
+      template<typename Functor>
+      auto async( Functor&& f, const char* desc FC_TASK_NAME_DEFAULT_ARG, priority prio = priority()) -> fc::future<decltype(f())> {
+         typedef decltype(f()) Result;
+         typedef typename fc::deduce<Functor>::type FunctorType;
+         fc::task<Result,sizeof(FunctorType)>* tsk =
+              new fc::task<Result,sizeof(FunctorType)>( fc::forward<Functor>(f), desc );
+         fc::future<Result> r(fc::shared_ptr< fc::promise<Result> >(tsk,true) );
+         async_task(tsk,prio);
+         return r;
+      }
+
+      /**
+       *  Posts <code>f</code> to the pool once <code>when</code> has passed.
+       *  Until then the task waits on one of the workers' timers, after that it
+       *  can be stolen like any task posted with async().
+       */
+      template<typename Functor>
+      auto schedule( Functor&& f, const fc::time_point& when,
+                     const char* desc FC_TASK_NAME_DEFAULT_ARG, priority prio = priority()) -> fc::future<decltype(f())> {
+         typedef decltype(f()) Result;
+         typedef typename fc::deduce<Functor>::type FunctorType;
+         fc::task<Result,sizeof(FunctorType)>* tsk =
+              new fc::task<Result,sizeof(FunctorType)>( fc::forward<Functor>(f), desc );
+         fc::future<Result> r(fc::shared_ptr< fc::promise<Result> >(tsk,true) );
+         async_task(tsk,prio,when);
+         return r;
+      }
+
+      /**
+       *  @return the process wide pool that fc::parallel_for() and friends run
+       *  on, one worker per hardware thread, created on first use
+       */
+      static thread_pool& default_pool();
+
+      /** @return the number of worker threads */
+      uint32_t size()const;
+
+      /** @return worker @p i, for work that must be pinned to a single thread */
+      thread&  get_thread( uint32_t i );
+
+      /**
+       *  Cancels every task that has not started yet and stops all workers.
+       *  Called by the destructor.
+       */
+      void     quit();
+
+    private:
+      void async_task( task_base* t, const priority& p );
+      void async_task( task_base* t, const priority& p, const time_point& tp );
+
+      std::unique_ptr<thread_pool_d> my;
+  };
+
+} // namespace fc
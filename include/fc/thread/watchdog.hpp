@@ -0,0 +1,51 @@
+#pragma once
+#include <fc/time.hpp>
+#include <memory>
+
+namespace fc {
+  class variant_object;
+  namespace detail { class watchdog_impl; }
+
+  /**
+   *  @brief reports tasks that keep their fc::thread busy without yielding
+   *
+   *  fc::thread is cooperative, a task that never yields stalls every other
+   *  fiber on its thread.  While a watchdog exists it samples every fc::thread
+   *  from a separate OS thread.  When a task has been running for longer than
+   *  @p threshold since it last yielded, the watchdog logs its get_desc(), the
+   *  thread name and, on Linux, a backtrace of the stuck thread, once per stall.
+   *
+   *  Threads also add up how long each task description ran between yields
+   *  while any watchdog is running, see non_yielding_time().
+   *
+   *  @note the backtrace is taken by sending SIGURG to the stuck thread, a
+   *        blocking system call it is in may return early with EINTR.  Pass
+   *        capture_backtraces = false to avoid that.
+   *  @note the first backtrace installs a SIGURG handler that stays for the
+   *        life of the process.  It passes every SIGURG it did not ask for,
+   *        such as out-of-band TCP data, on to the handler the process had
+   *        before, so install your own SIGURG handler before the first
+   *        watchdog starts, or pass capture_backtraces = false.
+   */
+  class watchdog {
+    public:
+      watchdog( const microseconds& threshold = milliseconds(500),
+                const microseconds& check_interval = milliseconds(100),
+                bool capture_backtraces = true );
+      ~watchdog();
+
+      /**
+       *  @return one entry per task description with the total, longest and
+       *  number of stretches it ran without yielding, in microseconds, summed
+       *  over all threads since the first running watchdog started.
+       */
+      variant_object non_yielding_time()const;
+
+    private:
+      watchdog( const watchdog& );
+      watchdog& operator=( const watchdog& );
+
+      std::unique_ptr<detail::watchdog_impl> my;
+  };
+
+} // namespace fc
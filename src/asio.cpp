@@ -1,15 +1,19 @@
 #include <fc/asio.hpp>
 #include <fc/thread/thread.hpp>
+#include <fc/thread/affinity.hpp>
+#include <fc/io/uring.hpp>
 #include <boost/thread.hpp>
 #include <fc/log/logger.hpp>
 #include <fc/exception/exception.hpp>
+#include "thread/affinity.hpp"
 
 namespace fc {
   namespace asio {
     namespace detail {
 
-      read_write_handler::read_write_handler(const promise<size_t>::ptr& completion_promise) :
-        _completion_promise(completion_promise)
+      read_write_handler::read_write_handler(const promise<size_t>::ptr& completion_promise, const handler_memory::ptr& memory) :
+        _completion_promise(completion_promise),
+        _memory(memory)
       {
         // assert(false); // to detect anywhere we're not passing in a shared buffer
       }
@@ -24,9 +28,11 @@ namespace fc {
           _completion_promise->set_exception( fc::exception_ptr( new fc::exception( FC_LOG_MESSAGE( error, "${message} ", ("message", boost::system::system_error(ec).what())) ) ) );
       }
       read_write_handler_with_buffer::read_write_handler_with_buffer(const promise<size_t>::ptr& completion_promise,
-                                                                     const std::shared_ptr<const char>& buffer) :
+                                                                     const std::shared_ptr<const char>& buffer,
+                                                                     const handler_memory::ptr& memory) :
         _completion_promise(completion_promise),
-        _buffer(buffer)
+        _buffer(buffer),
+        _memory(memory)
       {}
       void read_write_handler_with_buffer::operator()(const boost::system::error_code& ec, size_t bytes_transferred)
       {
@@ -67,6 +73,15 @@ namespace fc {
             p->set_value(ec);
         }
 
+        void pace_synchronous_io()
+        {
+          static __thread uint32_t tried = 0;
+          if( ++tried < max_synchronous_io )
+            return;
+          tried = 0;
+          fc::yield();
+        }
+
         template<typename EndpointType, typename IteratorType>
         void resolve_handler(
                              const typename promise<std::vector<EndpointType> >::ptr& p,
@@ -90,19 +105,62 @@ namespace fc {
         }
     }
 
-    struct default_io_service_scope
-    {
-       boost::asio::io_service*          io;
-       boost::thread*                    asio_thread;
-       boost::asio::io_service::work*    the_work;
-
-       default_io_service_scope()
-       {
-            io           = new boost::asio::io_service();
-            the_work     = new boost::asio::io_service::work(*io);
-            asio_thread  = new boost::thread( [=]()
+    namespace {
+      /** what set_io_service_pool_size() asked for, read once by the pool's constructor */
+      struct pool_config
+      {
+         boost::mutex            lock;
+         uint32_t                size = 1;
+         io_service_assignment   assignment = by_thread;
+         bool                    started = false;
+      };
+
+      pool_config& get_pool_config()
+      {
+         static pool_config* config = new pool_config();
+         return *config;
+      }
+
+      /**
+       *  The io_services behind fc::asio, each run by an OS thread of its own.
+       *  The first one is default_io_service().
+       */
+      struct io_service_pool
+      {
+         struct runner
+         {
+            boost::asio::io_service*          io;
+            boost::asio::io_service::work*    the_work;
+            boost::thread*                    asio_thread;
+         };
+
+         std::vector<runner>      runners;
+         io_service_assignment    assignment;
+         boost::atomic<uint32_t>  next;   // round robin position
+
+         io_service_pool()
+         :next(0)
+         {
+            uint32_t size;
+            {
+               pool_config& config = get_pool_config();
+               boost::lock_guard<boost::mutex> guard( config.lock );
+               config.started = true;
+               size       = config.size;
+               assignment = config.assignment;
+            }
+            for( uint32_t i = 0; i < size; ++i )
+               runners.push_back( start( i == 0 ? std::string("asio") : "asio_" + std::to_string(i) ) );
+         }
+
+         static runner start( const std::string& name )
+         {
+            runner r;
+            boost::asio::io_service* io = r.io = new boost::asio::io_service();
+            r.the_work     = new boost::asio::io_service::work(*io);
+            r.asio_thread  = new boost::thread( [=]()
             {
-              fc::thread::current().set_name("asio");
+              fc::thread::current().set_name(name);
               while (!io->stopped())
               {
                 try
@@ -123,27 +181,134 @@ namespace fc {
                 }
               }
             });
-       }
+            return r;
+         }
+
+         void cleanup()
+         {
+            for( runner& r : runners )
+            {
+               delete r.the_work;
+               r.io->stop();
+            }
+            for( runner& r : runners )
+            {
+               r.asio_thread->join();
+               delete r.io;
+               delete r.asio_thread;
+            }
+         }
+      };
 
-       void cleanup()
-       {
-          delete the_work;
-          io->stop();
-          asio_thread->join();
-          delete io;
-          delete asio_thread;
-       }
+      io_service_pool& get_pool()
+      {
+         static io_service_pool pool;
+         return pool;
+      }
 
-       ~default_io_service_scope()
-       {}
-    };
+      /** runs @p f on the thread of @p io and waits for it */
+      void run_on_io_thread( boost::asio::io_service& io, const std::function<void()>& f, const char* desc )
+      {
+        promise<void>::ptr p( new promise<void>( desc ) );
+        io.post( [p,f]() {
+          try
+          {
+            f();
+            p->set_value();
+          }
+          catch( const fc::exception& e )
+          {
+            p->set_exception( e.dynamic_copy_exception() );
+          }
+          catch( ... )
+          {
+            p->set_exception( std::make_shared<unhandled_exception>( FC_LOG_MESSAGE( warn, "unhandled exception: ${diagnostic}", ("diagnostic",boost::current_exception_diagnostic_information()) ) ) );
+          }
+        } );
+        p->wait();
+      }
+
+      void run_on_io_threads( const std::function<void()>& f, const char* desc )
+      {
+        for( const io_service_pool::runner& r : get_pool().runners )
+          run_on_io_thread( *r.io, f, desc );
+      }
+    }
 
     /// If cleanup is true, do not use the return value; it is a null reference
     boost::asio::io_service& default_io_service(bool cleanup) {
-        static default_io_service_scope fc_asio_service;
+        io_service_pool& pool = get_pool();
         if (cleanup)
-           fc_asio_service.cleanup();
-        return *fc_asio_service.io;
+           pool.cleanup();
+        return *pool.runners.front().io;
+    }
+
+    void set_io_service_pool_size( uint32_t threads, io_service_assignment assignment )
+    {
+        FC_ASSERT( threads > 0 );
+        pool_config& config = get_pool_config();
+        boost::lock_guard<boost::mutex> guard( config.lock );
+        if( config.started )
+          FC_THROW_EXCEPTION( invalid_operation_exception, "the fc::asio io_services are already running" );
+        config.size       = threads;
+        config.assignment = assignment;
+    }
+
+    uint32_t io_service_pool_size()
+    {
+        return uint32_t( get_pool().runners.size() );
+    }
+
+    boost::asio::io_service& socket_io_service()
+    {
+        io_service_pool& pool = get_pool();
+        const uint32_t size = uint32_t( pool.runners.size() );
+        if( size == 1 )
+          return *pool.runners.front().io;
+        if( pool.assignment == round_robin )
+          return *pool.runners[ pool.next++ % size ].io;
+
+      #ifdef _MSC_VER
+        static __declspec(thread) uint32_t assigned = 0; // index + 1
+      #else
+        static __thread uint32_t assigned = 0; // index + 1
+      #endif
+        if( !assigned )
+          assigned = pool.next++ % size + 1;
+        return *pool.runners[ assigned - 1 ].io;
+    }
+
+    void set_io_thread_affinity( const std::vector<uint32_t>& cpus )
+    {
+      run_on_io_threads( [cpus](){ fc::detail::pin_this_thread( cpus ); }, "set_io_thread_affinity" );
+    }
+
+    void set_io_thread_numa_node( uint32_t node )
+    {
+      run_on_io_threads( [node](){
+        fc::detail::pin_this_thread( fc::numa_node_cpus( node ) );
+        fc::detail::prefer_numa_node( node );
+      }, "set_io_thread_numa_node" );
+    }
+
+    namespace {
+      boost::atomic<io_backend> selected_backend( io_backend::reactor );
+    }
+
+    io_backend set_io_backend( io_backend backend )
+    {
+      if( backend == io_backend::io_uring && !fc::uring::available() )
+      {
+        wlog( "io_uring is not available, staying with the reactor" );
+        backend = io_backend::reactor;
+      }
+      selected_backend = backend;
+      return backend;
+    }
+
+    io_backend io_backend_in_use()
+    {
+      return selected_backend.load( boost::memory_order_relaxed );
     }
 
     namespace tcp {
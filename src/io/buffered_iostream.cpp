@@ -1,6 +1,7 @@
 #include <fc/io/buffered_iostream.hpp>
 #include <fc/exception/exception.hpp>
 #include <boost/asio/streambuf.hpp>
+#include <algorithm>
 #include <iostream>
 
 #include <fc/log/logger.hpp>
@@ -131,11 +132,15 @@ namespace fc
 
     namespace detail
     {
+       /** the most buffered_ostream::flush() copies out of its buffer for one write */
+       static const size_t maximum_write_size = 64 * 1024;
+
        class buffered_ostream_impl
        {
           public:
              buffered_ostream_impl( ostream_ptr os ) :
-               _ostr(fc::move(os))
+               _ostr(fc::move(os)),
+               _shared_write_buffer_size(0)
 #ifndef NDEBUG
                ,_shared_write_buffer_in_use(false)
 #endif
@@ -144,6 +149,7 @@ namespace fc
              ostream_ptr            _ostr;
              boost::asio::streambuf _rdbuf;
              std::shared_ptr<char>  _shared_write_buffer;
+             size_t                 _shared_write_buffer_size;
 #ifndef NDEBUG
              bool                   _shared_write_buffer_in_use;
 #endif
@@ -178,6 +184,14 @@ namespace fc
       return writesome(buf.get() + offset, len);
     }
 
+    size_t buffered_ostream::writesome( const const_buffer* buffers, size_t count )
+    {
+      size_t written = 0;
+      for( size_t i = 0; i < count; ++i )
+        written += writesome( buffers[i].data, buffers[i].size );
+      return written;
+    }
+
     void  buffered_ostream::flush()
     {
 #ifndef NDEBUG
@@ -190,11 +204,16 @@ namespace fc
           ~check_buffer_in_use() { assert(_buffer_in_use); _buffer_in_use = false; }
         } buffer_in_use_checker(my->_shared_write_buffer_in_use);
 #endif
-        const size_t write_buffer_size = 2048;
-        if (!my->_shared_write_buffer)
+        // what is buffered goes out in one write, up to maximum_write_size at a time; the
+        // buffer grows to the biggest flush so far but not past that
+        const size_t write_buffer_size = std::min( detail::maximum_write_size, std::max<size_t>( 2048, my->_rdbuf.size() ) );
+        if( write_buffer_size > my->_shared_write_buffer_size )
+        {
           my->_shared_write_buffer.reset(new char[write_buffer_size], [](char* p){ delete[] p; });
+          my->_shared_write_buffer_size = write_buffer_size;
+        }
 
-        while( size_t bytes_from_rdbuf = static_cast<size_t>(my->_rdbuf.sgetn(my->_shared_write_buffer.get(), write_buffer_size)) )
+        while( size_t bytes_from_rdbuf = static_cast<size_t>(my->_rdbuf.sgetn(my->_shared_write_buffer.get(), my->_shared_write_buffer_size)) )
            my->_ostr->write( my->_shared_write_buffer, bytes_from_rdbuf );
         my->_ostr->flush();
     }
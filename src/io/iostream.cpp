@@ -7,6 +7,7 @@
 #include <fc/thread/mutex.hpp>
 #include <fc/thread/scoped_lock.hpp>
 #include <string>
+#include <algorithm>
 #include <boost/lexical_cast.hpp>
 #include <boost/thread/mutex.hpp>
 #include <fc/io/stdio.hpp>
@@ -380,4 +381,38 @@ namespace fc {
     return *this;
   }
 
+  size_t ostream::writesome( const const_buffer* buffers, size_t count )
+  {
+    for( size_t i = 0; i < count; ++i )
+      if( buffers[i].size )
+        return writesome( buffers[i].data, buffers[i].size );
+    return 0;
+  }
+
+  ostream& ostream::write_all( const const_buffer* buffers, size_t count )
+  {
+    // what is left to write, the first buffer shrinks as it is written
+    const_buffers rest( buffers, buffers + count );
+    size_t first = 0;
+    while( first < rest.size() )
+    {
+      if( !rest[first].size )
+      {
+        ++first;
+        continue;
+      }
+      size_t written = writesome( rest.data() + first, rest.size() - first );
+      while( written )
+      {
+        const size_t n = std::min( written, rest[first].size );
+        rest[first].data += n;
+        rest[first].size -= n;
+        written -= n;
+        if( !rest[first].size )
+          ++first;
+      }
+    }
+    return *this;
+  }
+
 } // namespace fc
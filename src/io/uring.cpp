@@ -0,0 +1,589 @@
+#include <fc/io/uring.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/thread/scoped_lock.hpp>
+#include <fc/thread/spin_lock.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <boost/system/system_error.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+# if __has_include(<linux/io_uring.h>)
+#  include <linux/io_uring.h>
+# endif
+#endif
+
+#ifdef IORING_FEAT_FAST_POLL
+# define FC_HAS_IO_URING
+# include <errno.h>
+# include <poll.h>
+# include <string.h>
+# include <sys/eventfd.h>
+# include <sys/mman.h>
+# include <sys/socket.h>
+# include <sys/syscall.h>
+# include <sys/uio.h>
+# include <limits.h>
+# include <unistd.h>
+#endif
+
+namespace fc { namespace uring {
+
+#ifdef FC_HAS_IO_URING
+  namespace {
+    enum : uint64_t
+    {
+       wake_request    = 1, // the read of the eventfd that interrupts io_uring_enter()
+       ignored_request = 2  // the poll a resubmitted request is linked to
+    };
+
+    /** a request in flight, its address is the request's user_data */
+    struct operation
+    {
+       operation( const char* desc ):result( new promise<size_t>( desc ) ),stream_read(false),cancel_request(false),ready_events(0)
+       {
+          memset( &request, 0, sizeof(request) );
+       }
+
+       promise<size_t>::ptr         result;
+       std::shared_ptr<const char>  buffer;          // kept alive until the request completes
+       io_uring_sqe                 request;         // submitted again if a non blocking socket was not ready
+       bool                         stream_read;     // 0 bytes means the peer closed the stream
+       bool                         cancel_request;  // finding nothing to cancel is not an error
+       uint32_t                     ready_events;    // what to poll for before submitting again, 0 if not a socket
+       std::vector<iovec>           gathered;        // what a sendmsg request points to
+       msghdr                       message;
+    };
+
+    fc::exception_ptr error( int err )
+    {
+       const boost::system::error_code ec( err, boost::system::system_category() );
+       return fc::exception_ptr( new fc::exception( FC_LOG_MESSAGE( error, "${message} ", ("message", boost::system::system_error(ec).what()) ) ) );
+    }
+
+    /**
+     *  The process' io_uring and the thread that submits its requests and
+     *  reaps their completions.  Created on first use and never destroyed.
+     */
+    class ring
+    {
+      public:
+        /** @return nullptr if the kernel cannot give us a ring */
+        static ring* instance()
+        {
+           static ring* r = create();
+           return r;
+        }
+
+        void submit( operation* op )
+        {
+           // the ring thread has not come around to submit, do it ourselves,
+           // outside of the lock so other submitters are not left spinning
+           while( !try_submit( op, false ) )
+              if( syscall( __NR_io_uring_enter, _fd, _sq_entries, 0, 0, nullptr, 0 ) < 0 )
+              {
+                 if( errno == EBUSY || errno == EAGAIN )
+                 {
+                    // the completion queue is full, the ring thread has to reap first
+                    wake();
+                    boost::this_thread::yield();
+                 }
+                 else if( errno != EINTR )
+                    FC_THROW_EXCEPTION( invalid_operation_exception, "unable to submit io_uring requests: ${e}", ("e",strerror(errno)) );
+              }
+           wake();
+        }
+
+        int fd()const { return _fd; }
+
+      private:
+        ring():_fd(-1),_wake_fd(-1),_tail(0),_wake_armed(false),_waiting(false){}
+
+        static ring* create()
+        {
+           io_uring_params p;
+           memset( &p, 0, sizeof(p) );
+           const int fd = int( syscall( __NR_io_uring_setup, 1024, &p ) );
+           if( fd < 0 )
+           {
+              wlog( "io_uring is not available: ${e}", ("e",strerror(errno)) );
+              return nullptr;
+           }
+           const uint32_t required = IORING_FEAT_NODROP | IORING_FEAT_RW_CUR_POS | IORING_FEAT_FAST_POLL;
+           if( (p.features & required) != required )
+           {
+              wlog( "io_uring is too old, it lacks features ${f}", ("f",required & ~p.features) );
+              ::close( fd );
+              return nullptr;
+           }
+
+           size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+           size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+           const bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+           if( single_mmap )
+              sq_size = cq_size = std::max( sq_size, cq_size );
+           char* sq = (char*)mmap( nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+           char* cq = single_mmap ? sq : (char*)mmap( nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+           void* sqes = mmap( nullptr, p.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+           const int wake_fd = eventfd( 0, EFD_CLOEXEC );
+           if( sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED || wake_fd < 0 )
+           {
+              wlog( "unable to set up io_uring: ${e}", ("e",strerror(errno)) );
+              ::close( fd );
+              return nullptr;
+           }
+
+           ring* r = new ring();
+           r->_fd          = fd;
+           r->_wake_fd     = wake_fd;
+           r->_sq_head     = (uint32_t*)(sq + p.sq_off.head);
+           r->_sq_tail     = (uint32_t*)(sq + p.sq_off.tail);
+           r->_sq_mask     = *(uint32_t*)(sq + p.sq_off.ring_mask);
+           r->_sq_entries  = *(uint32_t*)(sq + p.sq_off.ring_entries);
+           r->_sqes        = (io_uring_sqe*)sqes;
+           r->_cq_head     = (uint32_t*)(cq + p.cq_off.head);
+           r->_cq_tail     = (uint32_t*)(cq + p.cq_off.tail);
+           r->_cq_mask     = *(uint32_t*)(cq + p.cq_off.ring_mask);
+           r->_cqes        = (io_uring_cqe*)(cq + p.cq_off.cqes);
+           r->_tail        = *r->_sq_tail;
+
+           // slot i of the submission queue always holds sqe i
+           uint32_t* array = (uint32_t*)(sq + p.sq_off.array);
+           for( uint32_t i = 0; i < r->_sq_entries; ++i )
+              array[i] = i;
+
+           new boost::thread( [r](){ r->run(); } );
+           return r;
+        }
+
+        static uint32_t poll_events( uint32_t events )
+        {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+           return (events << 16) | (events >> 16); // the kernel expects the halves swapped
+#else
+           return events;
+#endif
+        }
+
+        /** @pre _lock is held  @return true if @p count more requests fit in the submission queue */
+        bool have_room( uint32_t count )const
+        {
+           return _sq_entries - (_tail - __atomic_load_n( _sq_head, __ATOMIC_ACQUIRE )) >= count;
+        }
+
+        /** @pre _lock is held and have_room() */
+        io_uring_sqe* next_sqe()
+        {
+           return &_sqes[ _tail++ & _sq_mask ];
+        }
+
+        /**
+         *  Queues @p op, behind a poll for its ready_events if @p poll_first.
+         *  @return false if the submission queue is full
+         */
+        bool try_submit( operation* op, bool poll_first )
+        {
+           fc::scoped_lock<fc::spin_lock> lock( _lock );
+           if( !have_room( poll_first ? 2 : 1 ) )
+              return false;
+           if( poll_first )
+           {
+              io_uring_sqe* poll = next_sqe();
+              memset( poll, 0, sizeof(*poll) );
+              poll->opcode        = IORING_OP_POLL_ADD;
+              poll->fd            = op->request.fd;
+              poll->poll32_events = poll_events( op->ready_events );
+              poll->flags         = IOSQE_IO_LINK;
+              poll->user_data     = ignored_request;
+           }
+           io_uring_sqe* sqe = next_sqe();
+           *sqe = op->request;
+           sqe->user_data = uint64_t( uintptr_t( op ) );
+           __atomic_store_n( _sq_tail, _tail, __ATOMIC_RELEASE );
+           return true;
+        }
+
+        /** the ring thread submits everything queued up when it wakes, while it is busy there is no need to wake it */
+        void wake()
+        {
+           if( _waiting.exchange( false ) )
+           {
+              const uint64_t one = 1;
+              if( ::write( _wake_fd, &one, sizeof(one) ) < 0 )
+                 elog( "unable to wake the io_uring thread: ${e}", ("e",strerror(errno)) );
+           }
+        }
+
+        /** leaves _wake_armed false if the submission queue is full, run() tries again after its next submit */
+        void arm_wake()
+        {
+           fc::scoped_lock<fc::spin_lock> lock( _lock );
+           if( !have_room( 1 ) )
+              return;
+           io_uring_sqe* sqe = next_sqe();
+           memset( sqe, 0, sizeof(*sqe) );
+           sqe->opcode    = IORING_OP_READ;
+           sqe->fd        = _wake_fd;
+           sqe->addr      = uint64_t( uintptr_t( &_wake_value ) );
+           sqe->len       = sizeof(_wake_value);
+           sqe->user_data = wake_request;
+           __atomic_store_n( _sq_tail, _tail, __ATOMIC_RELEASE );
+           _wake_armed = true;
+        }
+
+        void run()
+        {
+           fc::thread::current().set_name( "uring" );
+           for( ;; )
+           {
+              if( !_wake_armed )
+                 arm_wake();
+
+              // from here on a new request wakes us, so none can be left behind
+              _waiting.store( true );
+              uint32_t pending;
+              {
+                 fc::scoped_lock<fc::spin_lock> lock( _lock );
+                 pending = _tail - __atomic_load_n( _sq_head, __ATOMIC_ACQUIRE );
+              }
+              // without the wake armed, or with requests left to queue, only submit and come around again
+              const bool wait = _wake_armed && _resubmit.empty()
+                                && *_cq_head == __atomic_load_n( _cq_tail, __ATOMIC_ACQUIRE );
+              if( syscall( __NR_io_uring_enter, _fd, pending, wait ? 1 : 0, IORING_ENTER_GETEVENTS, nullptr, 0 ) < 0
+                  && errno != EINTR && errno != EAGAIN && errno != EBUSY )
+                 elog( "io_uring_enter failed: ${e}", ("e",strerror(errno)) );
+              _waiting.store( false );
+
+              reap();
+              resubmit();
+           }
+        }
+
+        /**
+         *  Queues the requests complete() put aside, once reap() has handed the
+         *  completion queue back to the kernel.  Submitting from inside reap()
+         *  could find the kernel refusing new requests (EBUSY) until the very
+         *  completions being reaped are consumed.
+         *
+         *  Cancellations finish only after that, so the second pass of cancel()
+         *  is queued behind the requests the first one missed.
+         */
+        void resubmit()
+        {
+           size_t queued = 0;
+           while( queued < _resubmit.size() && try_submit( _resubmit[queued], true ) )
+              ++queued;
+           _resubmit.erase( _resubmit.begin(), _resubmit.begin() + queued );
+           if( !_resubmit.empty() )
+              return;
+           for( const std::pair<operation*,int>& c : _cancellations )
+              finish( c.first, c.second );
+           _cancellations.clear();
+        }
+
+        void reap()
+        {
+           uint32_t head = *_cq_head;
+           const uint32_t tail = __atomic_load_n( _cq_tail, __ATOMIC_ACQUIRE );
+           for( ; head != tail; ++head )
+           {
+              const io_uring_cqe& cqe = _cqes[ head & _cq_mask ];
+              try
+              {
+                 complete( cqe.user_data, cqe.res );
+              }
+              catch( const fc::exception& e )
+              {
+                 elog( "Caught unhandled exception completing an io_uring request: ${e}", ("e",e) );
+              }
+              catch( const std::exception& e )
+              {
+                 elog( "Caught unhandled exception completing an io_uring request: ${e}", ("e",e.what()) );
+              }
+              catch( ... )
+              {
+                 elog( "Caught unhandled exception completing an io_uring request" );
+              }
+           }
+           __atomic_store_n( _cq_head, head, __ATOMIC_RELEASE );
+        }
+
+        void complete( uint64_t user_data, int res )
+        {
+           if( user_data == wake_request )
+           {
+              _wake_armed = false;
+              return;
+           }
+           if( user_data == ignored_request )
+              return;
+
+           operation* op = (operation*)uintptr_t( user_data );
+           if( res == -EAGAIN && op->ready_events )
+           {
+              // the socket is in non blocking mode, have the kernel wait until it is ready
+              _resubmit.push_back( op );
+              return;
+           }
+           if( op->cancel_request )
+           {
+              _cancellations.push_back( std::make_pair( op, res ) );
+              return;
+           }
+           finish( op, res );
+        }
+
+        /** sets the promise of @p op and deletes it */
+        void finish( operation* op, int res )
+        {
+           std::unique_ptr<operation> done( op );
+           if( res >= 0 )
+           {
+              if( res == 0 && op->stream_read && op->request.len )
+                 op->result->set_exception( fc::exception_ptr( new fc::eof_exception( FC_LOG_MESSAGE( error, "End of file" ) ) ) );
+              else
+                 op->result->set_value( size_t( res ) );
+           }
+           else if( op->cancel_request && (res == -ENOENT || res == -EALREADY) )
+              op->result->set_value( 0 );
+           else
+              op->result->set_exception( error( -res ) );
+        }
+
+        int                 _fd;
+        int                 _wake_fd;
+        uint64_t            _wake_value;
+
+        uint32_t*           _sq_head;
+        uint32_t*           _sq_tail;
+        uint32_t            _sq_mask;
+        uint32_t            _sq_entries;
+        io_uring_sqe*       _sqes;
+        uint32_t*           _cq_head;
+        uint32_t*           _cq_tail;
+        uint32_t            _cq_mask;
+        io_uring_cqe*       _cqes;
+
+        fc::spin_lock           _lock;        // protects the submission queue
+        uint32_t                _tail;        // next free slot of the submission queue
+        bool                    _wake_armed;  // a read of _wake_fd is in flight, touched by the ring thread only
+        std::vector<operation*> _resubmit;    // requests whose socket was not ready, queued again after reap(), ring thread only
+        std::vector<std::pair<operation*,int>> _cancellations; // finished once _resubmit is empty, ring thread only
+        std::atomic<bool>       _waiting;     // the ring thread is about to wait, or waiting, in io_uring_enter()
+    };
+
+    ring& the_ring()
+    {
+       ring* r = ring::instance();
+       if( !r )
+          FC_THROW_EXCEPTION( invalid_operation_exception, "io_uring is not available" );
+       return *r;
+    }
+
+    operation* prepare( uint8_t opcode, int fd, const void* buf, size_t len, uint64_t file_offset, const char* desc )
+    {
+       operation* op = new operation( desc );
+       op->request.opcode = opcode;
+       op->request.fd     = fd;
+       op->request.addr   = uint64_t( uintptr_t( buf ) );
+       op->request.len    = uint32_t( std::min<size_t>( len, 0x7ffff000 ) ); // the most Linux transfers at once
+       op->request.off    = file_offset;
+       return op;
+    }
+
+    fc::future<size_t> submit( ring& r, operation* op )
+    {
+       fc::future<size_t> f( op->result ); // op is gone as soon as it completes
+       r.submit( op );
+       return f;
+    }
+
+    operation* prepare_recv( int fd, char* buf, size_t len )
+    {
+       operation* op = prepare( IORING_OP_RECV, fd, buf, len, 0, "fc::uring::recv" );
+       op->stream_read  = true;
+       op->ready_events = POLLIN;
+       return op;
+    }
+
+    operation* prepare_send( int fd, const char* buf, size_t len )
+    {
+       operation* op = prepare( IORING_OP_SEND, fd, buf, len, 0, "fc::uring::send" );
+       op->request.msg_flags = MSG_NOSIGNAL;
+       op->ready_events      = POLLOUT;
+       return op;
+    }
+  }
+
+  bool available()
+  {
+     return ring::instance() != nullptr;
+  }
+
+  fc::future<size_t> recv( int fd, char* buf, size_t len )
+  {
+     ring& r = the_ring();
+     return submit( r, prepare_recv( fd, buf, len ) );
+  }
+
+  fc::future<size_t> recv( int fd, const std::shared_ptr<char>& buf, size_t len, size_t offset )
+  {
+     ring& r = the_ring();
+     operation* op = prepare_recv( fd, buf.get() + offset, len );
+     op->buffer = buf;
+     return submit( r, op );
+  }
+
+  fc::future<size_t> send( int fd, const char* buf, size_t len )
+  {
+     ring& r = the_ring();
+     return submit( r, prepare_send( fd, buf, len ) );
+  }
+
+  fc::future<size_t> send( int fd, const std::shared_ptr<const char>& buf, size_t len, size_t offset )
+  {
+     ring& r = the_ring();
+     operation* op = prepare_send( fd, buf.get() + offset, len );
+     op->buffer = buf;
+     return submit( r, op );
+  }
+
+  fc::future<size_t> send( int fd, const const_buffer* buffers, size_t count )
+  {
+     ring& r = the_ring();
+     operation* op = prepare( IORING_OP_SENDMSG, fd, nullptr, 0, 0, "fc::uring::send" );
+     op->gathered.resize( std::min<size_t>( count, IOV_MAX ) );
+     for( size_t i = 0; i < op->gathered.size(); ++i )
+     {
+        op->gathered[i].iov_base = const_cast<char*>( buffers[i].data );
+        op->gathered[i].iov_len  = buffers[i].size;
+     }
+     memset( &op->message, 0, sizeof(op->message) );
+     op->message.msg_iov    = op->gathered.data();
+     op->message.msg_iovlen = op->gathered.size();
+     op->request.addr       = uint64_t( uintptr_t( &op->message ) );
+     op->request.len        = 1;
+     op->request.msg_flags  = MSG_NOSIGNAL;
+     op->ready_events       = POLLOUT;
+     return submit( r, op );
+  }
+
+  fc::future<size_t> read( int fd, char* buf, size_t len, uint64_t file_offset )
+  {
+     ring& r = the_ring();
+     return submit( r, prepare( IORING_OP_READ, fd, buf, len, file_offset, "fc::uring::read" ) );
+  }
+
+  fc::future<size_t> write( int fd, const char* buf, size_t len, uint64_t file_offset )
+  {
+     ring& r = the_ring();
+     return submit( r, prepare( IORING_OP_WRITE, fd, buf, len, file_offset, "fc::uring::write" ) );
+  }
+
+  fc::future<size_t> write( int fd, const std::shared_ptr<const char>& buf, size_t len, size_t offset, uint64_t file_offset )
+  {
+     ring& r = the_ring();
+     operation* op = prepare( IORING_OP_WRITE, fd, buf.get() + offset, len, file_offset, "fc::uring::write" );
+     op->buffer = buf;
+     return submit( r, op );
+  }
+
+  void register_buffers( const std::vector<std::pair<char*,size_t>>& buffers )
+  {
+     ring& r = the_ring();
+     std::vector<iovec> iov( buffers.size() );
+     for( size_t i = 0; i < buffers.size(); ++i )
+     {
+        iov[i].iov_base = buffers[i].first;
+        iov[i].iov_len  = buffers[i].second;
+     }
+     if( syscall( __NR_io_uring_register, r.fd(), IORING_REGISTER_BUFFERS, iov.data(), unsigned(iov.size()) ) < 0 )
+        FC_THROW_EXCEPTION( invalid_operation_exception, "unable to register ${n} buffers with io_uring: ${e}",
+                            ("n",buffers.size())("e",strerror(errno)) );
+  }
+
+  void unregister_buffers()
+  {
+     ring& r = the_ring();
+     if( syscall( __NR_io_uring_register, r.fd(), IORING_UNREGISTER_BUFFERS, nullptr, 0 ) < 0 )
+        FC_THROW_EXCEPTION( invalid_operation_exception, "unable to unregister io_uring buffers: ${e}", ("e",strerror(errno)) );
+  }
+
+  fc::future<size_t> read_fixed( int fd, char* buf, size_t len, uint64_t file_offset, uint16_t buffer_index )
+  {
+     ring& r = the_ring();
+     operation* op = prepare( IORING_OP_READ_FIXED, fd, buf, len, file_offset, "fc::uring::read_fixed" );
+     op->request.buf_index = buffer_index;
+     return submit( r, op );
+  }
+
+  fc::future<size_t> write_fixed( int fd, const char* buf, size_t len, uint64_t file_offset, uint16_t buffer_index )
+  {
+     ring& r = the_ring();
+     operation* op = prepare( IORING_OP_WRITE_FIXED, fd, buf, len, file_offset, "fc::uring::write_fixed" );
+     op->request.buf_index = buffer_index;
+     return submit( r, op );
+  }
+
+  void cancel( int fd )
+  {
+     ring& r = the_ring();
+#ifdef IORING_ASYNC_CANCEL_FD
+     try
+     {
+        // a request that found its socket not ready may be on its way back into
+        // the queue while the first pass runs, it is queued ahead of the second
+        for( int pass = 0; pass < 2; ++pass )
+        {
+           operation* op = prepare( IORING_OP_ASYNC_CANCEL, fd, nullptr, 0, 0, "fc::uring::cancel" );
+           op->request.cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+           op->cancel_request = true;
+           submit( r, op ).wait();
+        }
+        return;
+     }
+     catch( const fc::canceled_exception& )
+     {
+        throw;
+     }
+     catch( const fc::exception& )
+     {
+        // kernels before 5.19 cannot cancel by file
+     }
+#endif
+     // wakes up what waits on a socket, for files there is nothing to wait for
+     ::shutdown( fd, SHUT_RDWR );
+  }
+
+#else // FC_HAS_IO_URING
+
+  namespace {
+    void unsupported()
+    {
+       FC_THROW_EXCEPTION( invalid_operation_exception, "io_uring is not supported on this platform" );
+    }
+  }
+
+  bool available() { return false; }
+
+  fc::future<size_t> recv( int, char*, size_t )                                         { unsupported(); return fc::future<size_t>(); }
+  fc::future<size_t> recv( int, const std::shared_ptr<char>&, size_t, size_t )          { unsupported(); return fc::future<size_t>(); }
+  fc::future<size_t> send( int, const char*, size_t )                                   { unsupported(); return fc::future<size_t>(); }
+  fc::future<size_t> send( int, const std::shared_ptr<const char>&, size_t, size_t )    { unsupported(); return fc::future<size_t>(); }
+  fc::future<size_t> send( int, const const_buffer*, size_t )                           { unsupported(); return fc::future<size_t>(); }
+  fc::future<size_t> read( int, char*, size_t, uint64_t )                               { unsupported(); return fc::future<size_t>(); }
+  fc::future<size_t> write( int, const char*, size_t, uint64_t )                        { unsupported(); return fc::future<size_t>(); }
+  fc::future<size_t> write( int, const std::shared_ptr<const char>&, size_t, size_t, uint64_t ) { unsupported(); return fc::future<size_t>(); }
+  void register_buffers( const std::vector<std::pair<char*,size_t>>& )                  { unsupported(); }
+  void unregister_buffers()                                                             { unsupported(); }
+  fc::future<size_t> read_fixed( int, char*, size_t, uint64_t, uint16_t )              { unsupported(); return fc::future<size_t>(); }
+  fc::future<size_t> write_fixed( int, const char*, size_t, uint64_t, uint16_t )        { unsupported(); return fc::future<size_t>(); }
+  void cancel( int )                                                                    { unsupported(); }
+
+#endif // FC_HAS_IO_URING
+
+} } // namespace fc::uring
@@ -0,0 +1,47 @@
+#pragma once
+#include <fc/network/ip.hpp>
+#include <boost/asio.hpp>
+
+namespace fc { namespace ip {
+
+    /**
+     *  Conversions between fc::ip::any_address / any_endpoint and asio's types.
+     *  A v4 mapped address becomes a plain address_v4, so IPv4 peers can still
+     *  be reached through IPv4 sockets.
+     */
+    inline boost::asio::ip::address to_asio_address( const any_address& a )
+    {
+      if( a.is_v4() )
+        return boost::asio::ip::address_v4( uint32_t( a.to_v4() ) );
+      return boost::asio::ip::address_v6( a.to_bytes() );
+    }
+
+    inline any_address to_any_address( const boost::asio::ip::address& a )
+    {
+      if( a.is_v4() )
+        return address( a.to_v4().to_ulong() );
+      return any_address( a.to_v6().to_bytes() );
+    }
+
+    template<typename Protocol>
+    inline boost::asio::ip::basic_endpoint<Protocol> to_asio_endpoint( const any_endpoint& e )
+    {
+      return boost::asio::ip::basic_endpoint<Protocol>( to_asio_address( e.get_address() ), e.port() );
+    }
+
+    /** for a socket of @p family, an IPv6 socket reaches IPv4 peers through their v4 mapped address */
+    template<typename Protocol>
+    inline boost::asio::ip::basic_endpoint<Protocol> to_asio_endpoint( const any_endpoint& e, const Protocol& family )
+    {
+      if( family.family() == Protocol::v6().family() )
+        return boost::asio::ip::basic_endpoint<Protocol>( boost::asio::ip::address_v6( e.get_address().to_bytes() ), e.port() );
+      return to_asio_endpoint<Protocol>( e );
+    }
+
+    template<typename Protocol>
+    inline any_endpoint to_any_endpoint( const boost::asio::ip::basic_endpoint<Protocol>& e )
+    {
+      return any_endpoint( to_any_address( e.address() ), e.port() );
+    }
+
+} } // namespace fc::ip
@@ -110,14 +110,8 @@ http::reply connection::request( const fc::string& method,
       req << "\r\n"; 
       fc::string head = req.str();
 
-      my->sock.write( head.c_str(), head.size() );
-    //  fc::cerr.write( head.c_str() );
-
-      if( body.size() )  {
-          my->sock.write( body.c_str(), body.size() );
-    //      fc::cerr.write( body.c_str() );
-      }
-    //  fc::cerr.flush();
+      // header and body in one gathered write
+      my->sock.write_all( { const_buffer( head.c_str(), head.size() ), const_buffer( body.c_str(), body.size() ) } );
 
       return my->parse_reply();
   } catch ( ... ) {
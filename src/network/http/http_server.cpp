@@ -49,7 +49,7 @@ namespace fc { namespace http {
     public:
       impl(){}
 
-      impl(const fc::ip::endpoint& p ) 
+      impl(const fc::ip::any_endpoint& p ) 
       {
         tcp_serv.set_reuse_address();
         tcp_serv.listen(p);
@@ -146,11 +146,21 @@ namespace fc { namespace http {
     my.reset( new impl(p) );
   }
 
+  void server::listen( const fc::ip::any_endpoint& p ) 
+  {
+    my.reset( new impl(p) );
+  }
+
   fc::ip::endpoint server::get_local_endpoint() const
   {
     return my->tcp_serv.get_local_endpoint();
   }
 
+  fc::ip::any_endpoint server::get_local_any_endpoint() const
+  {
+    return my->tcp_serv.get_local_any_endpoint();
+  }
+
 
   server::response::response(){}
   server::response::response( const server::response& s ):my(s.my){}
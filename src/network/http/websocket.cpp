@@ -21,6 +21,7 @@
 #include <fc/variant.hpp>
 #include <fc/thread/thread.hpp>
 #include <fc/asio.hpp>
+#include "../asio_endpoint.hpp"
 
 #ifdef DEFAULT_LOGGER
 # undef DEFAULT_LOGGER
@@ -222,7 +223,7 @@ namespace fc { namespace http {
 
             virtual void on_connection( const on_connection_handler& handler) = 0;
             virtual void listen( uint16_t port ) = 0;
-            virtual void listen( const fc::ip::endpoint& ep ) = 0;
+            virtual void listen( const fc::ip::any_endpoint& ep ) = 0;
             virtual void start_accept() = 0;
       };
 
@@ -235,7 +236,7 @@ namespace fc { namespace http {
             {
 
                _server.clear_access_channels( websocketpp::log::alevel::all );
-               _server.init_asio(&fc::asio::default_io_service());
+               _server.init_asio(&fc::asio::socket_io_service());
                _server.set_reuse_addr(true);
                _server.set_open_handler( [&]( connection_hdl hdl ){
                     _server_thread.async( [&](){
@@ -338,9 +339,9 @@ namespace fc { namespace http {
                _server.listen(port);
             }
 
-            void listen( const fc::ip::endpoint& ep ) override
+            void listen( const fc::ip::any_endpoint& ep ) override
             {
-               _server.listen( boost::asio::ip::tcp::endpoint( boost::asio::ip::address_v4(uint32_t(ep.get_address())),ep.port()) );
+               _server.listen( fc::ip::to_asio_endpoint<boost::asio::ip::tcp>( ep ) );
             }
 
             void start_accept() override
@@ -425,7 +426,7 @@ namespace fc { namespace http {
                        _closed->set_value();
                 });
 
-                _client.init_asio( &fc::asio::default_io_service() );
+                _client.init_asio( &fc::asio::socket_io_service() );
             }
             ~websocket_client_impl()
             {
@@ -503,7 +504,7 @@ namespace fc { namespace http {
                    return ctx;
                 });
 
-                _client.init_asio( &fc::asio::default_io_service() );
+                _client.init_asio( &fc::asio::socket_io_service() );
             }
             ~websocket_tls_client_impl()
             {
@@ -554,6 +555,10 @@ namespace fc { namespace http {
    {
       my->listen(ep);
    }
+   void websocket_server::listen( const fc::ip::any_endpoint& ep )
+   {
+      my->listen(ep);
+   }
 
    void websocket_server::start_accept() {
       my->start_accept();
@@ -592,6 +597,10 @@ namespace fc { namespace http {
    {
       my->listen(ep);
    }
+   void websocket_tls_server::listen( const fc::ip::any_endpoint& ep )
+   {
+      my->listen(ep);
+   }
 
    void websocket_tls_server::start_accept() 
    {
@@ -135,6 +135,123 @@ namespace fc { namespace ip {
     return !( is_private_address() || is_multicast_address() );
   }
 
+
+  any_address::any_address()
+  {
+    *this = address();
+  }
+
+  any_address::any_address( const address& v4 )
+  {
+    _bytes = boost::asio::ip::address_v6::v4_mapped( boost::asio::ip::address_v4( uint32_t(v4) ) ).to_bytes();
+  }
+
+  any_address::any_address( const bytes_type& v6 )
+  :_bytes(v6){}
+
+  any_address::any_address( const fc::string& s )
+  {
+    try
+    {
+      const boost::asio::ip::address a = boost::asio::ip::address::from_string( s.c_str() );
+      if( a.is_v4() )
+        *this = address( a.to_v4().to_ulong() );
+      else
+        _bytes = a.to_v6().to_bytes();
+    }
+    FC_RETHROW_EXCEPTIONS(error, "Error parsing IP address ${address}", ("address", s))
+  }
+
+  any_address any_address::v6_any()
+  {
+    return any_address( boost::asio::ip::address_v6::any().to_bytes() );
+  }
+
+  any_address any_address::v6_loopback()
+  {
+    return any_address( boost::asio::ip::address_v6::loopback().to_bytes() );
+  }
+
+  bool any_address::is_v4()const
+  {
+    return boost::asio::ip::address_v6( _bytes ).is_v4_mapped();
+  }
+
+  address any_address::to_v4()const
+  {
+    if( !is_v4() )
+      FC_THROW_EXCEPTION( invalid_operation_exception, "${address} is not an IPv4 address", ("address", fc::string(*this)) );
+    return address( boost::asio::ip::address_v6( _bytes ).to_v4().to_ulong() );
+  }
+
+  any_address::operator fc::string()const
+  {
+    try
+    {
+      if( is_v4() )
+        return fc::string( to_v4() );
+      return boost::asio::ip::address_v6( _bytes ).to_string().c_str();
+    }
+    FC_RETHROW_EXCEPTIONS(error, "Error converting IP address to string")
+  }
+
+  bool any_address::is_loopback_address()const
+  {
+    if( is_v4() )
+      return (uint32_t(to_v4()) >> 24) == 127;
+    return boost::asio::ip::address_v6( _bytes ).is_loopback();
+  }
+
+  bool any_address::is_private_address()const
+  {
+    if( is_v4() )
+      return to_v4().is_private_address();
+    return (_bytes[0] & 0xfe) == 0xfc                          // fc00::/7
+        || (_bytes[0] == 0xfe && (_bytes[1] & 0xc0) == 0x80);  // fe80::/10
+  }
+
+  bool any_address::is_multicast_address()const
+  {
+    if( is_v4() )
+      return to_v4().is_multicast_address();
+    return _bytes[0] == 0xff;
+  }
+
+  bool any_address::is_public_address()const
+  {
+    return !( is_private_address() || is_multicast_address() );
+  }
+
+
+  any_endpoint any_endpoint::from_string( const string& endpoint_string )
+  {
+    try
+    {
+      any_endpoint ep;
+      const auto pos = endpoint_string.rfind(':');
+      FC_ASSERT( pos != string::npos, "missing port" );
+      fc::string host = endpoint_string.substr( 0, pos );
+      if( host.size() >= 2 && host.front() == '[' && host.back() == ']' )
+        host = host.substr( 1, host.size() - 2 );
+      ep._ip   = any_address( host );
+      ep._port = boost::lexical_cast<uint16_t>( endpoint_string.substr( pos+1, endpoint_string.size() ) );
+      return ep;
+    }
+    FC_RETHROW_EXCEPTIONS(warn, "error converting string to IP endpoint")
+  }
+
+  any_endpoint::operator string()const
+  {
+    try
+    {
+      const fc::string port = boost::lexical_cast<std::string>(_port).c_str();
+      if( _ip.is_v4() )
+        return fc::string(_ip) + ':' + port;
+      return '[' + fc::string(_ip) + "]:" + port;
+    }
+    FC_RETHROW_EXCEPTIONS(warn, "error converting IP endpoint to string")
+  }
+
 }  // namespace ip
 
   void to_variant( const ip::endpoint& var,  variant& vo )
@@ -155,4 +272,22 @@ namespace fc { namespace ip {
     vo = ip::address(var.as_string());
   }
 
+  void to_variant( const ip::any_endpoint& var,  variant& vo )
+  {
+      vo = fc::string(var);
+  }
+  void from_variant( const variant& var,  ip::any_endpoint& vo )
+  {
+     vo = ip::any_endpoint::from_string(var.as_string());
+  }
+
+  void to_variant( const ip::any_address& var,  variant& vo )
+  {
+    vo = fc::string(var);
+  }
+  void from_variant( const variant& var,  ip::any_address& vo )
+  {
+    vo = ip::any_address(var.as_string());
+  }
+
 } 
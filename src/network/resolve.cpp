@@ -1,22 +1,259 @@
+#include <fc/network/resolve.hpp>
 #include <fc/asio.hpp>
 #include <fc/network/ip.hpp>
 #include <fc/log/logger.hpp>
+#include <fc/thread/scoped_lock.hpp>
+#include <fc/thread/mutex.hpp>
+#include "asio_endpoint.hpp"
+
+#include <unordered_map>
 
 namespace fc
 {
+  namespace detail
+  {
+    /**
+     *  Every host is looked up once however many fibers ask for it at the
+     *  same time, the answer is kept for the positive or negative TTL.  An
+     *  entry that is asked for in the last fifth of its TTL is looked up
+     *  again in the background while the callers keep getting the cached
+     *  addresses, so hosts in regular use never make anyone wait.
+     *
+     *  The lookups run on asio's resolver thread and complete on an
+     *  io_service thread, which hands the result to each waiting fiber
+     *  through its own promise, fc promises cannot be waited on from
+     *  several threads.  The lock is an fc::mutex and only guards the
+     *  entries, a lookup is started once it has been released because
+     *  asio creates its resolver thread on the first one.
+     */
+    class resolve_cache
+    {
+      public:
+        typedef std::vector<ip::any_address>  addresses;
+
+        resolve_cache()
+        :_ttl( fc::seconds(60) ),
+         _negative_ttl( fc::seconds(10) ){}
+
+        addresses lookup( const std::string& host )
+        {
+          promise<addresses>::ptr waiter;
+          addresses               cached;
+          fc::exception_ptr       cached_error;
+          host_resolver           resolver;
+          bool                    start = false;
+          {
+            fc::scoped_lock<fc::mutex> lock( _lock );
+            const time_point now = time_point::now();
+            if( _entries.size() >= max_entries && !_entries.count( host ) )
+              prune( now );
+            entry& e = _entries[host];
+            if( e.resolved && now < e.expires )
+            {
+              start        = !e.error && !e.in_flight && now >= e.refresh_at;
+              cached       = e.ips;
+              cached_error = e.error;
+            }
+            else
+            {
+              waiter.reset( new promise<addresses>( "fc::resolve" ) );
+              e.waiters.push_back( waiter );
+              start = !e.in_flight;
+            }
+            if( start )
+            {
+              e.in_flight = true;
+              resolver    = _resolver;
+            }
+          }
+          if( start )
+            start_lookup( host, resolver );
+          if( !waiter )
+          {
+            if( cached_error )
+              cached_error->dynamic_rethrow_exception();
+            return cached;
+          }
+          return waiter->wait();
+        }
+
+        void set_ttl( const microseconds& ttl, const microseconds& negative_ttl )
+        {
+          fc::scoped_lock<fc::mutex> lock( _lock );
+          _ttl          = ttl;
+          _negative_ttl = negative_ttl;
+        }
+
+        void set_resolver( host_resolver resolver )
+        {
+          fc::scoped_lock<fc::mutex> lock( _lock );
+          _resolver = std::move( resolver );
+        }
+
+        void clear()
+        {
+          fc::scoped_lock<fc::mutex> lock( _lock );
+          for( auto itr = _entries.begin(); itr != _entries.end(); )
+          {
+            if( itr->second.in_flight ) // its waiters still need the entry
+            {
+              itr->second.resolved = false;
+              ++itr;
+            }
+            else
+              itr = _entries.erase( itr );
+          }
+        }
+
+      private:
+        struct entry
+        {
+          entry():resolved(false),in_flight(false){}
+
+          addresses                              ips;
+          fc::exception_ptr                      error;      // a negative entry
+          time_point                             refresh_at;
+          time_point                             expires;
+          bool                                   resolved;
+          bool                                   in_flight;
+          std::vector<promise<addresses>::ptr>   waiters;
+        };
+
+        enum { max_entries = 1024 };
+
+        /** drops the expired entries, called with _lock held */
+        void prune( const time_point& now )
+        {
+          for( auto itr = _entries.begin(); itr != _entries.end(); )
+          {
+            if( !itr->second.in_flight && now >= itr->second.expires )
+              itr = _entries.erase( itr );
+            else
+              ++itr;
+          }
+        }
+
+        /** called without _lock, the entry is already marked in flight */
+        void start_lookup( const std::string& host, const host_resolver& resolver )
+        {
+          if( resolver )
+          {
+            fc::asio::default_io_service().post( [this,host,resolver]() {
+              addresses found;
+              fc::exception_ptr failure;
+              try
+              {
+                found = resolver( host );
+              }
+              catch( const fc::exception& e )
+              {
+                failure = e.dynamic_copy_exception();
+              }
+              catch( const std::exception& e )
+              {
+                failure = fc::exception_ptr( new fc::exception(
+                          FC_LOG_MESSAGE( error, "Unable to resolve host ${host}: ${message}",
+                                          ("host", host)("message", e.what())) ) );
+              }
+              complete( host, found, failure );
+            } );
+            return;
+          }
+          std::shared_ptr<boost::asio::ip::tcp::resolver> res( new boost::asio::ip::tcp::resolver( fc::asio::default_io_service() ) );
+          res->async_resolve( boost::asio::ip::tcp::resolver::query( host, "0" ),
+            [this,host,res]( const boost::system::error_code& ec, boost::asio::ip::tcp::resolver::iterator itr ) {
+              addresses found;
+              fc::exception_ptr failure;
+              if( !ec )
+              {
+                for( ; itr != boost::asio::ip::tcp::resolver::iterator(); ++itr )
+                  found.push_back( ip::to_any_address( itr->endpoint().address() ) );
+              }
+              else
+                failure = fc::exception_ptr( new fc::exception(
+                          FC_LOG_MESSAGE( error, "Unable to resolve host ${host}: ${message}",
+                                          ("host", host)("message", boost::system::system_error(ec).what())) ) );
+              complete( host, found, failure );
+            } );
+        }
+
+        void complete( const std::string& host, const addresses& found, const fc::exception_ptr& error )
+        {
+          std::vector<promise<addresses>::ptr> waiters;
+          {
+            fc::scoped_lock<fc::mutex> lock( _lock );
+            entry& e = _entries[host];
+            e.in_flight = false;
+            waiters.swap( e.waiters );
+            const time_point now = time_point::now();
+            // a failed background refresh keeps the addresses until they expire
+            if( !error || !e.resolved || e.error || now >= e.expires )
+            {
+              e.ips        = found;
+              e.error      = error;
+              e.resolved   = true;
+              e.expires    = now + (error ? _negative_ttl : _ttl);
+              e.refresh_at = error ? e.expires : now + _ttl - microseconds( _ttl.count() / 5 );
+            }
+          }
+          for( auto& w : waiters )
+          {
+            if( error )
+              w->set_exception( error );
+            else
+              w->set_value( found );
+          }
+        }
+
+        fc::mutex                               _lock;
+        microseconds                            _ttl;
+        microseconds                            _negative_ttl;
+        host_resolver                           _resolver;     // empty for the system resolver
+        std::unordered_map<std::string,entry>   _entries;
+    };
+
+    resolve_cache& get_resolve_cache()
+    {
+      static resolve_cache* cache = new resolve_cache; // leaked, its lookups may outlive static destruction
+      return *cache;
+    }
+  }
+
+  void set_resolve_cache_ttl( const microseconds& ttl, const microseconds& negative_ttl )
+  {
+    detail::get_resolve_cache().set_ttl( ttl, negative_ttl );
+  }
+
+  void clear_resolve_cache()
+  {
+    detail::get_resolve_cache().clear();
+  }
+
+  void set_host_resolver( host_resolver resolver )
+  {
+    detail::get_resolve_cache().set_resolver( std::move( resolver ) );
+  }
+
   std::vector<fc::ip::endpoint> resolve( const fc::string& host, uint16_t port )
   {
-    auto ep = fc::asio::tcp::resolve( host, std::to_string(uint64_t(port)) );
+    const auto found = detail::get_resolve_cache().lookup( host );
     std::vector<fc::ip::endpoint> eps;
-    eps.reserve(ep.size());
-    for( auto itr = ep.begin(); itr != ep.end(); ++itr )
+    eps.reserve(found.size());
+    for( const auto& a : found )
     {
-      if( itr->address().is_v4() )
-      {
-       eps.push_back( fc::ip::endpoint(itr->address().to_v4().to_ulong(), itr->port()) );
-      }
-      // TODO: add support for v6 
+      if( a.is_v4() )
+        eps.push_back( fc::ip::endpoint( a.to_v4(), port ) );
     }
     return eps;
   }
+
+  std::vector<fc::ip::any_endpoint> resolve_any( const fc::string& host, uint16_t port )
+  {
+    const auto found = detail::get_resolve_cache().lookup( host );
+    std::vector<fc::ip::any_endpoint> eps;
+    eps.reserve(found.size());
+    for( const auto& a : found )
+      eps.push_back( fc::ip::any_endpoint( a, port ) );
+    return eps;
+  }
 }
@@ -1,12 +1,16 @@
 #include <fc/network/tcp_socket.hpp>
 #include <fc/network/ip.hpp>
 #include <fc/network/tcp_socket_io_hooks.hpp>
+#include "asio_endpoint.hpp"
 #include <fc/fwd_impl.hpp>
 #include <fc/asio.hpp>
+#include <fc/io/uring.hpp>
 #include <fc/log/logger.hpp>
 #include <fc/io/stdio.hpp>
 #include <fc/exception/exception.hpp>
 
+#include <algorithm>
+
 #if defined _WIN32 || defined WIN32 || defined OS_WIN64 || defined _WIN64 || defined WIN64 || defined WINNT
 # include <MSTcpIP.h>
 #endif
@@ -18,17 +22,53 @@ namespace fc {
     bool have_so_reuseport = true;
   }
 
+  namespace
+  {
+    /**
+     *  The first few buffers of a gathered write as an asio buffer sequence,
+     *  without allocating.  Small enough that the operation holding a copy
+     *  still fits in the socket's handler memory; writesome() is free to
+     *  write less than it was given.
+     */
+    class gathered_buffers
+    {
+      public:
+        typedef boost::asio::const_buffer        value_type;
+        typedef const boost::asio::const_buffer* const_iterator;
+
+        gathered_buffers( const const_buffer* buffers, size_t count )
+        :_count( std::min<size_t>( count, max_count ) )
+        {
+          for( size_t i = 0; i < _count; ++i )
+            _buffers[i] = boost::asio::const_buffer( buffers[i].data, buffers[i].size );
+        }
+
+        const_iterator begin()const { return _buffers; }
+        const_iterator end()const   { return _buffers + _count; }
+
+      private:
+        enum { max_count = 8 };
+        boost::asio::const_buffer _buffers[max_count];
+        size_t                    _count;
+    };
+  }
+
   class tcp_socket::impl : public tcp_socket_io_hooks {
     public:
       impl() :
-        _sock(fc::asio::default_io_service()),
-        _io_hooks(this)
+        _sock(fc::asio::socket_io_service()),
+        _io_hooks(this),
+        _read_memory(new fc::asio::handler_memory()),
+        _write_memory(new fc::asio::handler_memory()),
+        _reading_on_uring(false),
+        _writing_on_uring(false)
       {}
       ~impl()
       {
         if( _sock.is_open() ) 
           try
           {
+            cancel_uring_requests();
             _sock.close();
           }
           catch( ... )
@@ -50,38 +90,70 @@ namespace fc {
           {
           }
       }
+      /**
+       *  A read or write in flight on the io_uring keeps the socket open, see
+       *  fc::uring::cancel().  Goes by the backend the socket's last read and
+       *  write went through, the process may have switched since.
+       */
+      void cancel_uring_requests()
+      {
+        if( _reading_on_uring || _writing_on_uring )
+          fc::uring::cancel( _sock.native_handle() );
+      }
+
+      static bool uring_selected() { return fc::asio::io_backend_in_use() == fc::asio::io_backend::io_uring; }
+
       virtual size_t readsome(boost::asio::ip::tcp::socket& socket, char* buffer, size_t length) override;
       virtual size_t readsome(boost::asio::ip::tcp::socket& socket, const std::shared_ptr<char>& buffer, size_t length, size_t offset) override;
       virtual size_t writesome(boost::asio::ip::tcp::socket& socket, const char* buffer, size_t length) override;
       virtual size_t writesome(boost::asio::ip::tcp::socket& socket, const std::shared_ptr<const char>& buffer, size_t length, size_t offset) override;
+      virtual size_t writesome(boost::asio::ip::tcp::socket& socket, const const_buffer* buffers, size_t count) override;
 
       fc::future<size_t> _write_in_progress;
       fc::future<size_t> _read_in_progress;
       boost::asio::ip::tcp::socket _sock;
       tcp_socket_io_hooks* _io_hooks;
+      fc::asio::handler_memory::ptr _read_memory;  // reused by every read, one is in progress at a time
+      fc::asio::handler_memory::ptr _write_memory;
+      bool _reading_on_uring; // the backend of _read_in_progress
+      bool _writing_on_uring;
   };
 
   size_t tcp_socket::impl::readsome(boost::asio::ip::tcp::socket& socket, char* buffer, size_t length)
   {
-    return (_read_in_progress = fc::asio::read_some(socket, buffer, length)).wait();
+    if( (_reading_on_uring = uring_selected()) )
+      return (_read_in_progress = fc::uring::recv(socket.native_handle(), buffer, length)).wait();
+    return (_read_in_progress = fc::asio::read_some(socket, buffer, length, _read_memory)).wait();
   }
   size_t tcp_socket::impl::readsome(boost::asio::ip::tcp::socket& socket, const std::shared_ptr<char>& buffer, size_t length, size_t offset)
   {
-    return (_read_in_progress = fc::asio::read_some(socket, buffer, length, offset)).wait();
+    if( (_reading_on_uring = uring_selected()) )
+      return (_read_in_progress = fc::uring::recv(socket.native_handle(), buffer, length, offset)).wait();
+    return (_read_in_progress = fc::asio::read_some(socket, buffer, length, offset, _read_memory)).wait();
   }
   size_t tcp_socket::impl::writesome(boost::asio::ip::tcp::socket& socket, const char* buffer, size_t length)
   {
-    return (_write_in_progress = fc::asio::write_some(socket, buffer, length)).wait();
+    if( (_writing_on_uring = uring_selected()) )
+      return (_write_in_progress = fc::uring::send(socket.native_handle(), buffer, length)).wait();
+    return (_write_in_progress = fc::asio::write_some(socket, buffer, length, _write_memory)).wait();
   }
   size_t tcp_socket::impl::writesome(boost::asio::ip::tcp::socket& socket, const std::shared_ptr<const char>& buffer, size_t length, size_t offset)
   {
-    return (_write_in_progress = fc::asio::write_some(socket, buffer, length, offset)).wait();
+    if( (_writing_on_uring = uring_selected()) )
+      return (_write_in_progress = fc::uring::send(socket.native_handle(), buffer, length, offset)).wait();
+    return (_write_in_progress = fc::asio::write_some(socket, buffer, length, offset, _write_memory)).wait();
+  }
+  size_t tcp_socket::impl::writesome(boost::asio::ip::tcp::socket& socket, const const_buffer* buffers, size_t count)
+  {
+    if( (_writing_on_uring = uring_selected()) )
+      return (_write_in_progress = fc::uring::send(socket.native_handle(), buffers, count)).wait();
+    return (_write_in_progress = fc::asio::write_some(socket, gathered_buffers(buffers, count), _write_memory)).wait();
   }
 
 
-  void tcp_socket::open()
+  void tcp_socket::open( bool v6 )
   {
-    my->_sock.open(boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), 0).protocol());
+    my->_sock.open( v6 ? boost::asio::ip::tcp::v6() : boost::asio::ip::tcp::v4() );
   }
 
   bool tcp_socket::is_open()const {
@@ -97,6 +169,7 @@ namespace fc {
     try {
         if( is_open() )
         { 
+          my->cancel_uring_requests();
           my->_sock.close();
         }
     } FC_RETHROW_EXCEPTIONS( warn, "error closing tcp socket" );
@@ -116,12 +189,17 @@ namespace fc {
     return my->_io_hooks->writesome(my->_sock, buf, len, offset);
   }
 
+  size_t tcp_socket::writesome( const const_buffer* buffers, size_t count )
+  {
+    return my->_io_hooks->writesome(my->_sock, buffers, count);
+  }
+
   fc::ip::endpoint tcp_socket::remote_endpoint()const
   {
     try
     {
-      auto rep = my->_sock.remote_endpoint();
-      return  fc::ip::endpoint(rep.address().to_v4().to_ulong(), rep.port() );
+      // a peer of a dual stack server is v4 mapped, only a real IPv6 peer throws
+      return fc::ip::to_any_endpoint( my->_sock.remote_endpoint() ).to_v4();
     } 
     FC_RETHROW_EXCEPTIONS( warn, "error getting socket's remote endpoint" );
   }
@@ -131,8 +209,25 @@ namespace fc {
   {
     try
     {
-      auto boost_local_endpoint = my->_sock.local_endpoint();
-      return fc::ip::endpoint(boost_local_endpoint.address().to_v4().to_ulong(), boost_local_endpoint.port() );
+      return fc::ip::to_any_endpoint( my->_sock.local_endpoint() ).to_v4();
+    } 
+    FC_RETHROW_EXCEPTIONS( warn, "error getting socket's local endpoint" );
+  }
+
+  fc::ip::any_endpoint tcp_socket::remote_any_endpoint()const
+  {
+    try
+    {
+      return fc::ip::to_any_endpoint( my->_sock.remote_endpoint() );
+    } 
+    FC_RETHROW_EXCEPTIONS( warn, "error getting socket's remote endpoint" );
+  }
+
+  fc::ip::any_endpoint tcp_socket::local_any_endpoint()const
+  {
+    try
+    {
+      return fc::ip::to_any_endpoint( my->_sock.local_endpoint() );
     } 
     FC_RETHROW_EXCEPTIONS( warn, "error getting socket's local endpoint" );
   }
@@ -150,6 +245,13 @@ namespace fc {
     fc::asio::tcp::connect(my->_sock, fc::asio::tcp::endpoint( boost::asio::ip::address_v4(remote_endpoint.get_address()), remote_endpoint.port() ) ); 
   }
 
+  void tcp_socket::connect_to( const fc::ip::any_endpoint& remote_endpoint ) {
+    if( my->_sock.is_open() )
+      fc::asio::tcp::connect(my->_sock, fc::ip::to_asio_endpoint( remote_endpoint, my->_sock.local_endpoint().protocol() ) ); 
+    else
+      fc::asio::tcp::connect(my->_sock, fc::ip::to_asio_endpoint<boost::asio::ip::tcp>( remote_endpoint ) ); 
+  }
+
   void tcp_socket::bind(const fc::ip::endpoint& local_endpoint)
   {
     try
@@ -164,6 +266,19 @@ namespace fc {
     }
   }
 
+  void tcp_socket::bind(const fc::ip::any_endpoint& local_endpoint)
+  {
+    try
+    {
+      my->_sock.bind(fc::ip::to_asio_endpoint<boost::asio::ip::tcp>( local_endpoint ));
+    }
+    catch (const std::exception& except)
+    {
+      elog("Exception binding outgoing connection to desired local endpoint: ${what}", ("what", except.what()));
+      FC_THROW("error binding to ${endpoint}: ${what}", ("endpoint", local_endpoint)("what", except.what()));
+    }
+  }
+
   void tcp_socket::enable_keep_alives(const fc::microseconds& interval)
   {
     if (interval.count())
@@ -240,7 +355,8 @@ namespace fc {
   class tcp_server::impl {
     public:
       impl()
-      :_accept( fc::asio::default_io_service() )
+      :_accept( fc::asio::socket_io_service() ),
+       _reuse_address(false)
       {
         _accept.open(boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), 0).protocol());
       }
@@ -255,7 +371,17 @@ namespace fc {
         }
       }
 
+      /** reopens the acceptor for IPv6, a dual stack one if the system allows it */
+      void open_v6()
+      {
+        _accept.close();
+        _accept.open( boost::asio::ip::tcp::v6() );
+        boost::system::error_code ec;
+        _accept.set_option( boost::asio::ip::v6_only(false), ec );
+      }
+
       boost::asio::ip::tcp::acceptor _accept;
+      bool                           _reuse_address; // to set it again when open_v6() reopens the acceptor
   };
   void tcp_server::close() {
     if( my && my->_accept.is_open() ) 
@@ -283,6 +409,7 @@ namespace fc {
   {
     if( !my ) 
       my = new impl;
+    my->_reuse_address = enable;
     boost::asio::ip::tcp::acceptor::reuse_address option(enable);
     my->_accept.set_option(option);
 #if defined(__APPLE__) || (defined(__linux__) && defined(SO_REUSEPORT))
@@ -325,11 +452,33 @@ namespace fc {
     FC_RETHROW_EXCEPTIONS(warn, "error listening on socket");
   }
 
+  void tcp_server::listen( const fc::ip::any_endpoint& ep ) 
+  {
+    if( ep.is_v4() )
+      return listen( ep.to_v4() );
+    if( !my ) 
+      my = new impl;
+    try
+    {
+      my->open_v6();
+      if( my->_reuse_address )
+        set_reuse_address();
+      my->_accept.bind(fc::ip::to_asio_endpoint<boost::asio::ip::tcp>( ep ));
+      my->_accept.listen();
+    } 
+    FC_RETHROW_EXCEPTIONS(warn, "error listening on socket");
+  }
+
   fc::ip::endpoint tcp_server::get_local_endpoint() const
   {
     FC_ASSERT( my != nullptr );
-    return fc::ip::endpoint(my->_accept.local_endpoint().address().to_v4().to_ulong(), 
-                            my->_accept.local_endpoint().port() );
+    return fc::ip::to_any_endpoint( my->_accept.local_endpoint() ).to_v4();
+  }
+
+  fc::ip::any_endpoint tcp_server::get_local_any_endpoint() const
+  {
+    FC_ASSERT( my != nullptr );
+    return fc::ip::to_any_endpoint( my->_accept.local_endpoint() );
   }
 
   uint16_t tcp_server::get_port()const
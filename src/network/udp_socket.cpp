@@ -2,26 +2,92 @@
 #include <fc/network/ip.hpp>
 #include <fc/fwd_impl.hpp>
 #include <fc/asio.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/thread/mutex.hpp>
+#include <fc/thread/scoped_lock.hpp>
+#include "asio_endpoint.hpp"
 
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+#ifdef __linux__
+# include <errno.h>
+# include <netinet/in.h>
+# include <netinet/udp.h>
+# include <sys/socket.h>
+# ifndef UDP_SEGMENT
+#  define UDP_SEGMENT 103
+# endif
+# ifndef UDP_GRO
+#  define UDP_GRO 104
+# endif
+#endif
 
 namespace fc {
   
   class udp_socket::impl : public fc::retainable {
     public:
-      impl():_sock( fc::asio::default_io_service() ){}
+      impl()
+      :_sock( fc::asio::socket_io_service() ),_v6(false),
+       _send_memory( new fc::asio::handler_memory() ),_receive_memory( new fc::asio::handler_memory() ){}
       ~impl(){
       //  _sock.cancel();
       }
 
+      boost::asio::ip::udp::endpoint to_asio_ep( const fc::ip::any_endpoint& e )const {
+        return fc::ip::to_asio_endpoint( e, _v6 ? boost::asio::ip::udp::v6() : boost::asio::ip::udp::v4() );
+      }
+
+      /** parks the calling fiber until the socket is readable, or writable if @p write */
+      void wait_ready( bool write )
+      {
+        promise<size_t>::ptr p( new promise<size_t>( write ? "udp_socket::send_batch" : "udp_socket::receive_batch" ) );
+        if( write )
+          _sock.async_send( boost::asio::null_buffers(), asio::detail::read_write_handler( p, _send_memory ) );
+        else
+          _sock.async_receive( boost::asio::null_buffers(), asio::detail::read_write_handler( p, _receive_memory ) );
+        p->wait();
+      }
+
+#ifdef __linux__
+      /**
+       *  recvmmsg() and sendmmsg() arguments, kept so a batch does not
+       *  allocate them.  A batch owns its scratch until it returns, through
+       *  the batch's mutex, because it points the headers at the caller's
+       *  buffers before it parks in wait_ready().
+       */
+      struct batch_scratch
+      {
+        static const size_t control_size = CMSG_SPACE(sizeof(int));
+
+        void resize( size_t count )
+        {
+          if( headers.size() >= count )
+            return;
+          headers.resize( count );
+          iovecs.resize( count );
+          endpoints.resize( count );
+          control.resize( count * control_size );
+        }
+
+        std::vector<mmsghdr>                         headers;
+        std::vector<iovec>                           iovecs;
+        std::vector<boost::asio::ip::udp::endpoint>  endpoints;
+        std::vector<char>                            control;
+      };
+      batch_scratch                _receive_batch;
+      batch_scratch                _send_batch;
+      fc::mutex                    _receive_batch_lock;
+      fc::mutex                    _send_batch_lock;
+#endif
+
       boost::asio::ip::udp::socket _sock;
+      bool                         _v6;              // opened for IPv6, IPv4 peers get v4 mapped addresses
+      fc::asio::handler_memory::ptr _send_memory;    // reused by every send_to that has to wait
+      fc::asio::handler_memory::ptr _receive_memory;
   };
 
-  boost::asio::ip::udp::endpoint to_asio_ep( const fc::ip::endpoint& e ) {
-    return boost::asio::ip::udp::endpoint(boost::asio::ip::address_v4(e.get_address()), e.port() );
-  }
-  fc::ip::endpoint to_fc_ep( const boost::asio::ip::udp::endpoint& e ) {
-    return fc::ip::endpoint( e.address().to_v4().to_ulong(), e.port() );
-  }
 
   udp_socket::udp_socket()
   :my( new impl() ) 
@@ -46,19 +112,22 @@ namespace fc {
 
   size_t udp_socket::send_to( const char* buffer, size_t length, const ip::endpoint& to ) 
   {
-    try 
-    {
-      return my->_sock.send_to( boost::asio::buffer(buffer, length), to_asio_ep(to) );
-    } 
-    catch( const boost::system::system_error& e ) 
-    {
-      if( e.code() != boost::asio::error::would_block )
-        throw;
-    }
+    return send_to( buffer, length, ip::any_endpoint(to) );
+  }
+
+  size_t udp_socket::send_to( const char* buffer, size_t length, const ip::any_endpoint& to ) 
+  {
+    // try without waiting first, reporting would_block as an error code rather than an exception
+    boost::system::error_code ec;
+    size_t bytes_sent = my->_sock.send_to( boost::asio::buffer(buffer, length), my->to_asio_ep(to), 0, ec );
+    if( !ec )
+      return bytes_sent;
+    if( ec != boost::asio::error::would_block )
+      throw boost::system::system_error( ec );
 
     promise<size_t>::ptr completion_promise(new promise<size_t>("udp_socket::send_to"));
-    my->_sock.async_send_to( boost::asio::buffer(buffer, length), to_asio_ep(to), 
-                             asio::detail::read_write_handler(completion_promise) );
+    my->_sock.async_send_to( boost::asio::buffer(buffer, length), my->to_asio_ep(to), 
+                             asio::detail::read_write_handler(completion_promise, my->_send_memory) );
 
     return completion_promise->wait();
   }
@@ -66,95 +135,294 @@ namespace fc {
   size_t udp_socket::send_to( const std::shared_ptr<const char>& buffer, size_t length, 
                               const fc::ip::endpoint& to )
   {
-    try 
-    {
-      return my->_sock.send_to( boost::asio::buffer(buffer.get(), length), to_asio_ep(to) );
-    } 
-    catch( const boost::system::system_error& e ) 
-    {
-      if( e.code() != boost::asio::error::would_block )
-        throw;
-    }
+    return send_to( buffer, length, ip::any_endpoint(to) );
+  }
+
+  size_t udp_socket::send_to( const std::shared_ptr<const char>& buffer, size_t length, 
+                              const fc::ip::any_endpoint& to )
+  {
+    boost::system::error_code ec;
+    size_t bytes_sent = my->_sock.send_to( boost::asio::buffer(buffer.get(), length), my->to_asio_ep(to), 0, ec );
+    if( !ec )
+      return bytes_sent;
+    if( ec != boost::asio::error::would_block )
+      throw boost::system::system_error( ec );
 
     promise<size_t>::ptr completion_promise(new promise<size_t>("udp_socket::send_to"));
-    my->_sock.async_send_to( boost::asio::buffer(buffer.get(), length), to_asio_ep(to), 
-                             asio::detail::read_write_handler_with_buffer(completion_promise, buffer) );
+    my->_sock.async_send_to( boost::asio::buffer(buffer.get(), length), my->to_asio_ep(to), 
+                             asio::detail::read_write_handler_with_buffer(completion_promise, buffer, my->_send_memory) );
 
     return completion_promise->wait();
   }
 
-  void udp_socket::open() {
-    my->_sock.open( boost::asio::ip::udp::v4() );
+  void udp_socket::open( bool v6 ) {
+    my->_sock.open( v6 ? boost::asio::ip::udp::v6() : boost::asio::ip::udp::v4() );
+    my->_v6 = v6;
+    if( v6 )
+    {
+      boost::system::error_code ec; // dual stack where the system allows it
+      my->_sock.set_option( boost::asio::ip::v6_only(false), ec );
+    }
     my->_sock.non_blocking(true);
   }
   void udp_socket::set_receive_buffer_size( size_t s ) {
     my->_sock.set_option(boost::asio::socket_base::receive_buffer_size(s) );
   }
   void udp_socket::bind( const fc::ip::endpoint& e ) {
-    my->_sock.bind( to_asio_ep(e) );
+    bind( ip::any_endpoint(e) );
+  }
+  void udp_socket::bind( const fc::ip::any_endpoint& e ) {
+    my->_sock.bind( my->to_asio_ep(e) );
   }
 
   size_t udp_socket::receive_from( const std::shared_ptr<char>& receive_buffer, size_t receive_buffer_length, fc::ip::endpoint& from )
   {
-    try 
+    ip::any_endpoint any_from;
+    const size_t bytes_read = receive_from( receive_buffer, receive_buffer_length, any_from );
+    from = any_from.to_v4();
+    return bytes_read;
+  }
+
+  size_t udp_socket::receive_from( const std::shared_ptr<char>& receive_buffer, size_t receive_buffer_length, fc::ip::any_endpoint& from )
+  {
+    boost::asio::ip::udp::endpoint boost_from_endpoint;
+    boost::system::error_code ec;
+    size_t bytes_read = my->_sock.receive_from( boost::asio::buffer(receive_buffer.get(), receive_buffer_length), 
+                                                boost_from_endpoint, 0, ec );
+    if( !ec )
     {
-      boost::asio::ip::udp::endpoint boost_from_endpoint;
-      size_t bytes_read = my->_sock.receive_from( boost::asio::buffer(receive_buffer.get(), receive_buffer_length), 
-                                                  boost_from_endpoint );
-      from = to_fc_ep(boost_from_endpoint);
+      from = ip::to_any_endpoint(boost_from_endpoint);
       return bytes_read;
-    } 
-    catch( const boost::system::system_error& e ) 
-    {
-      if( e.code() != boost::asio::error::would_block ) 
-        throw;
     }
+    if( ec != boost::asio::error::would_block ) 
+      throw boost::system::system_error( ec );
 
-    boost::asio::ip::udp::endpoint boost_from_endpoint;
     promise<size_t>::ptr completion_promise(new promise<size_t>("udp_socket::receive_from"));
     my->_sock.async_receive_from( boost::asio::buffer(receive_buffer.get(), receive_buffer_length), 
                                   boost_from_endpoint,
-                                  asio::detail::read_write_handler_with_buffer(completion_promise, receive_buffer) );
-    size_t bytes_read = completion_promise->wait();
-    from = to_fc_ep(boost_from_endpoint);
+                                  asio::detail::read_write_handler_with_buffer(completion_promise, receive_buffer, my->_receive_memory) );
+    bytes_read = completion_promise->wait();
+    from = ip::to_any_endpoint(boost_from_endpoint);
     return bytes_read;
   }
 
   size_t udp_socket::receive_from( char* receive_buffer, size_t receive_buffer_length, fc::ip::endpoint& from ) 
   {
-    try 
+    ip::any_endpoint any_from;
+    const size_t bytes_read = receive_from( receive_buffer, receive_buffer_length, any_from );
+    from = any_from.to_v4();
+    return bytes_read;
+  }
+
+  size_t udp_socket::receive_from( char* receive_buffer, size_t receive_buffer_length, fc::ip::any_endpoint& from ) 
+  {
+    boost::asio::ip::udp::endpoint boost_from_endpoint;
+    boost::system::error_code ec;
+    size_t bytes_read = my->_sock.receive_from( boost::asio::buffer(receive_buffer, receive_buffer_length), 
+                                                boost_from_endpoint, 0, ec );
+    if( !ec )
     {
-      boost::asio::ip::udp::endpoint boost_from_endpoint;
-      size_t bytes_read = my->_sock.receive_from( boost::asio::buffer(receive_buffer, receive_buffer_length), 
-                                                  boost_from_endpoint );
-      from = to_fc_ep(boost_from_endpoint);
+      from = ip::to_any_endpoint(boost_from_endpoint);
       return bytes_read;
-    } 
-    catch( const boost::system::system_error& e ) 
-    {
-      if( e.code() != boost::asio::error::would_block ) 
-        throw;
     }
+    if( ec != boost::asio::error::would_block ) 
+      throw boost::system::system_error( ec );
 
-    boost::asio::ip::udp::endpoint boost_from_endpoint;
     promise<size_t>::ptr completion_promise(new promise<size_t>("udp_socket::receive_from"));
     my->_sock.async_receive_from( boost::asio::buffer(receive_buffer, receive_buffer_length), boost_from_endpoint,
-                                  asio::detail::read_write_handler(completion_promise) );
-    size_t bytes_read = completion_promise->wait();
-    from = to_fc_ep(boost_from_endpoint);
+                                  asio::detail::read_write_handler(completion_promise, my->_receive_memory) );
+    bytes_read = completion_promise->wait();
+    from = ip::to_any_endpoint(boost_from_endpoint);
     return bytes_read;
   }
 
+#ifdef __linux__
+  size_t udp_socket::receive_batch( udp_message* messages, size_t count )
+  {
+    if( count == 0 )
+      return 0;
+    fc::scoped_lock<fc::mutex> lock( my->_receive_batch_lock );
+    impl::batch_scratch& b = my->_receive_batch;
+    b.resize( count );
+    for( size_t i = 0; i < count; ++i )
+    {
+      b.iovecs[i].iov_base = messages[i].data;
+      b.iovecs[i].iov_len  = messages[i].size;
+      msghdr& h = b.headers[i].msg_hdr;
+      memset( &h, 0, sizeof(h) );
+      h.msg_name       = b.endpoints[i].data();
+      h.msg_namelen    = b.endpoints[i].capacity();
+      h.msg_iov        = &b.iovecs[i];
+      h.msg_iovlen     = 1;
+      h.msg_control    = &b.control[i * impl::batch_scratch::control_size];
+      h.msg_controllen = impl::batch_scratch::control_size;
+    }
+
+    int received;
+    while( (received = recvmmsg( my->_sock.native_handle(), b.headers.data(), count, MSG_DONTWAIT, nullptr )) < 0 )
+    {
+      if( errno == EAGAIN || errno == EWOULDBLOCK )
+        my->wait_ready( false );
+      else if( errno != EINTR )
+        throw boost::system::system_error( errno, boost::system::system_category() );
+    }
+
+    for( int i = 0; i < received; ++i )
+    {
+      const msghdr& h = b.headers[i].msg_hdr;
+      messages[i].size         = b.headers[i].msg_len;
+      messages[i].truncated    = (h.msg_flags & MSG_TRUNC) != 0;
+      messages[i].segment_size = 0;
+      b.endpoints[i].resize( h.msg_namelen );
+      messages[i].endpoint     = ip::to_any_endpoint( b.endpoints[i] );
+      for( const cmsghdr* c = CMSG_FIRSTHDR(&h); c; c = CMSG_NXTHDR(const_cast<msghdr*>(&h), const_cast<cmsghdr*>(c)) )
+      {
+        if( c->cmsg_level == SOL_UDP && c->cmsg_type == UDP_GRO )
+        {
+          int segment_size;
+          memcpy( &segment_size, CMSG_DATA(c), sizeof(segment_size) );
+          messages[i].segment_size = uint16_t(segment_size);
+        }
+      }
+    }
+    return size_t(received);
+  }
+
+  size_t udp_socket::send_batch( const udp_message* messages, size_t count )
+  {
+    fc::scoped_lock<fc::mutex> lock( my->_send_batch_lock );
+    impl::batch_scratch& b = my->_send_batch;
+    b.resize( count );
+    for( size_t i = 0; i < count; ++i )
+    {
+      b.iovecs[i].iov_base = messages[i].data;
+      b.iovecs[i].iov_len  = messages[i].size;
+      msghdr& h = b.headers[i].msg_hdr;
+      memset( &h, 0, sizeof(h) );
+      if( messages[i].endpoint != ip::any_endpoint() )
+      {
+        b.endpoints[i] = my->to_asio_ep( messages[i].endpoint );
+        h.msg_name     = b.endpoints[i].data();
+        h.msg_namelen  = b.endpoints[i].size();
+      }
+      h.msg_iov    = &b.iovecs[i];
+      h.msg_iovlen = 1;
+      if( messages[i].segment_size )
+      {
+        h.msg_control    = &b.control[i * impl::batch_scratch::control_size];
+        h.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+        cmsghdr* c = CMSG_FIRSTHDR(&h);
+        c->cmsg_level = SOL_UDP;
+        c->cmsg_type  = UDP_SEGMENT;
+        c->cmsg_len   = CMSG_LEN(sizeof(uint16_t));
+        memcpy( CMSG_DATA(c), &messages[i].segment_size, sizeof(uint16_t) );
+      }
+    }
+
+    size_t sent = 0;
+    while( sent < count )
+    {
+      const int n = sendmmsg( my->_sock.native_handle(), b.headers.data() + sent, count - sent, MSG_DONTWAIT );
+      if( n >= 0 )
+        sent += n;
+      else if( errno == EAGAIN || errno == EWOULDBLOCK )
+        my->wait_ready( true );
+      else if( errno != EINTR )
+        throw boost::system::system_error( errno, boost::system::system_category() );
+    }
+    return count;
+  }
+
+  void udp_socket::set_gro( bool enable )
+  {
+    const int value = enable;
+    if( setsockopt( my->_sock.native_handle(), SOL_UDP, UDP_GRO, &value, sizeof(value) ) < 0 )
+      throw boost::system::system_error( errno, boost::system::system_category() );
+  }
+#else
+  size_t udp_socket::receive_batch( udp_message* messages, size_t count )
+  {
+    // one datagram per system call, only the first one waits
+    boost::asio::ip::udp::endpoint from;
+    size_t received = 0;
+    while( received < count )
+    {
+      udp_message& m = messages[received];
+      boost::system::error_code ec;
+      const size_t bytes = my->_sock.receive_from( boost::asio::buffer( m.data, m.size ), from, 0, ec );
+      if( ec == boost::asio::error::would_block )
+      {
+        if( received )
+          break;
+        my->wait_ready( false );
+        continue;
+      }
+      if( ec )
+        throw boost::system::system_error( ec );
+      m.size         = bytes;
+      m.truncated    = false;
+      m.segment_size = 0;
+      m.endpoint     = ip::to_any_endpoint( from );
+      ++received;
+    }
+    return received;
+  }
+
+  size_t udp_socket::send_batch( const udp_message* messages, size_t count )
+  {
+    for( size_t i = 0; i < count; ++i )
+    {
+      const udp_message& m = messages[i];
+      const bool connected = m.endpoint == ip::any_endpoint();
+      // without GSO the segments are split here
+      const size_t segment = m.segment_size ? m.segment_size : std::max<size_t>( m.size, 1 );
+      for( size_t offset = 0; ; )
+      {
+        const size_t len = std::min( segment, m.size - offset );
+        if( !connected )
+          send_to( m.data + offset, len, m.endpoint );
+        else
+        {
+          boost::system::error_code ec;
+          my->_sock.send( boost::asio::buffer( m.data + offset, len ), 0, ec );
+          if( ec == boost::asio::error::would_block )
+          {
+            my->wait_ready( true );
+            continue;
+          }
+          if( ec )
+            throw boost::system::system_error( ec );
+        }
+        offset += len;
+        if( offset >= m.size )
+          break;
+      }
+    }
+    return count;
+  }
+
+  void udp_socket::set_gro( bool )
+  {
+    FC_THROW_EXCEPTION( invalid_operation_exception, "UDP GRO requires Linux" );
+  }
+#endif
+
   void   udp_socket::close() {
     //my->_sock.cancel(); 
     my->_sock.close();
   }
 
   fc::ip::endpoint udp_socket::local_endpoint()const {
-    return to_fc_ep( my->_sock.local_endpoint() );
+    return local_any_endpoint().to_v4();
+  }
+  fc::ip::any_endpoint udp_socket::local_any_endpoint()const {
+    return ip::to_any_endpoint( my->_sock.local_endpoint() );
   }
   void udp_socket::connect( const fc::ip::endpoint& e ) {
-     my->_sock.connect( to_asio_ep(e) );
+     connect( ip::any_endpoint(e) );
+  }
+  void udp_socket::connect( const fc::ip::any_endpoint& e ) {
+     my->_sock.connect( my->to_asio_ep(e) );
   }
 
   void   udp_socket::set_multicast_enable_loopback( bool s )
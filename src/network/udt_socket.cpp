@@ -5,6 +5,8 @@
 #include <fc/network/ip.hpp>
 #include <udt.h>
 
+#include <boost/atomic.hpp>
+
 #ifndef WIN32
 # include <arpa/inet.h>
 #endif
@@ -22,11 +24,25 @@ namespace fc {
       }
    }
    
+   /**
+    *  Wakes the fibers waiting on UDT sockets from a single UDT epoll thread.
+    *
+    *  UDT's epoll is level triggered, a watched socket that stays readable or
+    *  writable is reported on every pass.  So each socket keeps its epoll
+    *  registration between waits and only gives up an event once it is
+    *  reported with nobody waiting for it, instead of being added again on
+    *  every wait and reported for as long as it is polled.
+    *
+    *  The waiters live in per socket slots spread over independently locked
+    *  shards, so fibers of different threads and the poll loop only contend
+    *  when their sockets share a shard.
+    */
    class udt_epoll_service 
    {
       public:
          udt_epoll_service()
-         :_epoll_thread("udt_epoll")
+         :_stopping(false),
+          _epoll_thread("udt_epoll")
          {
             UDT::startup();
             check_udt_errors();
@@ -36,6 +52,7 @@ namespace fc {
 
          ~udt_epoll_service()
          {
+            _stopping.store( true );
             _epoll_loop.cancel("udt_epoll_service is destructing");
             _epoll_loop.wait();
             UDT::cleanup();
@@ -45,97 +62,163 @@ namespace fc {
          {
             std::set<UDTSOCKET> read_ready;
             std::set<UDTSOCKET> write_ready;
-            while( !_epoll_loop.canceled() )
+            // not _epoll_loop.canceled(), the loop may start before _epoll_loop is assigned
+            while( !_stopping.load() )
             {
                UDT::epoll_wait( _epoll_id, 
                                 &read_ready, 
                                 &write_ready, 100000000 );
 
-               { synchronized(_read_promises_mutex)
-                  for( auto sock : read_ready )
-                  {
-                     auto itr = _read_promises.find( sock );
-                     if( itr != _read_promises.end() )
-                     {
-                        itr->second->set_value();
-                        _read_promises.erase(itr);
-                     }
-                  }
-               } // synchronized read promise mutex
-
-               { synchronized(_write_promises_mutex)
-                  for( auto sock : write_ready )
-                  {
-                     auto itr = _write_promises.find( sock );
-                     if( itr != _write_promises.end() )
-                     {
-                        itr->second->set_value();
-                        _write_promises.erase(itr);
-                     }
-                  }
-               } // synchronized write promise mutex
+               for( auto sock : read_ready )
+                  ready( sock, UDT_EPOLL_IN );
+               for( auto sock : write_ready )
+                  ready( sock, UDT_EPOLL_OUT );
             } // while not canceled
          } // poll_loop
 
 
-         void notify_read( int udt_socket_id, 
-                           const promise<void>::ptr& p )
+         /**
+          *  Polls @p udt_socket_id for @p events until it is removed, even while
+          *  nobody waits.  UDT drops events of unconnected sockets that are not
+          *  polled yet, so a listening socket has to be added before anything
+          *  can happen to it.
+          */
+         void add( int udt_socket_id, int events )
          {
-            int events = UDT_EPOLL_IN | UDT_EPOLL_ERR;
-            if( 0 != UDT::epoll_add_usock( _epoll_id, 
-                                           udt_socket_id, 
-                                           &events ) )
-            {
-               check_udt_errors();
+            shard& s = shard_for( udt_socket_id );
+            { synchronized(s.lock)
+               socket_slot& slot = s.slots[udt_socket_id];
+               slot.persistent |= events;
+               watch( udt_socket_id, slot, slot.events | events );
             }
-            { synchronized(_read_promises_mutex)
+         }
 
-               _read_promises[udt_socket_id] = p;
+         void notify_read( int udt_socket_id, 
+                           const promise<void>::ptr& p )
+         {
+            shard& s = shard_for( udt_socket_id );
+            { synchronized(s.lock)
+               socket_slot& slot = s.slots[udt_socket_id];
+               slot.read_waiter = p;
+               watch( udt_socket_id, slot, slot.events | UDT_EPOLL_IN );
             }
          }
 
          void notify_write( int udt_socket_id,
                             const promise<void>::ptr& p )
          {
-            int events = UDT_EPOLL_OUT | UDT_EPOLL_ERR;
-            if( 0 != UDT::epoll_add_usock( _epoll_id, 
-                                  udt_socket_id, 
-                                  &events ) )
-            {
-              check_udt_errors();
-            }
-
-            { synchronized(_write_promises_mutex)
-               _write_promises[udt_socket_id] = p;
+            shard& s = shard_for( udt_socket_id );
+            { synchronized(s.lock)
+               socket_slot& slot = s.slots[udt_socket_id];
+               slot.write_waiter = p;
+               watch( udt_socket_id, slot, slot.events | UDT_EPOLL_OUT );
             }
          }
+
          void remove( int udt_socket_id )
          {
-             { synchronized(_read_promises_mutex)
-                auto read_itr = _read_promises.find( udt_socket_id );
-                if( read_itr != _read_promises.end() )
-                {
-                   read_itr->second->set_exception( fc::copy_exception( fc::exception() ) );
-                   _read_promises.erase(read_itr);
-                }
-             }
-             { synchronized(_write_promises_mutex)
-                auto write_itr = _write_promises.find( udt_socket_id );
-                if( write_itr != _write_promises.end() )
-                {
-                   write_itr->second->set_exception( fc::copy_exception( fc::exception() ) );
-                   _write_promises.erase(write_itr);
-                }
-             }
-             UDT::epoll_remove_usock( _epoll_id, udt_socket_id );
+            promise<void>::ptr read_waiter;
+            promise<void>::ptr write_waiter;
+            shard& s = shard_for( udt_socket_id );
+            { synchronized(s.lock)
+               auto itr = s.slots.find( udt_socket_id );
+               if( itr == s.slots.end() )
+                  return;
+               read_waiter  = itr->second.read_waiter;
+               write_waiter = itr->second.write_waiter;
+               s.slots.erase( itr );
+               UDT::epoll_remove_usock( _epoll_id, udt_socket_id );
+            }
+            if( read_waiter )
+               read_waiter->set_exception( fc::copy_exception( fc::exception() ) );
+            if( write_waiter )
+               write_waiter->set_exception( fc::copy_exception( fc::exception() ) );
          }
 
       private:
-         fc::mutex                                    _read_promises_mutex;
-         fc::mutex                                    _write_promises_mutex;
-         std::unordered_map<int, promise<void>::ptr > _read_promises;
-         std::unordered_map<int, promise<void>::ptr > _write_promises;
+         struct socket_slot
+         {
+            socket_slot():events(0),persistent(0){}
+
+            promise<void>::ptr  read_waiter;
+            promise<void>::ptr  write_waiter;
+            int                 events;      // registered with UDT
+            int                 persistent;  // kept registered without waiters
+         };
+
+         struct shard
+         {
+            fc::mutex                                lock;
+            std::unordered_map<int, socket_slot>     slots;
+         };
 
+         enum { shard_count = 16 };
+
+         shard& shard_for( int udt_socket_id )
+         {
+            return _shards[ unsigned(udt_socket_id) % shard_count ];
+         }
+
+         /**
+          *  Changes the registration of @p udt_socket_id to @p events, called with
+          *  its shard locked so the registration always matches the slot.  UDT can
+          *  only add events or drop a socket entirely, re-adding a socket reports
+          *  its current state again.
+          */
+         void watch( int udt_socket_id, socket_slot& slot, int events )
+         {
+            if( events == slot.events )
+               return;
+            if( events & ~slot.events )
+            {
+               if( 0 != UDT::epoll_add_usock( _epoll_id, 
+                                              udt_socket_id, 
+                                              &events ) )
+               {
+                  check_udt_errors();
+               }
+            }
+            else
+            {
+               UDT::epoll_remove_usock( _epoll_id, udt_socket_id );
+               if( events && 0 != UDT::epoll_add_usock( _epoll_id, udt_socket_id, &events ) )
+                  check_udt_errors();
+            }
+            slot.events = events;
+         }
+
+         /** wakes the waiter for @p event or stops polling for an event nobody waits for */
+         void ready( int udt_socket_id, int event )
+         {
+            promise<void>::ptr waiter;
+            shard& s = shard_for( udt_socket_id );
+            { synchronized(s.lock)
+               auto itr = s.slots.find( udt_socket_id );
+               if( itr == s.slots.end() )
+                  return;
+               socket_slot& slot = itr->second;
+               promise<void>::ptr& slot_waiter = event == UDT_EPOLL_IN ? slot.read_waiter : slot.write_waiter;
+               waiter = slot_waiter;
+               slot_waiter.reset();
+               if( !waiter && !(slot.persistent & event) && (slot.events & event) )
+               {
+                  try
+                  {
+                     watch( udt_socket_id, slot, slot.events & ~event );
+                  }
+                  catch( const fc::exception& e )
+                  {
+                     wlog( "${e}", ("e", e.to_detail_string() ) );
+                  }
+               }
+            }
+            if( waiter )
+               waiter->set_value();
+         }
+
+         shard                                        _shards[shard_count];
+
+         boost::atomic<bool> _stopping;
          fc::future<void> _epoll_loop;
          fc::thread _epoll_thread;
          int        _epoll_id;
@@ -144,8 +227,22 @@ namespace fc {
 
    udt_epoll_service& default_epool_service()
    {
-      static udt_epoll_service* default_service = new udt_epoll_service();
-      return *default_service;
+      // starting the epoll thread yields, so another fiber of this thread may
+      // ask for the service while it is being created and must wait on a fiber
+      // aware mutex rather than a static initialization guard
+      static fc::mutex                           init_mutex;
+      static boost::atomic<udt_epoll_service*>   default_service( nullptr );
+      udt_epoll_service* service = default_service.load( boost::memory_order_acquire );
+      if( !service )
+      { synchronized(init_mutex)
+         service = default_service.load( boost::memory_order_acquire );
+         if( !service )
+         {
+            service = new udt_epoll_service();
+            default_service.store( service, boost::memory_order_release );
+         }
+      }
+      return *service;
    }
 
 
@@ -189,18 +286,37 @@ namespace fc {
       serv_addr.sin_port = htons(remote_endpoint.port());
       serv_addr.sin_addr.s_addr = htonl(remote_endpoint.get_address());
 
-      // UDT doesn't allow now blocking connects... 
-      fc::thread connect_thread("connect_thread");
-      connect_thread.async( [&](){
-         if( UDT::ERROR == UDT::connect(_udt_socket_id, (sockaddr*)&serv_addr, sizeof(serv_addr)) )
-            check_udt_errors();
-      }, "udt_socket::connect_to").wait();
-
       bool block = false;
       UDT::setsockopt(_udt_socket_id, 0, UDT_SNDSYN, &block, sizeof(bool));
       UDT::setsockopt(_udt_socket_id, 0, UDT_RCVSYN, &block, sizeof(bool));
       check_udt_errors();
 
+      // a non blocking connect only sends the handshake, the epoll service reports the
+      // socket writable once it is connected or failed when the handshake times out
+      promise<void>::ptr connected(new promise<void>("udt_socket::connect_to"));
+      default_epool_service().notify_write( _udt_socket_id, connected );
+      if( UDT::ERROR == UDT::connect(_udt_socket_id, (sockaddr*)&serv_addr, sizeof(serv_addr)) )
+      {
+         default_epool_service().remove( _udt_socket_id );
+         check_udt_errors();
+      }
+      try
+      {
+         // UDT gives up on the handshake after 3 seconds but does not always
+         // report it through epoll, so do not wait for the report much longer
+         connected->wait( fc::seconds(5) );
+      }
+      catch( const fc::timeout_exception& )
+      {
+      }
+      // the socket stays writable, stop polling it until a read or write has to wait
+      default_epool_service().remove( _udt_socket_id );
+
+      const UDTSTATUS state = UDT::getsockstate( _udt_socket_id );
+      if( state != CONNECTED )
+         FC_THROW_EXCEPTION( udt_exception, "unable to connect to ${endpoint}, socket state ${state}",
+                             ("endpoint", remote_endpoint)("state", int(state)) );
+
    } FC_CAPTURE_AND_RETHROW( (remote_endpoint) ) }
 
    ip::endpoint udt_socket::remote_endpoint() const
@@ -390,6 +506,7 @@ namespace fc {
 
       UDT::listen(_udt_socket_id, 10);
       check_udt_errors();
+      default_epool_service().add( _udt_socket_id, UDT_EPOLL_IN | UDT_EPOLL_ERR );
   } FC_CAPTURE_AND_RETHROW( (ep) ) }
 
   fc::ip::endpoint udt_server::local_endpoint() const
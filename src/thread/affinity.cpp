@@ -0,0 +1,156 @@
+#include <fc/thread/affinity.hpp>
+#include <fc/exception/exception.hpp>
+#include "affinity.hpp"
+
+#include <boost/thread/thread.hpp>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if defined(__linux__)
+# include <errno.h>
+# include <pthread.h>
+# include <sched.h>
+# include <string.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#elif defined(_WIN32)
+# include <Windows.h>
+#endif
+
+namespace fc {
+
+   namespace {
+      std::vector<uint32_t> all_cpus()
+      {
+         std::vector<uint32_t> cpus( std::max( 1u, boost::thread::hardware_concurrency() ) );
+         for( uint32_t c = 0; c < cpus.size(); ++c )
+            cpus[c] = c;
+         return cpus;
+      }
+
+#ifdef __linux__
+      enum { mpol_preferred = 1 }; // MPOL_PREFERRED, numaif.h comes with libnuma which is not always installed
+
+      bool read_line( const std::string& path, std::string& line )
+      {
+         std::ifstream in( path.c_str() );
+         return bool( std::getline( in, line ) );
+      }
+
+      /** parses a list like "0-3,8-11" as the kernel writes cpu and node lists */
+      std::vector<uint32_t> parse_list( const std::string& list )
+      {
+         std::vector<uint32_t> ids;
+         std::istringstream in( list );
+         std::string range;
+         while( std::getline( in, range, ',' ) )
+         {
+            if( range.empty() )
+               continue;
+            const size_t dash = range.find( '-' );
+            const uint32_t first = uint32_t( std::stoul( range.substr( 0, dash ) ) );
+            const uint32_t last  = dash == std::string::npos ? first : uint32_t( std::stoul( range.substr( dash + 1 ) ) );
+            for( uint32_t id = first; id <= last; ++id )
+               ids.push_back( id );
+         }
+         return ids;
+      }
+#endif
+   }
+
+   uint32_t numa_node_count()
+   {
+#if defined(__linux__)
+      std::string online;
+      if( read_line( "/sys/devices/system/node/online", online ) )
+      {
+         std::vector<uint32_t> nodes = parse_list( online );
+         if( !nodes.empty() )
+            return nodes.back() + 1;
+      }
+#elif defined(_WIN32)
+      ULONG highest = 0;
+      if( GetNumaHighestNodeNumber( &highest ) )
+         return uint32_t( highest ) + 1;
+#endif
+      return 1;
+   }
+
+   std::vector<uint32_t> numa_node_cpus( uint32_t node )
+   {
+      if( node >= numa_node_count() )
+         FC_THROW_EXCEPTION( invalid_arg_exception, "there is no NUMA node ${node}", ("node",node) );
+#if defined(__linux__)
+      std::string list;
+      if( read_line( "/sys/devices/system/node/node" + std::to_string( node ) + "/cpulist", list ) )
+         return parse_list( list );
+#elif defined(_WIN32)
+      ULONGLONG mask = 0;
+      if( GetNumaNodeProcessorMask( UCHAR(node), &mask ) )
+      {
+         std::vector<uint32_t> cpus;
+         for( uint32_t c = 0; c < 64; ++c )
+            if( mask & (ULONGLONG(1) << c) )
+               cpus.push_back( c );
+         return cpus;
+      }
+#endif
+      // no NUMA information, node 0 is the whole machine
+      return all_cpus();
+   }
+
+   namespace detail {
+
+      void pin_this_thread( const std::vector<uint32_t>& cpus )
+      {
+         if( cpus.empty() )
+            FC_THROW_EXCEPTION( invalid_arg_exception, "cannot pin a thread to no cpus" );
+#if defined(__linux__)
+         const uint32_t n = *std::max_element( cpus.begin(), cpus.end() ) + 1;
+         cpu_set_t* set = CPU_ALLOC( n );
+         const size_t size = CPU_ALLOC_SIZE( n );
+         CPU_ZERO_S( size, set );
+         for( uint32_t c : cpus )
+            CPU_SET_S( c, size, set );
+         const int err = pthread_setaffinity_np( pthread_self(), size, set );
+         CPU_FREE( set );
+         if( err )
+            FC_THROW_EXCEPTION( invalid_operation_exception, "unable to pin thread to ${n} cpus: ${error}",
+                                ("n",cpus.size())("error",strerror(err)) );
+#elif defined(_WIN32)
+         DWORD_PTR mask = 0;
+         for( uint32_t c : cpus )
+         {
+            if( c >= sizeof(mask) * 8 )
+               FC_THROW_EXCEPTION( invalid_arg_exception, "cpu ${c} is outside of this thread's processor group", ("c",c) );
+            mask |= DWORD_PTR(1) << c;
+         }
+         if( !SetThreadAffinityMask( GetCurrentThread(), mask ) )
+            FC_THROW_EXCEPTION( invalid_operation_exception, "unable to pin thread to ${n} cpus: error ${error}",
+                                ("n",cpus.size())("error",uint64_t(GetLastError())) );
+#else
+         FC_THROW_EXCEPTION( invalid_operation_exception, "pinning threads to cpus is not supported on this platform" );
+#endif
+      }
+
+      void prefer_numa_node( uint32_t node )
+      {
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+         const size_t bits = sizeof(unsigned long) * 8;
+         std::vector<unsigned long> mask( node / bits + 1 );
+         mask[node / bits] |= 1ul << (node % bits);
+         // maxnode counts one past the last bit the kernel reads
+         if( syscall( SYS_set_mempolicy, int(mpol_preferred), mask.data(), mask.size() * bits + 1 ) != 0 )
+            FC_THROW_EXCEPTION( invalid_operation_exception, "unable to prefer NUMA node ${node}: ${error}",
+                                ("node",node)("error",strerror(errno)) );
+#else
+         // Windows and the rest already fault pages in on the node of the cpu that touches them first
+         (void)node;
+#endif
+      }
+
+   } // namespace detail
+
+} // namespace fc
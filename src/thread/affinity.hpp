@@ -0,0 +1,20 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+namespace fc { namespace detail {
+
+   /** pins the calling OS thread to @p cpus */
+   void pin_this_thread( const std::vector<uint32_t>& cpus );
+
+   /** makes @p node the preferred node for memory the calling OS thread faults in */
+   void prefer_numa_node( uint32_t node );
+
+   /**
+    *  Hands the promise blocks the calling thread has cached to the depot of
+    *  its old node and takes blocks from the depot of @p node from now on,
+    *  defined in promise_allocator.cpp.
+    */
+   void set_promise_storage_node( uint32_t node );
+
+} } // namespace fc::detail
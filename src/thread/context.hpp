@@ -8,16 +8,12 @@
 
 #if BOOST_VERSION >= 105400
 # include <boost/coroutine/stack_context.hpp>
+# include <boost/assert.hpp>
+# include "stack_pool.hpp"
   namespace bc  = boost::context;
   namespace bco = boost::coroutines;
-# if BOOST_VERSION >= 105600 && !defined(NDEBUG)
-#  include <boost/assert.hpp>
-#  include <boost/coroutine/protected_stack_allocator.hpp>
-  typedef bco::protected_stack_allocator stack_allocator;
-# else
-#  include <boost/coroutine/stack_allocator.hpp>
-  typedef bco::stack_allocator stack_allocator;
-# endif
+  // stacks come from the process wide fc::stack_pool, always with a guard page
+  typedef fc::stack_cache stack_allocator;
 
 #elif BOOST_VERSION >= 105300
   #include <boost/coroutine/stack_allocator.hpp>
@@ -48,9 +44,15 @@ namespace fc {
 #endif
 
 
-    context( void (*sf)(intptr_t), stack_allocator& alloc, fc::thread* t )
+    /**
+     *  @param stack_size requested size of the fiber's stack, rounded up by the
+     *         stack_pool.  Only honored with boost >= 1.54.
+     */
+    context( void (*sf)(intptr_t), stack_allocator& alloc, fc::thread* t,
+             size_t stack_size = FC_CONTEXT_STACK_SIZE )
     : caller_context(0),
       stack_alloc(&alloc),
+      stack_size(0),
       next_blocked(0), 
       next_blocked_mutex(0), 
       next(0), 
@@ -63,20 +65,17 @@ namespace fc {
       cur_task(0),
       context_posted_num(0)
     {
-#if BOOST_VERSION >= 105600
-     size_t stack_size = FC_CONTEXT_STACK_SIZE;
-     alloc.allocate(stack_ctx, stack_size);
-     my_context = bc::make_fcontext( stack_ctx.sp, stack_ctx.size, sf); 
-#elif BOOST_VERSION >= 105400
-     size_t stack_size = FC_CONTEXT_STACK_SIZE;
-     alloc.allocate(stack_ctx, stack_size);
+#if BOOST_VERSION >= 105400
+     stack_ctx.size = stack_size;
+     stack_ctx.sp = alloc.allocate(stack_ctx.size);
+     this->stack_size = stack_ctx.size;
      my_context = bc::make_fcontext( stack_ctx.sp, stack_ctx.size, sf);
 #elif BOOST_VERSION >= 105300
-     size_t stack_size = FC_CONTEXT_STACK_SIZE;
+     stack_size = FC_CONTEXT_STACK_SIZE;
      void*  stackptr = alloc.allocate(stack_size);
      my_context = bc::make_fcontext( stackptr, stack_size, sf);
 #else
-     size_t stack_size = FC_CONTEXT_STACK_SIZE;
+     stack_size = FC_CONTEXT_STACK_SIZE;
      my_context.fc_stack.base = alloc.allocate( stack_size );
      my_context.fc_stack.limit = static_cast<char*>( my_context.fc_stack.base) - stack_size;
      make_fcontext( &my_context, sf );
@@ -91,6 +90,7 @@ namespace fc {
 #endif
      caller_context(0),
      stack_alloc(0),
+     stack_size(0),
      next_blocked(0), 
      next_blocked_mutex(0), 
      next(0), 
@@ -107,10 +107,10 @@ namespace fc {
     ~context() {
 #if BOOST_VERSION >= 105600
       if(stack_alloc)
-        stack_alloc->deallocate( stack_ctx );
+        stack_alloc->deallocate( stack_ctx.sp, stack_ctx.size );
 #elif BOOST_VERSION >= 105400
       if(stack_alloc)
-        stack_alloc->deallocate( stack_ctx );
+        stack_alloc->deallocate( stack_ctx.sp, stack_ctx.size );
       else
         delete my_context;
 #elif BOOST_VERSION >= 105300
@@ -126,6 +126,7 @@ namespace fc {
 
     void reinitialize()
     {
+      BOOST_ASSERT( !timer.next );
       canceled = false;
 #ifndef NDEBUG
       cancellation_reason = nullptr;
@@ -216,6 +217,7 @@ namespace fc {
 #endif
     fc::context*                caller_context;
     stack_allocator*            stack_alloc;
+    size_t                       stack_size;         // usable size of our own stack, 0 for the thread's native stack (runs anything)
     priority                     prio;
     //promise_base*              prom; 
     std::vector<blocked_promise> blocking_prom;
@@ -232,6 +234,7 @@ namespace fc {
     bool                         complete;
     task_base*                   cur_task;
     uint64_t                     context_posted_num; // serial number set each tiem the context is added to the ready list
+    detail::timer_hook<context>  timer;              // links the context into its thread's sleep_queue while resume_time is pending
   };
 
 } // naemspace fc 
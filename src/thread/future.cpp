@@ -5,6 +5,7 @@
 #include <fc/exception/exception.hpp>
 
 #include <boost/assert.hpp>
+#include <boost/exception/diagnostic_information.hpp>
 
 
 namespace fc {
@@ -125,7 +126,14 @@ namespace fc {
     if( blocked_thread ) 
       blocked_thread->notify(ptr(this,true));
   }
-  promise_base::~promise_base() { }
+  promise_base::~promise_base() {
+    while( _compl )
+    {
+      detail::completion_handler* next = _compl->next;
+      delete _compl;
+      _compl = next;
+    }
+  }
   void promise_base::_set_timeout(){
     if( _ready ) 
       return;
@@ -134,21 +142,49 @@ namespace fc {
   void promise_base::_set_value(const void* s){
  //   slog( "%p == %d", &_ready, int(_ready));
 //    BOOST_ASSERT( !_ready );
+    detail::completion_handler* handler;
     { synchronized(_spin_yield) 
       if (_ready) //don't allow promise to be set more than once
         return;
       _ready = true;
+      // read under the lock, _on_complete() runs any handler installed after this itself
+      handler = _compl;
     }
     _notify();
-    if( nullptr != _compl ) {
-      _compl->on_complete(s,_exceptp);
+    // no handler is added once _ready is set, the list can be walked without the lock
+    for( ; nullptr != handler; handler = handler->next ) {
+      handler->on_complete(s,_exceptp);
     }
   }
-  void promise_base::_on_complete( detail::completion_handler* c ) {
+  bool promise_base::_on_complete( detail::completion_handler* c ) {
     { synchronized(_spin_yield) 
-        delete _compl; 
-        _compl = c;
+        if( _ready )
+          return false;
+        detail::completion_handler** tail = &_compl;
+        while( *tail )
+          tail = &(*tail)->next;
+        *tail = c;
     }
+    return true;
+  }
+  void promise_base::_complete_now( detail::completion_handler* c, const void* v ) {
+    std::unique_ptr<detail::completion_handler> owned(c);
+    c->on_complete( _exceptp ? nullptr : v, _exceptp );
   }
-}
 
+  namespace detail {
+    void run_on_thread( thread& t, std::function<void()> f, const char* desc ) {
+      t.async( fc::move(f), desc );
+    }
+
+    void set_current_exception( promise_base& p ) {
+      try {
+        throw;
+      } catch ( const exception& e ) {
+        p.set_exception( e.dynamic_copy_exception() );
+      } catch ( ... ) {
+        p.set_exception( std::make_shared<unhandled_exception>( FC_LOG_MESSAGE( warn, "unhandled exception: ${diagnostic}", ("diagnostic",boost::current_exception_diagnostic_information()) ) ) );
+      }
+    }
+  }
+}
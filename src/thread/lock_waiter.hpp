@@ -0,0 +1,105 @@
+#pragma once
+#include <fc/thread/thread.hpp>
+#include <fc/thread/spin_yield_lock.hpp>
+#include <fc/thread/unique_lock.hpp>
+#include "context.hpp"
+#include "thread_d.hpp"
+
+namespace fc { namespace detail {
+
+   /**
+    *  A fiber parked in a shared_mutex or semaphore.  It lives on the stack of
+    *  the waiting fiber and is linked into a doubly linked FIFO, so appending,
+    *  taking the front and dropping a canceled waiter are all O(1).
+    */
+   struct lock_waiter
+   {
+      lock_waiter( bool excl = false )
+      :ctx(current_context()),next(nullptr),prev(nullptr),exclusive(excl),granted(false){}
+
+      static fc::context* current_context()
+      {
+         thread_d* my = fc::thread::current().my;
+         if( !my->current )
+            my->current = new fc::context( &fc::thread::current() );
+         return my->current;
+      }
+
+      static void push_back( lock_waiter*& head, lock_waiter*& tail, lock_waiter* w )
+      {
+         w->prev = tail;
+         w->next = nullptr;
+         if( tail )
+            tail->next = w;
+         else
+            head = w;
+         tail = w;
+      }
+
+      static void unlink( lock_waiter*& head, lock_waiter*& tail, lock_waiter* w )
+      {
+         if( w->prev ) w->prev->next = w->next; else head = w->next;
+         if( w->next ) w->next->prev = w->prev; else tail = w->prev;
+         w->next = w->prev = nullptr;
+      }
+
+      /**
+       *  Unlinks the front waiter, marks it granted and chains it onto @p granted
+       *  through prev, call wake() on that chain once the lock is released.
+       */
+      static void grant_front( lock_waiter*& head, lock_waiter*& tail, lock_waiter*& granted )
+      {
+         lock_waiter* w = head;
+         unlink( head, tail, w );
+         w->granted = true;
+         w->prev = granted;
+         granted = w;
+      }
+
+      /** resumes every waiter on a chain built by grant_front() */
+      static void wake( lock_waiter* granted )
+      {
+         while( granted )
+         {
+            // the waiter may return and pop its node as soon as it is unblocked
+            lock_waiter* next = granted->prev;
+            fc::context* c = granted->ctx;
+            c->ctx_thread->my->unblock( c );
+            granted = next;
+         }
+      }
+
+      /**
+       *  Parks the calling fiber until a grant_front() picks it.  @p guard holds
+       *  the lock that protects the queue and is released before yielding.
+       *
+       *  @return the exception that interrupted the wait, if the fiber was
+       *  canceled.  The caller then has to take @p w out of the queue, or give
+       *  back what it was granted in the meantime, and rethrow.  That cleanup
+       *  may yield, so it cannot happen inside a catch block.
+       */
+      static std::exception_ptr park( fc::unique_lock<fc::spin_yield_lock>& guard,
+                                      lock_waiter*& head, lock_waiter*& tail, lock_waiter& w )
+      {
+         push_back( head, tail, &w );
+         guard.unlock();
+         try
+         {
+            fc::thread::current().yield(false);
+            BOOST_ASSERT( w.granted );
+         }
+         catch( ... )
+         {
+            return std::current_exception();
+         }
+         return std::exception_ptr();
+      }
+
+      fc::context*  ctx;
+      lock_waiter*  next;
+      lock_waiter*  prev;
+      bool          exclusive;
+      bool          granted;
+   };
+
+} } // namespace fc::detail
@@ -0,0 +1,61 @@
+#pragma once
+#include <boost/atomic.hpp>
+
+namespace fc {
+
+    /**
+     *  Unbounded lock-free multi-producer / single-consumer queue of intrusively
+     *  linked nodes, used as the inbox of tasks posted to a thread.
+     *
+     *  Producers push with a single CAS and never allocate.  The consumer takes
+     *  the whole backlog at once with pop_all(), which hands the batch back
+     *  oldest first.
+     */
+    template<typename Node, Node* Node::*Next>
+    class mpsc_queue {
+        public:
+           mpsc_queue():_head(nullptr){}
+
+           /**
+            *  @return true if the queue was empty before @p n was pushed
+            */
+           bool push( Node* n )
+           {
+              Node* stale_head = _head.load(boost::memory_order_relaxed);
+              do { n->*Next = stale_head;
+              } while( !_head.compare_exchange_weak( stale_head, n, boost::memory_order_seq_cst,
+                                                                    boost::memory_order_relaxed ) );
+              return stale_head == nullptr;
+           }
+
+           /**
+            *  Removes every queued node.
+            *  @return the oldest node, the rest follow through Next in the order they were pushed
+            */
+           Node* pop_all()
+           {
+              //DLN: changed from memory_order_consume for boost 1.55.
+              //This appears to be safest replacement for now, maybe
+              //can be changed to relaxed later, but needs analysis.
+              Node* newest = _head.exchange(nullptr, boost::memory_order_seq_cst);
+
+              // producers link each node to the one pushed before it, flip the
+              // batch around so it comes out in posting order
+              Node* oldest = nullptr;
+              while( newest )
+              {
+                 Node* n = newest->*Next;
+                 newest->*Next = oldest;
+                 oldest = newest;
+                 newest = n;
+              }
+              return oldest;
+           }
+
+           bool empty()const { return _head.load(boost::memory_order_seq_cst) == nullptr; }
+
+        private:
+           boost::atomic<Node*> _head;
+    };
+
+} // namespace fc
@@ -0,0 +1,203 @@
+#include <fc/thread/future.hpp>
+#include <fc/thread/spin_lock.hpp>
+#include <fc/thread/scoped_lock.hpp>
+#include "affinity.hpp"
+
+#include <boost/thread/tss.hpp>
+#include <new>
+#include <vector>
+
+namespace fc { namespace detail {
+
+   namespace {
+      /**
+       *  Every fc::async() allocates a task and most of them are released on another
+       *  thread than the one that created them.  Blocks are recycled through a small
+       *  cache per thread, a thread that frees more than it allocates passes whole
+       *  batches on to the depot where allocating threads pick them up again.
+       *
+       *  Threads placed on a NUMA node with thread::set_numa_node() share a depot
+       *  with the other threads of that node only, so blocks do not wander off
+       *  to threads on another node.
+       */
+      enum {
+         granularity = 64,   // size classes are multiples of this
+         num_classes = 32,   // blocks above 2KB go straight to operator new
+         batch_size  = 64,   // blocks moved between a thread cache and the depot at once
+         max_cached  = 2 * batch_size,
+         max_batches = 64,   // batches the depot keeps per class
+         max_depots  = 8     // nodes beyond this share depots
+      };
+
+      struct free_block
+      {
+         free_block* next;
+      };
+
+      struct depot
+      {
+         fc::spin_lock             lock;
+         std::vector<free_block*>  batches[num_classes];
+
+         static depot& instance( uint32_t node )
+         {
+            // leaked on purpose, threads flush their caches into them on exit
+            static depot* d = new depot[max_depots];
+            return d[node % max_depots];
+         }
+
+         /** @return false if the depot is full, the caller keeps @p batch */
+         bool put( uint32_t c, free_block* batch )
+         {
+            fc::scoped_lock<fc::spin_lock> l(lock);
+            if( batches[c].size() >= max_batches )
+               return false;
+            batches[c].push_back( batch );
+            return true;
+         }
+
+         free_block* take( uint32_t c )
+         {
+            fc::scoped_lock<fc::spin_lock> l(lock);
+            if( batches[c].empty() )
+               return nullptr;
+            free_block* batch = batches[c].back();
+            batches[c].pop_back();
+            return batch;
+         }
+      };
+
+      struct thread_cache
+      {
+         free_block* head[num_classes];
+         uint32_t    count[num_classes];
+         uint32_t    node;   // picks the depot
+
+         thread_cache():node(0)
+         {
+            for( uint32_t c = 0; c < num_classes; ++c )
+            {
+               head[c] = nullptr;
+               count[c] = 0;
+            }
+         }
+         ~thread_cache();
+
+         /** hands every cached block to the depot, or back to the heap if it is full */
+         void flush();
+
+         /** unlinks the first batch_size blocks of class @p c */
+         free_block* split_batch( uint32_t c )
+         {
+            free_block* batch = head[c];
+            free_block* last = batch;
+            for( uint32_t i = 1; i < batch_size; ++i )
+               last = last->next;
+            head[c] = last->next;
+            last->next = nullptr;
+            count[c] -= batch_size;
+            return batch;
+         }
+      };
+
+#ifdef _MSC_VER
+      static __declspec(thread) thread_cache* current_cache = nullptr;
+#else
+      static __thread thread_cache* current_cache = nullptr;
+#endif
+
+      void release_blocks( free_block* b )
+      {
+         while( b )
+         {
+            free_block* next = b->next;
+            ::operator delete( b );
+            b = next;
+         }
+      }
+
+      thread_cache::~thread_cache()
+      {
+         current_cache = nullptr;
+         flush();
+      }
+
+      void thread_cache::flush()
+      {
+         for( uint32_t c = 0; c < num_classes; ++c )
+         {
+            while( count[c] >= batch_size )
+            {
+               free_block* batch = split_batch( c );
+               if( !depot::instance( node ).put( c, batch ) )
+                  release_blocks( batch );
+            }
+            release_blocks( head[c] );
+            head[c] = nullptr;
+            count[c] = 0;
+         }
+      }
+
+      thread_cache* get_thread_cache()
+      {
+         if( !current_cache )
+         {
+            // the thread_specific_ptr only exists to hand the cache back when the thread exits
+            static boost::thread_specific_ptr<thread_cache>* owner = new boost::thread_specific_ptr<thread_cache>();
+            current_cache = new thread_cache();
+            owner->reset( current_cache );
+         }
+         return current_cache;
+      }
+   }
+
+   void* allocate_promise_storage( size_t size )
+   {
+      const uint32_t c = uint32_t( (size - 1) / granularity );
+      if( c >= num_classes )
+         return ::operator new( size );
+
+      thread_cache* cache = get_thread_cache();
+      if( !cache->head[c] )
+      {
+         cache->head[c] = depot::instance( cache->node ).take( c );
+         if( !cache->head[c] )
+            return ::operator new( (c + 1) * granularity );
+         cache->count[c] = batch_size;
+      }
+
+      free_block* b = cache->head[c];
+      cache->head[c] = b->next;
+      --cache->count[c];
+      return b;
+   }
+
+   void free_promise_storage( void* p, size_t size )
+   {
+      const uint32_t c = uint32_t( (size - 1) / granularity );
+      if( c >= num_classes )
+      {
+         ::operator delete( p );
+         return;
+      }
+
+      thread_cache* cache = get_thread_cache();
+      free_block* b = static_cast<free_block*>( p );
+      b->next = cache->head[c];
+      cache->head[c] = b;
+      if( ++cache->count[c] > max_cached )
+      {
+         free_block* batch = cache->split_batch( c );
+         if( !depot::instance( cache->node ).put( c, batch ) )
+            release_blocks( batch );
+      }
+   }
+
+   void set_promise_storage_node( uint32_t node )
+   {
+      thread_cache* cache = get_thread_cache();
+      cache->flush();
+      cache->node = node;
+   }
+
+} } // namespace fc::detail
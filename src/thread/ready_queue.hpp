@@ -0,0 +1,193 @@
+#pragma once
+#include <fc/thread/priority.hpp>
+#include <boost/assert.hpp>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#ifdef _MSC_VER
+# include <intrin.h>
+#endif
+
+namespace fc {
+
+    /**
+     *  Ready list of a thread: one FIFO ring per priority value plus a bitmap of
+     *  the rings that are not empty.
+     *
+     *  Almost every context runs at the default priority, so the heap this
+     *  replaces spent its time sorting equal keys.  Here push() appends to the
+     *  ring of the node's priority and front()/pop_front() take the oldest node
+     *  of the highest priority ring, both O(1).  Within one priority nodes come
+     *  out in the order they were pushed, which is the order of their posted
+     *  numbers, so the order is the same the heap gave.
+     *
+     *  Levels are created for priority values as they show up and are kept
+     *  sorted from highest to lowest; empty levels are dropped when a new
+     *  value needs room.
+     */
+    template<typename Node, priority Node::*Prio>
+    class ready_queue {
+        public:
+           enum { max_levels = 64 };   // one bit of _nonempty each
+
+           ready_queue():_nonempty(0),_size(0),_last_level(0){}
+
+           bool   empty()const { return _size == 0; }
+           size_t size()const  { return _size; }
+
+           void push( Node* n )
+           {
+              const uint32_t l = level_of( (n->*Prio).value );
+              _levels[l].push_back( n );
+              _nonempty |= uint64_t(1) << l;
+              ++_size;
+           }
+
+           Node* front()const
+           {
+              BOOST_ASSERT( _size );
+              return _levels[ lowest_bit( _nonempty ) ].front();
+           }
+
+           Node* pop_front()
+           {
+              BOOST_ASSERT( _size );
+              const uint32_t l = lowest_bit( _nonempty );
+              Node* n = _levels[l].pop_front();
+              if( _levels[l].empty() )
+                 _nonempty &= ~(uint64_t(1) << l);
+              --_size;
+              return n;
+           }
+
+           bool contains( const Node* n )const
+           {
+              for( const level& l : _levels )
+                 for( size_t i = 0; i < l.count; ++i )
+                    if( l.at(i) == n )
+                       return true;
+              return false;
+           }
+
+           /** calls @p f on every node, highest priority first */
+           template<typename Functor>
+           void for_each( Functor&& f )const
+           {
+              for( const level& l : _levels )
+                 for( size_t i = 0; i < l.count; ++i )
+                    f( l.at(i) );
+           }
+
+           void clear()
+           {
+              for( level& l : _levels )
+                 l.head = l.count = 0;
+              _nonempty = 0;
+              _size = 0;
+           }
+
+        private:
+           /** power of two ring of nodes that share one priority value */
+           struct level {
+              level( int p ):prio(p),head(0),count(0){}
+
+              bool   empty()const         { return count == 0; }
+              Node*  at( size_t i )const  { return ring[ (head + i) & (ring.size() - 1) ]; }
+              Node*  front()const         { return ring[head]; }
+
+              void push_back( Node* n )
+              {
+                 if( count == ring.size() )
+                    grow();
+                 ring[ (head + count) & (ring.size() - 1) ] = n;
+                 ++count;
+              }
+
+              Node* pop_front()
+              {
+                 Node* n = ring[head];
+                 head = (head + 1) & (ring.size() - 1);
+                 --count;
+                 return n;
+              }
+
+              void grow()
+              {
+                 std::vector<Node*> bigger( std::max<size_t>( 8, ring.size() * 2 ) );
+                 for( size_t i = 0; i < count; ++i )
+                    bigger[i] = at(i);
+                 ring.swap( bigger );
+                 head = 0;
+              }
+
+              int                 prio;
+              std::vector<Node*>  ring;
+              size_t              head;
+              size_t              count;
+           };
+
+           static uint32_t lowest_bit( uint64_t bits )
+           {
+#ifdef _MSC_VER
+              unsigned long i;
+              _BitScanForward64( &i, bits );
+              return uint32_t(i);
+#else
+              return uint32_t( __builtin_ctzll( bits ) );
+#endif
+           }
+
+           /** index of the level for @p prio, creating it if needed */
+           uint32_t level_of( int prio )
+           {
+              if( _last_level < _levels.size() && _levels[_last_level].prio == prio )
+                 return _last_level;
+
+              uint32_t l = 0;
+              while( l < _levels.size() && _levels[l].prio > prio )
+                 ++l;
+              if( l == _levels.size() || _levels[l].prio != prio )
+                 l = insert_level( l, prio );
+              _last_level = l;
+              return l;
+           }
+
+           uint32_t insert_level( uint32_t l, int prio )
+           {
+              if( _levels.size() == max_levels )
+              {
+                 drop_empty_levels();
+                 l = 0;
+                 while( l < _levels.size() && _levels[l].prio > prio )
+                    ++l;
+                 if( _levels.size() == max_levels )
+                 {
+                    // more distinct priorities are ready at once than we have bits,
+                    // share the nearest level
+                    BOOST_ASSERT( !"too many distinct priorities on the ready list" );
+                    return std::min<uint32_t>( l, max_levels - 1 );
+                 }
+              }
+              _levels.insert( _levels.begin() + l, level(prio) );
+              const uint64_t below = _nonempty & ((uint64_t(1) << l) - 1);
+              _nonempty = below | ((_nonempty & ~below) << 1);
+              return l;
+           }
+
+           void drop_empty_levels()
+           {
+              _levels.erase( std::remove_if( _levels.begin(), _levels.end(),
+                                             []( const level& l ){ return l.empty(); } ),
+                             _levels.end() );
+              _nonempty = _levels.size() == max_levels ? ~uint64_t(0) : (uint64_t(1) << _levels.size()) - 1;
+              _last_level = 0;
+           }
+
+           std::vector<level>  _levels;     // sorted from highest to lowest priority
+           uint64_t            _nonempty;   // bit i is set while _levels[i] holds nodes
+           size_t              _size;
+           uint32_t            _last_level; // level of the last push, nearly always the next one too
+    };
+
+} // namespace fc
@@ -0,0 +1,80 @@
+#include <fc/thread/semaphore.hpp>
+#include "lock_waiter.hpp"
+
+namespace fc {
+
+  semaphore::semaphore( uint32_t initial_count )
+  :_count(initial_count),
+   _head(nullptr),
+   _tail(nullptr)
+  {}
+
+  semaphore::~semaphore()
+  {
+    BOOST_ASSERT( !_head && "Attempt to free semaphore while others are blocking on it." );
+  }
+
+  void semaphore::wait()
+  {
+    fc::unique_lock<fc::spin_yield_lock> guard(_lock);
+    if( _count )
+    {
+      --_count;
+      return;
+    }
+
+    detail::lock_waiter w;
+    std::exception_ptr e = detail::lock_waiter::park( guard, _head, _tail, w );
+    if( e )
+    {
+      abandon( w );
+      std::rethrow_exception( e );
+    }
+  }
+
+  bool semaphore::try_wait()
+  {
+    fc::unique_lock<fc::spin_yield_lock> guard(_lock);
+    if( !_count )
+      return false;
+    --_count;
+    return true;
+  }
+
+  void semaphore::post( uint32_t count )
+  {
+    detail::lock_waiter* granted = nullptr;
+    {
+      fc::unique_lock<fc::spin_yield_lock> guard(_lock);
+      _count += count;
+      grant_waiters( granted );
+    }
+    detail::lock_waiter::wake( granted );
+  }
+
+  /** called with _lock held, hands free permits to parked fibers in FIFO order */
+  void semaphore::grant_waiters( detail::lock_waiter*& granted )
+  {
+    while( _count && _head )
+    {
+      --_count;
+      detail::lock_waiter::grant_front( _head, _tail, granted );
+    }
+  }
+
+  /** the waiting fiber was canceled, give back the permit it may have been handed */
+  void semaphore::abandon( detail::lock_waiter& w )
+  {
+    detail::lock_waiter* granted = nullptr;
+    {
+      fc::unique_lock<fc::spin_yield_lock> guard(_lock);
+      if( !w.granted )
+        detail::lock_waiter::unlink( _head, _tail, &w );
+      else
+        ++_count;
+      grant_waiters( granted );
+    }
+    detail::lock_waiter::wake( granted );
+  }
+
+} // namespace fc
@@ -0,0 +1,139 @@
+#include <fc/thread/shared_mutex.hpp>
+#include "lock_waiter.hpp"
+
+namespace fc {
+
+  shared_mutex::shared_mutex()
+  :_readers(0),
+   _writer(false),
+   _head(nullptr),
+   _tail(nullptr)
+  {}
+
+  shared_mutex::~shared_mutex()
+  {
+    BOOST_ASSERT( !_head && "Attempt to free shared_mutex while others are blocking on lock." );
+  }
+
+  void shared_mutex::lock()
+  {
+    fc::unique_lock<fc::spin_yield_lock> guard(_lock);
+    if( !_writer && !_readers && !_head )
+    {
+      _writer = true;
+      return;
+    }
+
+    detail::lock_waiter w(true);
+    std::exception_ptr e = detail::lock_waiter::park( guard, _head, _tail, w );
+    if( e )
+    {
+      abandon( w );
+      std::rethrow_exception( e );
+    }
+  }
+
+  bool shared_mutex::try_lock()
+  {
+    fc::unique_lock<fc::spin_yield_lock> guard(_lock);
+    if( _writer || _readers || _head )
+      return false;
+    _writer = true;
+    return true;
+  }
+
+  void shared_mutex::unlock()
+  {
+    detail::lock_waiter* granted = nullptr;
+    {
+      fc::unique_lock<fc::spin_yield_lock> guard(_lock);
+      BOOST_ASSERT( _writer );
+      _writer = false;
+      grant_waiters( granted );
+    }
+    detail::lock_waiter::wake( granted );
+  }
+
+  void shared_mutex::lock_shared()
+  {
+    fc::unique_lock<fc::spin_yield_lock> guard(_lock);
+    // queue behind anyone already waiting, otherwise readers could starve a writer
+    if( !_writer && !_head )
+    {
+      ++_readers;
+      return;
+    }
+
+    detail::lock_waiter w(false);
+    std::exception_ptr e = detail::lock_waiter::park( guard, _head, _tail, w );
+    if( e )
+    {
+      abandon( w );
+      std::rethrow_exception( e );
+    }
+  }
+
+  bool shared_mutex::try_lock_shared()
+  {
+    fc::unique_lock<fc::spin_yield_lock> guard(_lock);
+    if( _writer || _head )
+      return false;
+    ++_readers;
+    return true;
+  }
+
+  void shared_mutex::unlock_shared()
+  {
+    detail::lock_waiter* granted = nullptr;
+    {
+      fc::unique_lock<fc::spin_yield_lock> guard(_lock);
+      BOOST_ASSERT( _readers > 0 );
+      if( --_readers == 0 )
+        grant_waiters( granted );
+    }
+    detail::lock_waiter::wake( granted );
+  }
+
+  /**
+   *  Called with _lock held when the lock may have become available: hands it to
+   *  the writer at the front of the queue, or to every reader up to the next writer.
+   */
+  void shared_mutex::grant_waiters( detail::lock_waiter*& granted )
+  {
+    if( _writer || !_head )
+      return;
+    if( _head->exclusive )
+    {
+      if( _readers == 0 )
+      {
+        _writer = true;
+        detail::lock_waiter::grant_front( _head, _tail, granted );
+      }
+      return;
+    }
+    while( _head && !_head->exclusive )
+    {
+      ++_readers;
+      detail::lock_waiter::grant_front( _head, _tail, granted );
+    }
+  }
+
+  /** the waiting fiber was canceled, undo whatever the wait left behind */
+  void shared_mutex::abandon( detail::lock_waiter& w )
+  {
+    detail::lock_waiter* granted = nullptr;
+    {
+      fc::unique_lock<fc::spin_yield_lock> guard(_lock);
+      if( !w.granted )
+        detail::lock_waiter::unlink( _head, _tail, &w );
+      else if( w.exclusive )
+        _writer = false;
+      else
+        --_readers;
+      // a canceled writer at the front may have been holding back the readers behind it
+      grant_waiters( granted );
+    }
+    detail::lock_waiter::wake( granted );
+  }
+
+} // namespace fc
@@ -4,10 +4,104 @@
 #include <boost/memory_order.hpp>
 #include <new>
 
+#ifdef __linux__
+# include <linux/futex.h>
+# include <sys/syscall.h>
+# include <time.h>
+# include <unistd.h>
+#else
+# include <boost/thread/mutex.hpp>
+# include <boost/thread/condition_variable.hpp>
+#endif
+
+#if defined(_MSC_VER)
+# include <windows.h>
+#elif defined(__i386__) || defined(__x86_64__)
+# include <immintrin.h>
+#endif
+
 namespace fc {
   void yield();
 
+  namespace {
+    enum {
+      max_backoff  = 64,    // pause instructions in the last spin round
+      park_timeout = 1000   // microseconds a waiter parks before it yields to its fibers again
+    };
+
+    inline void cpu_relax()
+    {
+#if defined(_MSC_VER)
+      YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+      _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+      __asm__ __volatile__( "yield" );
+#endif
+    }
+
+    /** small number that identifies the calling OS thread, never 0 */
+    uint32_t this_thread_id()
+    {
+      static boost::atomic<uint32_t> next_id(1);
+#ifdef _MSC_VER
+      static __declspec(thread) uint32_t id = 0;
+#else
+      static __thread uint32_t id = 0;
+#endif
+      if( !id )
+        id = next_id++;
+      return id;
+    }
+
+#ifdef __linux__
+    /** sleeps while *word == expected, at most park_timeout */
+    void park( boost::atomic<int>* word, int expected )
+    {
+      timespec timeout = { 0, park_timeout * 1000 };
+      syscall( SYS_futex, reinterpret_cast<int*>(word), FUTEX_WAIT_PRIVATE, expected, &timeout, nullptr, 0 );
+    }
+
+    void unpark_one( boost::atomic<int>* word )
+    {
+      syscall( SYS_futex, reinterpret_cast<int*>(word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0 );
+    }
+#else
+    /** locks share a small table of condition variables, keyed by address */
+    struct parking_slot
+    {
+      boost::mutex              mutex;
+      boost::condition_variable cond;
+    };
+
+    parking_slot& slot_for( const void* word )
+    {
+      enum { num_slots = 64 };
+      // leaked on purpose, locks may still be released while static destructors run
+      static parking_slot* slots = new parking_slot[num_slots];
+      return slots[ (reinterpret_cast<uintptr_t>(word) >> 4) % num_slots ];
+    }
+
+    void park( boost::atomic<int>* word, int expected )
+    {
+      parking_slot& s = slot_for( word );
+      boost::unique_lock<boost::mutex> l( s.mutex );
+      if( word->load() == expected )
+        s.cond.wait_for( l, boost::chrono::microseconds( park_timeout ) );
+    }
+
+    void unpark_one( boost::atomic<int>* word )
+    {
+      parking_slot& s = slot_for( word );
+      boost::unique_lock<boost::mutex> l( s.mutex );
+      // other locks may share the slot, wake them all and let them recheck
+      s.cond.notify_all();
+    }
+#endif
+  }
+
   #define define_self  boost::atomic<int>* self = (boost::atomic<int>*)&_lock
+  #define define_owner boost::atomic<uint32_t>* owner = (boost::atomic<uint32_t>*)&_owner
 
   spin_yield_lock::spin_yield_lock() 
   {
@@ -15,11 +109,22 @@ namespace fc {
      new (self) boost::atomic<int>();
      static_assert( sizeof(boost::atomic<int>) == sizeof(_lock), "" );
      self->store(unlocked);
+     define_owner;
+     new (owner) boost::atomic<uint32_t>();
+     static_assert( sizeof(boost::atomic<uint32_t>) == sizeof(_owner), "" );
+     owner->store(0);
+#ifndef NDEBUG
+     _stats = stats();
+#endif
   }
 
   bool spin_yield_lock::try_lock() {
     define_self;
-    return self->exchange(locked, boost::memory_order_acquire)!=locked;
+    int expected = unlocked;
+    if( !self->compare_exchange_strong( expected, locked, boost::memory_order_acquire ) )
+      return false;
+    note_acquired( 0, 0, 0 );
+    return true;
   }
 
   bool spin_yield_lock::try_lock_for( const fc::microseconds& us ) {
@@ -36,16 +141,81 @@ namespace fc {
   }
 
   void spin_yield_lock::lock() {
+    if( !try_lock() )
+      lock_contended();
+  }
+
+  void spin_yield_lock::lock_contended() {
     define_self;
-    while( self->exchange(locked, boost::memory_order_acquire)==locked) {
-      yield(); 
+    define_owner;
+    uint32_t spins = 0;
+    uint32_t yields = 0;
+    uint32_t parks = 0;
+    for(;;) {
+      // the holder is another fiber of this thread, yielding to it is the only
+      // way it will ever let go
+      if( owner->load( boost::memory_order_relaxed ) == this_thread_id() ) {
+        yield();
+        ++yields;
+        int expected = unlocked;
+        if( self->compare_exchange_strong( expected, parks ? locked_parked : locked, boost::memory_order_acquire ) ) {
+          note_acquired( spins, yields, parks );
+          return;
+        }
+        continue;
+      }
+
+      // the holder runs on another OS thread and is most likely about to let go,
+      // spin on a plain load so the cache line is only written when it looks free
+      for( uint32_t backoff = 1; backoff <= max_backoff; backoff <<= 1 ) {
+        for( uint32_t i = 0; i < backoff; ++i )
+          cpu_relax();
+        ++spins;
+        int expected = unlocked;
+        if( self->load( boost::memory_order_relaxed ) == unlocked &&
+            self->compare_exchange_strong( expected, parks ? locked_parked : locked, boost::memory_order_acquire ) ) {
+          note_acquired( spins, yields, parks );
+          return;
+        }
+      }
+
+      // let the other fibers of this thread run before the thread parks
+      yield();
+      ++yields;
+
+      // park until the holder unlocks, flagging the lock so that unlock()
+      // knows there is someone to wake
+      if( self->exchange( locked_parked, boost::memory_order_acquire ) == unlocked ) {
+        note_acquired( spins, yields, parks );
+        return;
+      }
+      park( self, locked_parked );
+      ++parks;
+    }
+  }
+
+  void spin_yield_lock::note_acquired( uint32_t spins, uint32_t yields, uint32_t parks ) {
+    define_owner;
+    owner->store( this_thread_id(), boost::memory_order_relaxed );
+#ifndef NDEBUG
+    ++_stats.acquisitions;
+    if( spins || yields || parks ) {
+      ++_stats.contended;
+      _stats.spins += spins;
+      _stats.yields += yields;
+      _stats.parks += parks;
     }
+#endif
   }
 
   void spin_yield_lock::unlock() {
     define_self;
-    self->store(unlocked, boost::memory_order_release);
+    define_owner;
+    owner->store( 0, boost::memory_order_relaxed );
+    if( self->exchange(unlocked, boost::memory_order_release) == locked_parked )
+      unpark_one( self );
   }
   #undef define_self
+  #undef define_owner
 
 } // namespace fc
@@ -0,0 +1,196 @@
+#include "stack_pool.hpp"
+#include <fc/thread/scoped_lock.hpp>
+#include <new>
+
+#ifdef _WIN32
+# include <Windows.h>
+#else
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+namespace fc {
+
+   stack_pool& stack_pool::instance()
+   {
+      // leaked on purpose, fibers of other threads may still give stacks back
+      // while static destructors run
+      static stack_pool* pool = new stack_pool();
+      return *pool;
+   }
+
+   size_t stack_pool::page_size()
+   {
+#ifdef _WIN32
+      static const size_t size = [](){ SYSTEM_INFO si; GetSystemInfo(&si); return size_t(si.dwPageSize); }();
+#else
+      static const size_t size = size_t(sysconf(_SC_PAGESIZE));
+#endif
+      return size;
+   }
+
+   size_t stack_pool::round_size( size_t size )
+   {
+      size_t rounded = min_stack_size;
+      for( uint32_t c = 1; c < num_classes && rounded < size; ++c )
+         rounded <<= 1;
+      if( rounded >= size )
+         return rounded;
+
+      // too big to pool, just round up to whole pages
+      const size_t page = page_size();
+      return (size + page - 1) / page * page;
+   }
+
+   uint32_t stack_pool::class_of( size_t rounded_size )
+   {
+      size_t s = min_stack_size;
+      for( uint32_t c = 0; c < num_classes; ++c, s <<= 1 )
+         if( s == rounded_size )
+            return c;
+      return num_classes;
+   }
+
+#ifdef _WIN32
+   /**
+    *  Gives the stack below @p top the shape of a fresh thread stack: only the
+    *  top page is committed, with a PAGE_GUARD page under it.  Touching the guard
+    *  page commits it and moves the guard one page down, as the OS does for
+    *  thread stacks, and the uncommitted page at the very bottom stays as the
+    *  hard guard.
+    */
+   static bool commit_top_page( char* top )
+   {
+      const size_t page = stack_pool::page_size();
+      return VirtualAlloc( top - page, page, MEM_COMMIT, PAGE_READWRITE ) &&
+             VirtualAlloc( top - 2 * page, page, MEM_COMMIT, PAGE_READWRITE | PAGE_GUARD );
+   }
+#endif
+
+   void* stack_pool::map( size_t size )
+   {
+      const size_t guard = page_size();
+#ifdef _WIN32
+      // reserve only, MEM_COMMIT would charge the whole stack against the commit limit
+      char* base = static_cast<char*>( VirtualAlloc( nullptr, size + guard, MEM_RESERVE, PAGE_NOACCESS ) );
+      if( !base )
+         throw std::bad_alloc();
+      if( !commit_top_page( base + guard + size ) )
+      {
+         VirtualFree( base, 0, MEM_RELEASE );
+         throw std::bad_alloc();
+      }
+#else
+      int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+# ifdef MAP_NORESERVE
+      flags |= MAP_NORESERVE;
+# endif
+# ifdef MAP_STACK
+      flags |= MAP_STACK;
+# endif
+      void* mapped = mmap( nullptr, size + guard, PROT_READ | PROT_WRITE, flags, -1, 0 );
+      if( mapped == MAP_FAILED )
+         throw std::bad_alloc();
+      char* base = static_cast<char*>( mapped );
+      mprotect( base, guard, PROT_NONE );
+#endif
+      return base + guard + size;
+   }
+
+   void stack_pool::unmap( void* sp, size_t size )
+   {
+      const size_t guard = page_size();
+      char* base = static_cast<char*>( sp ) - size - guard;
+#ifdef _WIN32
+      VirtualFree( base, 0, MEM_RELEASE );
+#else
+      munmap( base, size + guard );
+#endif
+   }
+
+   void stack_pool::discard( void* sp, size_t size )
+   {
+      char* bottom = static_cast<char*>( sp ) - size;
+#ifdef _WIN32
+      // decommit whatever the fiber grew into and start over from one page, so
+      // a pooled stack holds no more memory than a new one
+      VirtualFree( bottom, size, MEM_DECOMMIT );
+      commit_top_page( bottom + size );
+#else
+      madvise( bottom, size, MADV_DONTNEED );
+#endif
+   }
+
+   void* stack_pool::allocate( size_t& size )
+   {
+      size = round_size( size );
+      const uint32_t c = class_of( size );
+      if( c < num_classes )
+      {
+         fc::scoped_lock<boost::mutex> l(_lock);
+         if( !_free[c].empty() )
+         {
+            void* sp = _free[c].back();
+            _free[c].pop_back();
+            return sp;
+         }
+      }
+      return map( size );
+   }
+
+   void stack_pool::deallocate( void* sp, size_t size )
+   {
+      const uint32_t c = class_of( size );
+      if( c < num_classes )
+      {
+         discard( sp, size );
+         fc::scoped_lock<boost::mutex> l(_lock);
+         if( _free[c].size() < max_pooled )
+         {
+            _free[c].push_back( sp );
+            return;
+         }
+      }
+      unmap( sp, size );
+   }
+
+   stack_cache::~stack_cache()
+   {
+      clear();
+   }
+
+   void stack_cache::clear()
+   {
+      for( uint32_t c = 0; c < stack_pool::num_classes; ++c )
+      {
+         for( void* sp : _free[c] )
+            stack_pool::instance().deallocate( sp, size_t(stack_pool::min_stack_size) << c );
+         _free[c].clear();
+      }
+   }
+
+   void* stack_cache::allocate( size_t& size )
+   {
+      size = stack_pool::round_size( size );
+      const uint32_t c = stack_pool::class_of( size );
+      if( c < stack_pool::num_classes && !_free[c].empty() )
+      {
+         void* sp = _free[c].back();
+         _free[c].pop_back();
+         return sp;
+      }
+      return stack_pool::instance().allocate( size );
+   }
+
+   void stack_cache::deallocate( void* sp, size_t size )
+   {
+      const uint32_t c = stack_pool::class_of( size );
+      if( c < stack_pool::num_classes && _free[c].size() < max_cached )
+      {
+         _free[c].push_back( sp );
+         return;
+      }
+      stack_pool::instance().deallocate( sp, size );
+   }
+
+} // namespace fc
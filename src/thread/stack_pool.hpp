@@ -0,0 +1,85 @@
+#pragma once
+#include <boost/thread/mutex.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fc {
+
+    /**
+     *  Process-wide pool of fiber stacks.
+     *
+     *  Stacks are mapped straight from the OS with an inaccessible guard page
+     *  below them, so pages are only committed as the fiber touches them and an
+     *  overflow faults instead of scribbling over the neighbouring stack.  On
+     *  Windows stacks are only reserved and grow through a PAGE_GUARD page, as
+     *  thread stacks do.  Sizes are rounded up to a power of two class.  When a
+     *  stack is handed back its pages are returned to the OS (MADV_DONTNEED or
+     *  MEM_DECOMMIT) and the mapping is kept for the next fiber of the same class.
+     *
+     *  Threads do not call the pool directly, they go through a stack_cache.
+     */
+    class stack_pool {
+        public:
+           enum {
+              min_stack_size = 16 * 1024,
+              num_classes    = 10,      // 16KB ... 8MB, larger stacks are mapped and unmapped every time
+              max_pooled     = 256      // stacks kept per class
+           };
+
+           static stack_pool& instance();
+
+           static size_t page_size();
+
+           /** @return the size allocate() hands out for a request of @p size bytes */
+           static size_t round_size( size_t size );
+
+           /** @return the class of a rounded size, num_classes for stacks that are not pooled */
+           static uint32_t class_of( size_t rounded_size );
+
+           /**
+            *  @param size rounded up to the size of the stack that is returned
+            *  @return the top of the stack, stacks grow down from there
+            */
+           void* allocate( size_t& size );
+           void  deallocate( void* sp, size_t size );
+
+        private:
+           stack_pool(){}
+
+           static void*    map( size_t size );
+           static void     unmap( void* sp, size_t size );
+           static void     discard( void* sp, size_t size );
+
+           boost::mutex        _lock;
+           std::vector<void*>  _free[num_classes];
+    };
+
+    /**
+     *  Per-thread front end of the stack_pool.  It holds on to a few recently
+     *  released stacks of each class without returning their pages, so a thread
+     *  that keeps starting and retiring fibers never touches the shared pool.
+     *
+     *  Only used by the thread that owns it, no locking.
+     */
+    class stack_cache {
+        public:
+           stack_cache(){}
+           ~stack_cache();
+
+           void* allocate( size_t& size );
+           void  deallocate( void* sp, size_t size );
+
+           /** hands every cached stack back to the stack_pool, which returns their pages */
+           void  clear();
+
+        private:
+           enum { max_cached = 4 };
+
+           stack_cache( const stack_cache& );
+           stack_cache& operator=( const stack_cache& );
+
+           std::vector<void*>  _free[stack_pool::num_classes];
+    };
+
+} // namespace fc
@@ -18,6 +18,8 @@ namespace fc {
   :
   promise_base("task_base"),
   _posted_num(0),
+  _scheduled_on(nullptr),
+  _stack_size(0),
   _active_context(nullptr),
   _next(nullptr),
   _task_specific_data(nullptr),
@@ -76,6 +78,12 @@ namespace fc {
 #endif
       _active_context->ctx_thread->notify_task_has_been_canceled();
     }
+    else if (thread* owner = _scheduled_on.load())
+    {
+      // still waiting for its time to come, have the owning thread take it out of
+      // its timer wheel so whoever waits on it hears about the cancellation now
+      owner->notify_scheduled_task_canceled(this);
+    }
   }
 
   task_base::~task_base() {
@@ -2,7 +2,10 @@
 #include <fc/vector.hpp>
 #include <fc/io/sstream.hpp>
 #include <fc/log/logger.hpp>
+#include <fc/variant_object.hpp>
+#include <fc/thread/affinity.hpp>
 #include "thread_d.hpp"
+#include "affinity.hpp"
 
 #if defined(_MSC_VER) && !defined(NDEBUG)
 # include <Windows.h>
@@ -139,6 +142,37 @@ namespace fc {
      set_thread_name(my->name.c_str()); // set thread's name for the debugger to display
    }
 
+   void thread::set_cpu_affinity( const std::vector<uint32_t>& cpus )
+   {
+     if (!is_current())
+     {
+       async([=](){ set_cpu_affinity(cpus); }, "set_cpu_affinity").wait();
+       return;
+     }
+     detail::pin_this_thread(cpus);
+   }
+
+   void thread::set_numa_node( uint32_t node )
+   {
+     if (!is_current())
+     {
+       async([=](){ set_numa_node(node); }, "set_numa_node").wait();
+       return;
+     }
+     detail::pin_this_thread(numa_node_cpus(node));
+     detail::prefer_numa_node(node);
+     detail::set_promise_storage_node(node);
+#if BOOST_VERSION >= 105400
+     my->stack_alloc.clear();
+#endif
+     my->numa_node = int32_t(node);
+   }
+
+   int32_t thread::numa_node()const
+   {
+     return my->numa_node;
+   }
+
    const char* thread::current_task_desc() const
    {
       if (my->current && my->current->cur_task)
@@ -196,16 +230,21 @@ namespace fc {
       unstarted_task->set_exception(std::make_shared<canceled_exception>(FC_LOG_MESSAGE(error, "cancellation reason: thread quitting")));
     my->task_pqueue.clear();
 
-    for (task_base* scheduled_task : my->task_sch_queue)
+    std::vector<task_base*> scheduled_tasks;
+    my->task_sch_queue.clear(scheduled_tasks);
+    for (task_base* scheduled_task : scheduled_tasks)
+    {
+      scheduled_task->_scheduled_on = nullptr;
       scheduled_task->set_exception(std::make_shared<canceled_exception>(FC_LOG_MESSAGE(error, "cancellation reason: thread quitting")));
-    my->task_sch_queue.clear();
+    }
 
     
 
     // move all sleep tasks to ready
-    for( uint32_t i = 0; i < my->sleep_pqueue.size(); ++i )
-      my->add_context_to_ready_list( my->sleep_pqueue[i] );
-    my->sleep_pqueue.clear();
+    std::vector<fc::context*> sleepers;
+    my->sleep_queue.clear(sleepers);
+    for( fc::context* sleeper : sleepers )
+      my->add_context_to_ready_list( sleeper );
 
     // move all idle tasks to ready
     fc::context* cur = my->pt_head;
@@ -216,14 +255,15 @@ namespace fc {
       my->add_context_to_ready_list( cur );
       cur = n;
     }
+    my->pt_head = 0;
+    my->idle_fibers = 0;
 
     // mark all ready tasks (should be everyone)... as canceled 
-    for (fc::context* ready_context : my->ready_heap)
-      ready_context->canceled = true;
+    my->ready_list.for_each([](fc::context* ready_context) { ready_context->canceled = true; });
 
     // now that we have poked all fibers... switch to the next one and
     // let them all quit.
-    while (!my->ready_heap.empty())
+    while (!my->ready_list.empty())
     {
       my->start_next_fiber(true); 
       my->check_for_timeouts();
@@ -262,6 +302,61 @@ namespace fc {
       return priority();
    }
 
+   static variant histogram_to_variant( const thread_metrics::histogram& h )
+   {
+      // only report up to the last bucket in use, and the buckets that
+      // hold the median and the 99th percentile
+      uint64_t counts[thread_metrics::histogram::num_buckets];
+      uint64_t total = 0;
+      uint32_t used = 0;
+      for( uint32_t i = 0; i < thread_metrics::histogram::num_buckets; ++i )
+      {
+         counts[i] = h.buckets[i].load( boost::memory_order_relaxed );
+         total += counts[i];
+         if( counts[i] )
+            used = i + 1;
+      }
+
+      variants buckets;
+      uint64_t p50 = 0, p99 = 0, seen = 0;
+      for( uint32_t i = 0; i < used; ++i )
+      {
+         uint64_t below_us = uint64_t(1) << i;
+         seen += counts[i];
+         if( !p50 && seen * 2 >= total )
+            p50 = below_us;
+         if( !p99 && seen * 100 >= total * 99 )
+            p99 = below_us;
+         buckets.push_back( mutable_variant_object( "below_us", below_us )( "count", counts[i] ) );
+      }
+      return mutable_variant_object( "count", total )
+                                   ( "p50_below_us", p50 )
+                                   ( "p99_below_us", p99 )
+                                   ( "buckets", buckets );
+   }
+
+   variant_object thread::get_metrics()const
+   {
+      FC_ASSERT( my );
+      const thread_metrics& m = my->metrics;
+      return mutable_variant_object( "name", my->name )
+                                   ( "ready_depth", m.ready_depth.load( boost::memory_order_relaxed ) )
+                                   ( "task_queue_depth", m.task_queue_depth.load( boost::memory_order_relaxed ) )
+                                   ( "scheduled_depth", m.scheduled_depth.load( boost::memory_order_relaxed ) )
+                                   ( "tasks_run", m.tasks_run.load( boost::memory_order_relaxed ) )
+                                   ( "context_switches", m.context_switches.load( boost::memory_order_relaxed ) )
+                                   ( "idle_waits", m.idle_waits.load( boost::memory_order_relaxed ) )
+                                   ( "idle_time_us", m.idle_time_us.load( boost::memory_order_relaxed ) )
+                                   ( "queue_latency_us", histogram_to_variant( m.queue_latency ) )
+                                   ( "run_time_us", histogram_to_variant( m.run_time ) );
+   }
+
+   void thread::log_metrics( const char* logger_name )const
+   {
+      fc_ilog( fc::logger::get( logger_name ), "thread ${name} scheduler metrics: ${metrics}",
+               ("name", name())("metrics", get_metrics()) );
+   }
+
    void thread::yield(bool reschedule) 
    {
       my->check_fiber_exceptions();
@@ -300,10 +395,7 @@ namespace fc {
        if( timeout != time_point::maximum() ) 
        {
            my->current->resume_time = timeout;
-           my->sleep_pqueue.push_back(my->current);
-           std::push_heap( my->sleep_pqueue.begin(),
-                           my->sleep_pqueue.end(), 
-                           sleep_priority_less()   );
+           my->sleep_queue.insert(my->current);
        }
 
        my->add_to_blocked( my->current );
@@ -334,16 +426,18 @@ namespace fc {
    void thread::async_task( task_base* t, const priority& p, const time_point& tp ) {
       assert(my);
       t->_when = tp;
+      t->_posted_time = time_point::now();
+      if( tp != time_point::min() )
+        t->_scheduled_on = this;
      // slog( "when %lld", t->_when.time_since_epoch().count() );
      // slog( "delay %lld", (tp - fc::time_point::now()).count() );
-      task_base* stale_head = my->task_in_queue.load(boost::memory_order_relaxed);
-      do { t->_next = stale_head;
-      }while( !my->task_in_queue.compare_exchange_weak( stale_head, t, boost::memory_order_release ) );
-
-      // Because only one thread can post the 'first task', only that thread will attempt
-      // to aquire the lock and therefore there should be no contention on this lock except
-      // when *this thread is about to block on a wait condition.  
-      if( this != &current() &&  !stale_head ) { 
+      my->task_in_queue.push(t);
+
+      // Only wake the thread if it is parked on task_ready.  A running thread drains
+      // task_in_queue before it parks, and only the first producer to see the flag
+      // pays for the notify, so there is no contention on the lock except when *this
+      // thread is about to block on the wait condition.
+      if( this != &current() && my->waiting_for_tasks.load() && my->waiting_for_tasks.exchange(false) ) { 
           boost::unique_lock<boost::mutex> lock(my->task_ready_mutex);
           my->task_ready.notify_one();
       }
@@ -392,10 +486,7 @@ namespace fc {
          if( timeout != time_point::maximum() ) 
          {
              my->current->resume_time = timeout;
-             my->sleep_pqueue.push_back(my->current);
-             std::push_heap( my->sleep_pqueue.begin(),
-                             my->sleep_pqueue.end(), 
-                             sleep_priority_less() );
+             my->sleep_queue.insert(my->current);
          }
 
        //  elog( "blocking %1%", my->current );
@@ -437,17 +528,8 @@ namespace fc {
           // remove it from the blocked list.
 
           // remove this context from the sleep queue...
-          for( uint32_t i = 0; i < my->sleep_pqueue.size(); ++i ) 
-          {
-            if( my->sleep_pqueue[i] == cur_blocked ) 
-            {
-              my->sleep_pqueue[i]->blocking_prom.clear();
-              my->sleep_pqueue[i] = my->sleep_pqueue.back();
-              my->sleep_pqueue.pop_back();
-              std::make_heap( my->sleep_pqueue.begin(),my->sleep_pqueue.end(), sleep_priority_less() );
-              break;
-            }
-          }
+          if( my->sleep_queue.remove( cur_blocked ) )
+            cur_blocked->blocking_prom.clear();
           auto cur = cur_blocked;
           if( prev_blocked ) 
           {  
@@ -480,11 +562,35 @@ namespace fc {
       async( [=](){ my->notify_task_has_been_canceled(); }, "notify_task_has_been_canceled", priority::max() );
     }
 
+    void thread::notify_scheduled_task_canceled(task_base* t)
+    {
+      promise_base::ptr held(t, true); // keeps t alive until the notification has been handled
+      async( [this,t,held](){ my->cancel_scheduled_task(t); }, "notify_scheduled_task_canceled", priority::max() );
+    }
+
     void thread::unblock(fc::context* c)
     {
       my->unblock(c);
     }
 
+    namespace detail
+    {
+      bool suspend_cancellation()
+      {
+        fc::context* cur = thread::current().my->current;
+        if( !cur || !cur->canceled )
+          return false;
+        cur->canceled = false;
+        return true;
+      }
+
+      void resume_cancellation()
+      {
+        if( fc::context* cur = thread::current().my->current )
+          cur->canceled = true;
+      }
+    }
+
 
 #ifdef _MSC_VER
     /* support for providing a structured exception handler for async tasks */
@@ -3,6 +3,12 @@
 #include <fc/time.hpp>
 #include <boost/thread.hpp>
 #include "context.hpp"
+#include "thread_pool_d.hpp"
+#include "mpsc_queue.hpp"
+#include "timer_wheel.hpp"
+#include "ready_queue.hpp"
+#include "thread_metrics.hpp"
+#include "watchdog_d.hpp"
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread.hpp>
 #include <boost/atomic.hpp>
@@ -10,23 +16,29 @@
 //#include <fc/logger.hpp>
 
 namespace fc {
-    struct sleep_priority_less {
-        bool operator()( const context::ptr& a, const context::ptr& b ) {
-            return a->resume_time > b->resume_time;
-        }
+    /** clears thread_d::waiting_for_tasks when the worker stops waiting, however it leaves the wait */
+    struct waiting_for_tasks_scope {
+        waiting_for_tasks_scope( boost::atomic<bool>& f ):flag(f){}
+        ~waiting_for_tasks_scope() { flag.store(false, boost::memory_order_relaxed); }
+        boost::atomic<bool>& flag;
     };
+
     class thread_d {
 
         public:
            thread_d(fc::thread& s)
             :self(s), boost_thread(0),
-             task_in_queue(0),
+             waiting_for_tasks(false),
              next_posted_num(1),
              done(false),
              current(0),
              pt_head(0),
+             idle_fibers(0),
              blocked(0),
-             next_unused_task_storage_slot(0)
+             next_unused_task_storage_slot(0),
+             pool(nullptr),
+             pool_index(0),
+             numa_node(-1)
 #ifndef NDEBUG
              ,non_preemptable_scope_count(0)
 #endif
@@ -34,15 +46,16 @@ namespace fc {
               static boost::atomic<int> cnt(0);
               name = fc::string("th_") + char('a'+cnt++); 
 //              printf("thread=%p\n",this);
+              register_watched_thread( this );
             }
 
             ~thread_d()
             {
+              unregister_watched_thread( this );
               delete current;
               fc::context* temp;
-              for (fc::context* ready_context : ready_heap)
-                delete ready_context;
-              ready_heap.clear();
+              ready_list.for_each([](fc::context* ready_context) { delete ready_context; });
+              ready_list.clear();
               while (blocked)
               {
                 temp = blocked->next;
@@ -71,11 +84,15 @@ namespace fc {
            boost::condition_variable        task_ready;
            boost::mutex                     task_ready_mutex;
 
-           boost::atomic<task_base*>       task_in_queue;
+           boost::atomic<bool>             waiting_for_tasks; // true while parked on task_ready, producers only notify then
+
+           mpsc_queue<task_base,&task_base::_next> task_in_queue; // tasks posted by async/schedule, not yet sorted into the queues below
            std::vector<task_base*>         task_pqueue;    // heap of tasks that have never started, ordered by proirity & scheduling time
            uint64_t                        next_posted_num; // each task or context gets assigned a number in the order it is ready to execute, tracked here
-           std::vector<task_base*>         task_sch_queue; // heap of tasks that have never started but are scheduled for a time in the future, ordered by the time they should be run
-           std::vector<fc::context*>       sleep_pqueue;   // heap of running tasks that have sleeped, ordered by the time they should resume
+           timer_wheel<task_base,&task_base::_timer,&task_base::_when>         task_sch_queue; // tasks that have never started but are scheduled for a time in the future
+           timer_wheel<fc::context,&fc::context::timer,&fc::context::resume_time> sleep_queue; // running tasks that have sleeped or wait with a timeout, until they should resume
+           std::vector<task_base*>         expired_tasks;     // scratch space for the batch task_sch_queue hands back
+           std::vector<fc::context*>       expired_contexts;  // scratch space for the batch sleep_queue hands back
            std::vector<fc::context*>       free_list;      // list of unused contexts that are ready for deletion
 
            bool                     done;
@@ -83,8 +100,9 @@ namespace fc {
            fc::context*             current;     // the currently-executing task in this thread
 
            fc::context*             pt_head;     // list of contexts that can be reused for new tasks
+           uint32_t                 idle_fibers; // number of contexts on pt_head
 
-           std::vector<fc::context*> ready_heap; // priority heap of contexts that are ready to run
+           ready_queue<fc::context,&fc::context::prio> ready_list; // contexts that are ready to run, by priority then posted order
 
            fc::context*             blocked;     // linked list of contexts (using 'next_blocked') blocked on promises via wait()
 
@@ -96,6 +114,13 @@ namespace fc {
            std::vector<detail::specific_data_info> non_task_specific_data;
            unsigned next_unused_task_storage_slot;
 
+           thread_metrics           metrics;
+           task_slice_tracker       slices;      // what has been running since the last switch, for fc::watchdog
+
+           thread_pool_d*           pool;        // set if this thread is a thread_pool worker
+           uint32_t                 pool_index;  // this thread's slot in pool->workers
+           int32_t                  numa_node;   // set by thread::set_numa_node(), -1 if never
+
 #ifndef NDEBUG
            unsigned                 non_preemptable_scope_count;
 #endif
@@ -156,6 +181,7 @@ namespace fc {
            {
               c->next = pt_head;
               pt_head = c;
+              ++idle_fibers;
               /* 
               fc::context* n = pt_head;
               int i = 0;
@@ -167,20 +193,63 @@ namespace fc {
               */
            }
 
+           /**
+            *  Takes a context off pt_head that can run tasks needing @p stack_size,
+            *  the thread's own native context can run anything.
+            *  @return nullptr if there is none
+            */
+           fc::context* pt_pop(size_t stack_size)
+           {
+              for (fc::context** c = &pt_head; *c; c = &(*c)->next)
+              {
+                if ((*c)->stack_size == stack_size || (*c)->stack_size == 0)
+                {
+                  fc::context* found = *c;
+                  *c = found->next;
+                  found->next = 0;
+                  --idle_fibers;
+                  return found;
+                }
+              }
+              return nullptr;
+           }
+
+           /** fibers beyond this many idle ones exit, handing their stacks back to the stack_pool */
+           enum { max_idle_fibers = 16 };
+
+           /**
+            *  Called by process_tasks() before it switches away from a context that has
+            *  nothing left to do.
+            *  @return false if the context should rather exit, process_tasks() must return
+            */
+           bool park_idle_fiber()
+           {
+              if (current->stack_alloc && idle_fibers >= max_idle_fibers)
+                return false;
+              pt_push_back(current);
+              return true;
+           }
+
+           /** @return the stack size of the contexts that run tasks asking for @p requested bytes */
+           static size_t rounded_stack_size(size_t requested)
+           {
+#if BOOST_VERSION >= 105400
+              return stack_pool::round_size(requested ? requested : FC_CONTEXT_STACK_SIZE);
+#else
+              return 0;
+#endif
+           }
+
           fc::context::ptr ready_pop_front() 
           {
-            fc::context* highest_priority_context = ready_heap.front();
-            std::pop_heap(ready_heap.begin(), ready_heap.end(), task_priority_less());
-            ready_heap.pop_back();
-            return highest_priority_context;
+            return ready_list.pop_front();
           }
            
            void add_context_to_ready_list(context* context_to_add, bool at_end = false)
            {
 
              context_to_add->context_posted_num = next_posted_num++;
-             ready_heap.push_back(context_to_add);
-             std::push_heap(ready_heap.begin(), ready_heap.end(), task_priority_less());
+             ready_list.push(context_to_add);
            }
 
           struct task_priority_less 
@@ -213,50 +282,39 @@ namespace fc {
 
           struct task_when_less 
           {
-            bool operator()( task_base* a, task_base* b ) 
+            bool operator()( const task_base* a, const task_base* b ) const
             {
-              return a->_when > b->_when;
+              return a->_when < b->_when;
             }
           };
 
            void enqueue( task_base* t ) 
            {
               time_point now = time_point::now();
-              task_base* cur = t;
-
-              // the linked list of tasks passed to enqueue is in the reverse order of
-              // what you'd expect -- the first task to be scheduled is at the end of
-              // the list.  We'll rectify the ordering by assigning the _posted_num
-              // in reverse order
-              unsigned num_ready_tasks = 0;
-              while (cur)
-              {
-                if (cur->_when <= now)
-                  ++num_ready_tasks;
-                cur = cur->_next;
-              }
 
-              cur = t;
-              next_posted_num += num_ready_tasks;
-              unsigned tasks_posted = 0;
-              while (cur)
+              // the list comes out of task_in_queue oldest first, so posted numbers
+              // can be handed out in list order
+              const size_t queued_before = task_pqueue.size();
+              for( task_base* cur = t; cur; cur = cur->_next )
               {
                 if (cur->_when > now)
-                {
-                  task_sch_queue.push_back(cur);
-                  std::push_heap(task_sch_queue.begin(),
-                                 task_sch_queue.end(), task_when_less());
-                }
+                  task_sch_queue.insert(cur);
                 else
                 {
-                  cur->_posted_num = next_posted_num - (++tasks_posted);
+                  cur->_posted_num = next_posted_num++;
                   task_pqueue.push_back(cur);
-                  std::push_heap(task_pqueue.begin(),
-                                 task_pqueue.end(), task_priority_less());
                   BOOST_ASSERT(this == thread::current().my);
                 }
-                cur = cur->_next;
               }
+
+              // restore the heap once per batch: a full make_heap is linear, so it
+              // wins whenever the batch is bigger than what was already queued
+              const size_t queued_now = task_pqueue.size();
+              if (queued_now - queued_before > queued_before)
+                std::make_heap(task_pqueue.begin(), task_pqueue.end(), task_priority_less());
+              else
+                for (size_t i = queued_before; i < queued_now; ++i)
+                  std::push_heap(task_pqueue.begin(), task_pqueue.begin() + i + 1, task_priority_less());
            }
 
           void move_newly_scheduled_tasks_to_task_pqueue()
@@ -267,27 +325,31 @@ namespace fc {
             // have been just been async or scheduled, but we haven't processed them.
             // move them into the task_sch_queue or task_pqueue, as appropriate
 
-            //DLN: changed from memory_order_consume for boost 1.55.
-            //This appears to be safest replacement for now, maybe
-            //can be changed to relaxed later, but needs analysis.
-            task_base* pending_list = task_in_queue.exchange(0, boost::memory_order_seq_cst);
+            task_base* pending_list = task_in_queue.pop_all();
             if (pending_list)
               enqueue(pending_list);
 
-            // second, walk through task_sch_queue and move any scheduled tasks that are now
-            // able to run (because their scheduled time has arrived) to task_pqueue
+            // second, take every scheduled task whose time has arrived out of
+            // task_sch_queue and move it to task_pqueue
 
-            while (!task_sch_queue.empty() &&
-                   task_sch_queue.front()->_when <= time_point::now())
-            {
-              task_base* ready_task = task_sch_queue.front();
-              std::pop_heap(task_sch_queue.begin(), task_sch_queue.end(), task_when_less());
-              task_sch_queue.pop_back();
+            if (task_sch_queue.empty())
+              return;
+            const time_point now = time_point::now();
+            if (now < task_sch_queue.next_deadline())
+              return;
+            task_sch_queue.expire(now, expired_tasks);
 
+            // the wheel only orders by millisecond, hand out posted numbers by the
+            // exact scheduled time so equal priorities still run in time order
+            std::stable_sort(expired_tasks.begin(), expired_tasks.end(), task_when_less());
+            for (task_base* ready_task : expired_tasks)
+            {
+              ready_task->_scheduled_on = nullptr;
               ready_task->_posted_num = next_posted_num++;
               task_pqueue.push_back(ready_task);
               std::push_heap(task_pqueue.begin(), task_pqueue.end(), task_priority_less());
             }
+            expired_tasks.clear();
           }
 
            task_base* dequeue() 
@@ -302,28 +364,18 @@ namespace fc {
                 return p;
            }
 
-           bool process_canceled_tasks()
+           /**
+            *  Called on this thread after a task waiting in task_sch_queue was canceled,
+            *  runs it right away so it completes with a canceled_exception instead of
+            *  sitting in the wheel until its time comes.
+            */
+           void cancel_scheduled_task( task_base* t )
            {
-              bool canceled_task = false;
-              for( auto task_itr = task_sch_queue.begin();
-                   task_itr != task_sch_queue.end();
-                   )
-              {
-                 if( (*task_itr)->canceled() )
-                 {
-                    (*task_itr)->run();
-                    (*task_itr)->release();
-                    task_itr = task_sch_queue.erase(task_itr);
-                    canceled_task = true;
-                    continue;
-                 }
-                 ++task_itr;
-              }
-
-              if( canceled_task )  
-                 std::make_heap( task_sch_queue.begin(), task_sch_queue.end(), task_when_less() );
-
-              return canceled_task;
+              if( !task_sch_queue.remove(t) )
+                return; // already moved on to task_pqueue, it will see the cancellation when it runs
+              t->_scheduled_on = nullptr;
+              t->run();
+              t->release();
            }
            
            /**
@@ -376,7 +428,7 @@ namespace fc {
               priority original_priority = current->prio;
 
               // check to see if any other contexts are ready
-              if (!ready_heap.empty())
+              if (!ready_list.empty())
               {
                 fc::context* next = ready_pop_front();
                 if (next == current)
@@ -397,6 +449,7 @@ namespace fc {
                 }
                 // slog( "jump to %p from %p", next, prev );
                 // fc_dlog( logger::get("fc_context"), "from ${from} to ${to}", ( "from", int64_t(prev) )( "to", int64_t(next) ) ); 
+                thread_metrics::bump( metrics.context_switches );
 #if BOOST_VERSION >= 105600
                 bc::jump_fcontext( &prev->my_context, next->my_context, 0 );
 #elif BOOST_VERSION >= 105300
@@ -407,49 +460,10 @@ namespace fc {
                 BOOST_ASSERT( current );
                 BOOST_ASSERT( current == prev );
                 //current = prev;
+                begin_slice();
               } 
               else 
-              { 
-                // all contexts are blocked, create a new context 
-                // that will process posted tasks...
-                fc::context* prev = current;
-
-                fc::context* next = nullptr;
-                if( pt_head ) 
-                { 
-                  // grab cached context
-                  next = pt_head;
-                  pt_head = pt_head->next;
-                  next->next = 0;
-                  next->reinitialize();
-                } 
-                else 
-                { 
-                  // create new context.
-                  next = new fc::context( &thread_d::start_process_tasks, stack_alloc,
-                                          &fc::thread::current() );
-                }
-
-                current = next;
-                if( reschedule )  
-                {
-                  current->prio = priority::_internal__priority_for_short_sleeps();
-                  add_context_to_ready_list(prev, true);
-                }
-
-                // slog( "jump to %p from %p", next, prev );
-                // fc_dlog( logger::get("fc_context"), "from ${from} to ${to}", ( "from", int64_t(prev) )( "to", int64_t(next) ) );
-#if BOOST_VERSION >= 105600
-                bc::jump_fcontext( &prev->my_context, next->my_context, (intptr_t)this );
-#elif BOOST_VERSION >= 105300
-                bc::jump_fcontext( prev->my_context, next->my_context, (intptr_t)this );
-#else
-                bc::jump_fcontext( &prev->my_context, &next->my_context, (intptr_t)this );
-#endif
-                BOOST_ASSERT( current );
-                BOOST_ASSERT( current == prev );
-                //current = prev;
-              }
+                start_idle_fiber(reschedule);
 
               if (reschedule)
                 current->prio = original_priority;
@@ -467,9 +481,64 @@ namespace fc {
               return true;
            }
 
+           /**
+            *  Switches to a context that is idle in process_tasks(), or to a new one,
+            *  with a stack that suits the next task waiting to run.
+            */
+           void start_idle_fiber( bool reschedule = false )
+           {
+              // all contexts are blocked, create a new context 
+              // that will process posted tasks...
+              fc::context* prev = current;
+
+              // size it for the task that is going to run first
+              size_t stack_size = rounded_stack_size(task_pqueue.empty() ? 0 : task_pqueue.front()->_stack_size);
+              fc::context* next = pt_pop(stack_size);
+              if( next ) 
+              { 
+                // grab cached context
+                next->reinitialize();
+              } 
+              else 
+              { 
+                // create new context.
+                next = new fc::context( &thread_d::start_process_tasks, stack_alloc,
+                                        &fc::thread::current(), stack_size );
+              }
+
+              current = next;
+              if( reschedule )  
+              {
+                current->prio = priority::_internal__priority_for_short_sleeps();
+                add_context_to_ready_list(prev, true);
+              }
+
+              // slog( "jump to %p from %p", next, prev );
+              // fc_dlog( logger::get("fc_context"), "from ${from} to ${to}", ( "from", int64_t(prev) )( "to", int64_t(next) ) );
+              thread_metrics::bump( metrics.context_switches );
+#if BOOST_VERSION >= 105600
+              bc::jump_fcontext( &prev->my_context, next->my_context, (intptr_t)this );
+#elif BOOST_VERSION >= 105300
+              bc::jump_fcontext( prev->my_context, next->my_context, (intptr_t)this );
+#else
+              bc::jump_fcontext( &prev->my_context, &next->my_context, (intptr_t)this );
+#endif
+              BOOST_ASSERT( current );
+              BOOST_ASSERT( current == prev );
+              //current = prev;
+              begin_slice();
+           }
+
+           /** called whenever a context resumes, it runs its task (if any) until it yields again */
+           void begin_slice()
+           {
+              slices.begin( current->cur_task ? current->cur_task->get_desc() : nullptr );
+           }
+
            static void start_process_tasks( intptr_t my ) 
            {
               thread_d* self = (thread_d*)my;
+              self->slices.begin( nullptr );
               try 
               {
                 self->process_tasks();
@@ -488,11 +557,22 @@ namespace fc {
 
            void run_next_task() 
            {
-              task_base* next = dequeue();
+              run_task( dequeue() );
+           }
+
+           void run_task( task_base* next )
+           {
+              time_point start = time_point::now();
+              metrics.queue_latency.record( start - std::max( next->_posted_time, next->_when ) );
 
               next->_set_active_context( current );
               current->cur_task = next;
+              slices.begin( next->get_desc() );
               next->run();
+              slices.begin( nullptr );
+
+              metrics.run_time.record( time_point::now() - start );
+              thread_metrics::bump( metrics.tasks_run );
               current->cur_task = 0;
               next->_set_active_context(0);
               next->release();
@@ -502,8 +582,9 @@ namespace fc {
            bool has_next_task() 
            {
              if( task_pqueue.size() ||
-                 (task_sch_queue.size() && task_sch_queue.front()->_when <= time_point::now()) ||
-                 task_in_queue.load( boost::memory_order_relaxed ) )
+                 (!task_sch_queue.empty() && task_sch_queue.next_deadline() <= time_point::now()) ||
+                 !task_in_queue.empty() ||
+                 (pool && pool->has_pending()) )
                return true;
              return false;
            }
@@ -525,20 +606,33 @@ namespace fc {
                 // move all now-ready sleeping tasks to the ready list
                 check_for_timeouts();
 
+                metrics.set_depths( ready_list.size(), task_pqueue.size(), task_sch_queue.size() );
+
                 if (!task_pqueue.empty())
                 {
-                  if (!ready_heap.empty())
+                  if (!ready_list.empty())
                   {
                     // a new task and an existing task are both ready to go
-                    if (task_priority_less()(task_pqueue.front(), ready_heap.front()))
+                    if (task_priority_less()(task_pqueue.front(), ready_list.front()))
                     {
                       // run the existing task first
-                      pt_push_back(current);
+                      if (!park_idle_fiber())
+                        return;
                       start_next_fiber(false);
                       continue;
                     }
                   }
 
+                  // the task asked for a different stack than ours, leave it to a
+                  // context that has the right one
+                  if (current->stack_size && current->stack_size != rounded_stack_size(task_pqueue.front()->_stack_size))
+                  {
+                    if (!park_idle_fiber())
+                      return;
+                    start_idle_fiber();
+                    continue;
+                  }
+
                   // if we made it here, either there's no ready context, or the ready context is
                   // scheduled after the ready task, so we should run the task first
                   run_next_task();
@@ -547,26 +641,40 @@ namespace fc {
 
                 // if I have something else to do other than
                 // process tasks... do it.
-                if (!ready_heap.empty())
+                if (!ready_list.empty())
                 { 
-                   pt_push_back( current ); 
+                   if( !park_idle_fiber() )
+                     return;
                    start_next_fiber(false);  
                    continue;
                 }
 
-                if( process_canceled_tasks() ) 
-                  continue;
+                // nothing of our own left to do, pick up (or steal) work from our pool
+                if( pool )
+                {
+                  if( task_base* pool_task = pool->take( pool_index ) )
+                  {
+                    run_task( pool_task );
+                    continue;
+                  }
+                }
 
                 clear_free_list();
 
                 { // lock scope
                   boost::unique_lock<boost::mutex> lock(task_ready_mutex);
+                  thread_pool_idle_scope idle( pool, pool_index );
+                  // announce that we are about to park before the final check, a producer
+                  // either sees the flag and notifies us or we see its task
+                  waiting_for_tasks.store(true);
+                  waiting_for_tasks_scope waiting( waiting_for_tasks );
                   if( has_next_task() ) 
                     continue;
                   time_point timeout_time = check_for_timeouts();
                   
                   if( done ) 
                     return;
+                  time_point idle_start = time_point::now();
                   if( timeout_time == time_point::maximum() ) 
                     task_ready.wait( lock );
                   else if( timeout_time != time_point::min() ) 
@@ -594,6 +702,11 @@ namespace fc {
                     task_ready.wait_until( lock, boost::chrono::steady_clock::now() + 
                                                  boost::chrono::microseconds(timeout_time.time_since_epoch().count() - time_point::now().time_since_epoch().count()) );
                   }
+                  if( timeout_time != time_point::min() )
+                  {
+                    thread_metrics::bump( metrics.idle_waits );
+                    thread_metrics::bump( metrics.idle_time_us, (time_point::now() - idle_start).count() );
+                  }
                 }
               }
            }
@@ -604,30 +717,35 @@ namespace fc {
      */
     time_point check_for_timeouts() 
     {
-        if( !sleep_pqueue.size() && !task_sch_queue.size() ) 
+        if( sleep_queue.empty() && task_sch_queue.empty() ) 
         {
           // ilog( "no timeouts ready" );
           return time_point::maximum();
         }
 
-        time_point next = time_point::maximum();
-        if( !sleep_pqueue.empty() && next > sleep_pqueue.front()->resume_time )
-          next = sleep_pqueue.front()->resume_time;
-        if( !task_sch_queue.empty() && next > task_sch_queue.front()->_when )
-          next = task_sch_queue.front()->_when;
-
+        // the wheels may report a deadline a little early (when a slot needs to be
+        // cascaded), in which case we just come back here sooner
+        time_point next = std::min( sleep_queue.next_deadline(), task_sch_queue.next_deadline() );
         time_point now = time_point::now();
         if( now < next )
           return next;
 
-        // move all expired sleeping tasks to the ready queue
-        while( sleep_pqueue.size() && sleep_pqueue.front()->resume_time < now ) 
-        {
-          fc::context::ptr c = sleep_pqueue.front();
-          std::pop_heap(sleep_pqueue.begin(), sleep_pqueue.end(), sleep_priority_less() );
-          // ilog( "sleep pop back..." );
-          sleep_pqueue.pop_back();
+        wake_sleepers( now );
+        return time_point::min();
+    }
 
+    /** moves every context whose resume_time has passed to the ready queue */
+    void wake_sleepers( const time_point& now ) 
+    {
+        if( sleep_queue.empty() )
+          return;
+
+        // timing out a promise can wind up back in here, work on our own copy of the batch
+        std::vector<fc::context*> woken;
+        woken.swap( expired_contexts );
+        sleep_queue.expire( now, woken );
+        for( fc::context* c : woken )
+        {
           if( c->blocking_prom.size() ) 
           {
             // ilog( "timeout blocking prom" );
@@ -635,13 +753,13 @@ namespace fc {
           }
           else 
           { 
-            // ilog( "..." );
             // ilog( "ready_push_front" );
             if (c != current)
               add_context_to_ready_list(c);
           }
         }
-        return time_point::min();
+        woken.clear();
+        expired_contexts.swap( woken );
     }
 
         void unblock( fc::context* c ) 
@@ -671,24 +789,12 @@ namespace fc {
           current->resume_time = tp;
           current->clear_blocking_promises();
 
-          sleep_pqueue.push_back(current);
-          std::push_heap( sleep_pqueue.begin(),
-                          sleep_pqueue.end(), sleep_priority_less()   );
+          sleep_queue.insert(current);
           
           start_next_fiber(reschedule);
 
-          // clear current context from sleep queue...
-          for( uint32_t i = 0; i < sleep_pqueue.size(); ++i ) 
-          {
-            if( sleep_pqueue[i] == current ) 
-            {
-              sleep_pqueue[i] = sleep_pqueue.back();
-              sleep_pqueue.pop_back();
-              std::make_heap( sleep_pqueue.begin(),
-                              sleep_pqueue.end(), sleep_priority_less() );
-              break;
-            }
-          }
+          // clear current context from sleep queue if something else woke us
+          sleep_queue.remove(current);
 
           current->resume_time = time_point::maximum();
           check_fiber_exceptions();
@@ -714,10 +820,7 @@ namespace fc {
           if( timeout != time_point::maximum() ) 
           {
             current->resume_time = timeout;
-            sleep_pqueue.push_back(current);
-            std::push_heap( sleep_pqueue.begin(),
-                            sleep_pqueue.end(), 
-                            sleep_priority_less()   );
+            sleep_queue.insert(current);
           }
 
           // elog( "blocking %1%", current );
@@ -760,23 +863,17 @@ namespace fc {
             iter = &(*iter)->next_blocked;
           }
 
-          bool task_removed_from_sleep_pqueue = false;
-          for (auto sleep_iter = sleep_pqueue.begin(); sleep_iter != sleep_pqueue.end();)
+          std::vector<fc::context*> canceled_sleepers;
+          sleep_queue.for_each([&](fc::context* c) {
+            if (c->canceled)
+              canceled_sleepers.push_back(c);
+          });
+          for (fc::context* c : canceled_sleepers)
           {
-            if ((*sleep_iter)->canceled)
-            {
-              bool already_on_ready_list = std::find(ready_heap.begin(), ready_heap.end(), 
-                                                     *sleep_iter) != ready_heap.end();
-              if (!already_on_ready_list)
-                add_context_to_ready_list(*sleep_iter);
-              sleep_iter = sleep_pqueue.erase(sleep_iter);
-              task_removed_from_sleep_pqueue = true;
-            }
-            else
-              ++sleep_iter;
+            sleep_queue.remove(c);
+            if (!ready_list.contains(c))
+              add_context_to_ready_list(c);
           }
-          if (task_removed_from_sleep_pqueue)
-            std::make_heap(sleep_pqueue.begin(), sleep_pqueue.end(), sleep_priority_less());
         }
     };
 } // namespace fc
@@ -0,0 +1,77 @@
+#pragma once
+#include <fc/time.hpp>
+#include <boost/atomic.hpp>
+
+namespace fc {
+
+    /**
+     *  Scheduler counters for one fc::thread.
+     *
+     *  Only the owning thread writes them, so updates are plain relaxed
+     *  load/store pairs instead of read-modify-write instructions.  Any thread
+     *  may read them (thread::get_metrics()) without going through the
+     *  scheduler, which matters most when the owner is the one that is stuck.
+     */
+    struct thread_metrics {
+        /** power of two histogram of durations, bucket i counts durations below 2^i microseconds */
+        struct histogram {
+           enum { num_buckets = 25 };  // the last bucket also takes anything longer than ~8s
+
+           histogram()
+           {
+              for( uint32_t i = 0; i < num_buckets; ++i )
+                 buckets[i].store( 0, boost::memory_order_relaxed );
+           }
+
+           void record( const microseconds& d )
+           {
+              uint64_t us = d.count() > 0 ? uint64_t(d.count()) : 0;
+              uint32_t b = 0;
+              while( us && b + 1 < num_buckets )
+              {
+                 us >>= 1;
+                 ++b;
+              }
+              bump( buckets[b] );
+           }
+
+           boost::atomic<uint64_t> buckets[num_buckets];
+        };
+
+        thread_metrics()
+        :tasks_run(0),
+         context_switches(0),
+         idle_waits(0),
+         idle_time_us(0),
+         ready_depth(0),
+         task_queue_depth(0),
+         scheduled_depth(0)
+        {}
+
+        static void bump( boost::atomic<uint64_t>& counter, uint64_t n = 1 )
+        {
+           counter.store( counter.load( boost::memory_order_relaxed ) + n, boost::memory_order_relaxed );
+        }
+
+        /** samples the queue depths, called once per pass of process_tasks() */
+        void set_depths( size_t ready, size_t queued, size_t scheduled )
+        {
+           ready_depth.store( uint32_t(ready), boost::memory_order_relaxed );
+           task_queue_depth.store( uint32_t(queued), boost::memory_order_relaxed );
+           scheduled_depth.store( uint32_t(scheduled), boost::memory_order_relaxed );
+        }
+
+        boost::atomic<uint64_t> tasks_run;
+        boost::atomic<uint64_t> context_switches;
+        boost::atomic<uint64_t> idle_waits;        // times the thread parked on task_ready
+        boost::atomic<uint64_t> idle_time_us;      // total time spent parked on task_ready
+
+        boost::atomic<uint32_t> ready_depth;       // contexts waiting in ready_list
+        boost::atomic<uint32_t> task_queue_depth;  // tasks waiting in task_pqueue
+        boost::atomic<uint32_t> scheduled_depth;   // tasks waiting in task_sch_queue for their time
+
+        histogram               queue_latency;     // from async() (or the scheduled time) to the task starting
+        histogram               run_time;          // from the task starting to it finishing, including time it spent blocked
+    };
+
+} // namespace fc
@@ -0,0 +1,192 @@
+#include <fc/thread/thread_pool.hpp>
+#include <fc/thread/unique_lock.hpp>
+#include <fc/log/logger.hpp>
+#include "thread_d.hpp"
+
+namespace fc {
+
+   void thread_pool_d::post( task_base* t, uint32_t hint )
+   {
+      if( quitting.load() )
+      {
+         t->set_exception( std::make_shared<canceled_exception>(FC_LOG_MESSAGE(error, "cancellation reason: thread pool quitting")) );
+         t->release();
+         return;
+      }
+
+      uint32_t index = hint < workers.size() ? hint : next_worker.fetch_add(1, boost::memory_order_relaxed) % workers.size();
+      worker& w = *workers[index];
+      { synchronized( w.lock )
+         w.tasks.push_back(t);
+         pending.fetch_add(1);
+      }
+      wake(index);
+   }
+
+   void thread_pool_d::wake( uint32_t index )
+   {
+      // prefer the worker the task was queued on, otherwise any idle worker can steal it.
+      // If nobody is idle every worker is busy and will look at the deques before it parks.
+      for( uint32_t i = 0; i < workers.size(); ++i )
+      {
+         worker& w = *workers[(index + i) % workers.size()];
+         if( w.idle.load() )
+         {
+            w.thread->poke();
+            return;
+         }
+      }
+   }
+
+   task_base* thread_pool_d::take( uint32_t index )
+   {
+      if( pending.load(boost::memory_order_relaxed) <= 0 )
+         return nullptr;
+
+      {
+         worker& w = *workers[index];
+         synchronized( w.lock )
+         if( !w.tasks.empty() )
+         {
+            task_base* t = w.tasks.front();
+            w.tasks.pop_front();
+            pending.fetch_sub(1);
+            return t;
+         }
+      }
+
+      for( uint32_t i = 1; i < workers.size(); ++i )
+      {
+         worker& victim = *workers[(index + i) % workers.size()];
+         synchronized( victim.lock )
+         if( !victim.tasks.empty() )
+         {
+            // the owner consumes from the front, steal from the back so we
+            // don't contend with it for the same end of the deque
+            task_base* t = victim.tasks.back();
+            victim.tasks.pop_back();
+            pending.fetch_sub(1);
+            return t;
+         }
+      }
+      return nullptr;
+   }
+
+   void thread_pool_d::cancel_pending()
+   {
+      for( worker* w : workers )
+      {
+         std::deque<task_base*> canceled;
+         { synchronized( w->lock )
+            canceled.swap( w->tasks );
+            pending.fetch_sub( canceled.size() );
+         }
+         for( task_base* t : canceled )
+         {
+            t->set_exception( std::make_shared<canceled_exception>(FC_LOG_MESSAGE(error, "cancellation reason: thread pool quitting")) );
+            t->release();
+         }
+      }
+   }
+
+   thread_pool::thread_pool( uint32_t num_threads, const std::string& name )
+   :my( new thread_pool_d() )
+   {
+      if( num_threads == 0 )
+         num_threads = std::max( 1u, boost::thread::hardware_concurrency() );
+
+      my->workers.reserve( num_threads );
+      for( uint32_t i = 0; i < num_threads; ++i )
+      {
+         thread_pool_d::worker* w = new thread_pool_d::worker();
+         w->thread = new fc::thread( name + "_" + fc::to_string(uint64_t(i)) );
+         my->workers.push_back(w);
+      }
+
+      // attach the workers only once the pool is fully built, take() walks all of them
+      thread_pool_d* d = my.get();
+      for( uint32_t i = 0; i < num_threads; ++i )
+         my->workers[i]->thread->async( [d,i](){
+            thread_d* td = thread::current().my;
+            td->pool = d;
+            td->pool_index = i;
+         }, "thread_pool::attach" ).wait();
+   }
+
+   thread_pool::~thread_pool()
+   {
+      quit();
+   }
+
+   thread_pool& thread_pool::default_pool()
+   {
+      // leaked on purpose, its workers may still be running tasks while static destructors run
+      static thread_pool* pool = new thread_pool( 0, "parallel" );
+      return *pool;
+   }
+
+   uint32_t thread_pool::size()const
+   {
+      return my->workers.size();
+   }
+
+   thread& thread_pool::get_thread( uint32_t i )
+   {
+      FC_ASSERT( i < my->workers.size() );
+      return *my->workers[i]->thread;
+   }
+
+   void thread_pool::quit()
+   {
+      if( my->quitting.exchange(true) )
+         return;
+
+      my->cancel_pending();
+      for( thread_pool_d::worker* w : my->workers )
+      {
+         delete w->thread; // quits and joins the worker
+         w->thread = nullptr;
+      }
+      // anything posted while the workers were shutting down
+      my->cancel_pending();
+   }
+
+   void thread_pool::async_task( task_base* t, const priority& p )
+   {
+      t->_prio = p;
+      t->_when = time_point::min();
+      t->_posted_time = time_point::now();
+
+      uint32_t hint = uint32_t(-1);
+      thread_d* current = thread::current().my;
+      if( current && current->pool == my.get() )
+         hint = current->pool_index;
+      my->post( t, hint );
+   }
+
+   void thread_pool::async_task( task_base* t, const priority& p, const time_point& tp )
+   {
+      if( tp <= time_point::now() )
+      {
+         async_task( t, p );
+         return;
+      }
+
+      t->_prio = p;
+      t->_when = time_point::min();
+
+      // park the task on one worker's timer, when it fires the task joins the
+      // shared deques.  If the timer is dropped because the worker quits,
+      // `held` releases our reference to the task.
+      thread_pool_d* d = my.get();
+      fc::shared_ptr<task_base> held( t );
+      uint32_t index = d->next_worker.fetch_add(1, boost::memory_order_relaxed) % d->workers.size();
+      d->workers[index]->thread->schedule( [d,held](){
+         task_base* ready = held.get();
+         ready->retain();
+         ready->_posted_time = time_point::now();
+         d->post( ready, uint32_t(-1) );
+      }, tp, "thread_pool::schedule" );
+   }
+
+} // namespace fc
@@ -0,0 +1,91 @@
+#pragma once
+#include <fc/thread/thread_pool.hpp>
+#include <fc/thread/spin_lock.hpp>
+#include <boost/atomic.hpp>
+#include <deque>
+#include <vector>
+
+namespace fc {
+
+    /**
+     *  Shared state of a thread_pool.  Each worker's thread_d holds a pointer
+     *  to it and asks it for work whenever its own queues run dry.
+     */
+    class thread_pool_d {
+        public:
+           struct worker {
+              worker() : thread(nullptr), idle(false) {}
+
+              fc::thread*               thread;
+              fc::spin_lock             lock;   // guards tasks
+              std::deque<task_base*>    tasks;  // never-started tasks, oldest at the front
+              boost::atomic<bool>       idle;   // true while the worker is parked on task_ready
+           };
+
+           thread_pool_d()
+           :next_worker(0),
+            pending(0),
+            quitting(false)
+           {}
+
+           ~thread_pool_d()
+           {
+              for( worker* w : workers )
+                 delete w;
+           }
+
+           /**
+            *  Queues @p t, taking over the reference the caller holds on it.  If
+            *  @p hint is a valid worker index the task is queued there, otherwise
+            *  the next worker in round robin order gets it.
+            */
+           void        post( task_base* t, uint32_t hint );
+
+           /**
+            *  Pops the oldest task from worker @p index, or steals the newest task of
+            *  another worker if @p index has none.
+            *  @return nullptr if every deque is empty
+            */
+           task_base*  take( uint32_t index );
+
+           bool        has_pending()const { return pending.load() > 0; }
+
+           void        set_idle( uint32_t index, bool is_idle ) { workers[index]->idle.store( is_idle ); }
+
+           /** Removes every queued task and fails its promise with canceled_exception */
+           void        cancel_pending();
+
+           std::vector<worker*>      workers;
+           boost::atomic<uint32_t>   next_worker;
+           boost::atomic<int64_t>    pending;   // total number of tasks in all deques
+           boost::atomic<bool>       quitting;
+
+        private:
+           void wake( uint32_t index );
+    };
+
+    /**
+     *  Marks a pool worker idle for the lifetime of the scope.  The flag must be
+     *  set before the worker makes its final has_next_task() check so that a
+     *  concurrent post() either sees the flag and pokes the worker, or the
+     *  worker sees the new task.
+     */
+    class thread_pool_idle_scope {
+        public:
+           thread_pool_idle_scope( thread_pool_d* p, uint32_t index )
+           :_pool(p),_index(index)
+           {
+              if( _pool )
+                 _pool->set_idle( _index, true );
+           }
+           ~thread_pool_idle_scope()
+           {
+              if( _pool )
+                 _pool->set_idle( _index, false );
+           }
+        private:
+           thread_pool_d* _pool;
+           uint32_t       _index;
+    };
+
+} // namespace fc
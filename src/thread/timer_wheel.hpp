@@ -0,0 +1,356 @@
+#pragma once
+#include <fc/time.hpp>
+#include <fc/thread/task.hpp>
+#include <boost/assert.hpp>
+#include <algorithm>
+#include <vector>
+
+namespace fc {
+
+    /**
+     *  Hierarchical timing wheel of intrusively linked nodes, keyed on the
+     *  time_point stored in Node::*When.  A thread keeps one for tasks that are
+     *  scheduled for later and one for contexts that sleep or wait with a timeout.
+     *
+     *  Time is split into 1ms ticks.  The root level has one slot per tick for
+     *  the next 256 ticks, every further level has 64 slots that each cover a
+     *  whole rotation of the level below, and deadlines past the last level sit
+     *  in an overflow list.  When the root wraps around, the matching slot of
+     *  the next level is cascaded down.
+     *
+     *  insert() and remove() are O(1).  expire() unlinks every node that is due
+     *  in one pass over the elapsed slots and hands them back as a batch, so the
+     *  caller can act on them without the wheel changing underneath it.
+     *
+     *  next_deadline() is asked on every context switch, so its answer is cached
+     *  and only searched for again once the earliest node left or came due.
+     */
+    template<typename Node, detail::timer_hook<Node> Node::*Hook, time_point Node::*When>
+    class timer_wheel {
+        public:
+           typedef detail::timer_hook<Node> hook;
+
+           timer_wheel()
+           :_now_tick( tick_of( time_point::now() ) ),
+            _size(0),
+            _next( time_point::maximum() ),
+            _next_valid(true)
+           {
+              for( uint32_t i = 0; i < root_size; ++i )
+                 reset( _root[i] );
+              for( uint32_t l = 0; l < num_levels; ++l )
+                 for( uint32_t i = 0; i < level_size; ++i )
+                    reset( _levels[l][i] );
+              reset( _overflow );
+              std::fill( _counts, _counts + num_levels + 2, 0 );
+           }
+
+           bool   empty()const { return _size == 0; }
+           size_t size()const  { return _size; }
+
+           bool contains( const Node* n )const { return (n->*Hook).next != nullptr; }
+
+           void insert( Node* n )
+           {
+              hook& h = n->*Hook;
+              BOOST_ASSERT( !h.next );
+              h.node = n;
+              link( h );
+              ++_size;
+              if( _next_valid )
+                 _next = std::min( _next, n->*When );
+           }
+
+           /** @return false if @p n was not in the wheel */
+           bool remove( Node* n )
+           {
+              hook& h = n->*Hook;
+              if( !h.next )
+                 return false;
+              unlink( h );
+              --_size;
+              if( n->*When <= _next )
+                 _next_valid = false;
+              return true;
+           }
+
+           /**
+            *  Removes every node whose deadline is at or before @p now and appends
+            *  it to @p expired.
+            */
+           void expire( const time_point& now, std::vector<Node*>& expired )
+           {
+              const uint64_t target = tick_of( now );
+              if( now >= _next )
+                 _next_valid = false; // the earliest node is due or its slot gets cascaded
+              if( _size == 0 )
+              {
+                 _now_tick = std::max( _now_tick, target );
+                 return;
+              }
+
+              for( ;; )
+              {
+                 // every node in an elapsed slot is due, in the current slot only
+                 // the ones whose deadline has passed down to the microsecond
+                 hook& slot = _root[_now_tick & root_mask];
+                 for( hook* h = slot.next; h != &slot; )
+                 {
+                    hook* next = h->next;
+                    if( h->node->*When <= now )
+                    {
+                       unlink( *h );
+                       --_size;
+                       expired.push_back( h->node );
+                    }
+                    h = next;
+                 }
+                 if( _now_tick >= target || _size == 0 )
+                    break;
+
+                 // hop straight over empty stretches to the next tick where a
+                 // populated level gets cascaded
+                 uint64_t unit = 1;
+                 for( uint32_t l = 0; l <= num_levels && _counts[l] == 0; ++l )
+                    unit = uint64_t(1) << shift_of(l);
+                 _now_tick = std::min( (_now_tick / unit + 1) * unit, target );
+
+                 if( (_now_tick & root_mask) == 0 )
+                    cascade();
+              }
+              if( _size == 0 )
+                 _now_tick = std::max( _now_tick, target );
+           }
+
+           /**
+            *  @return the earliest time expire() can have anything to do, never later than
+            *          the first deadline in the wheel.  For deadlines beyond the root level
+            *          this is the tick at which their slot gets cascaded.
+            */
+           time_point next_deadline()const
+           {
+              if( !_next_valid )
+              {
+                 _next       = find_next_deadline();
+                 _next_valid = true;
+              }
+              return _next;
+           }
+
+           /** Removes every node, appending them to @p removed */
+           void clear( std::vector<Node*>& removed )
+           {
+              clear_slot( _overflow, removed );
+              for( uint32_t i = 0; i < root_size; ++i )
+                 clear_slot( _root[i], removed );
+              for( uint32_t l = 0; l < num_levels; ++l )
+                 for( uint32_t i = 0; i < level_size; ++i )
+                    clear_slot( _levels[l][i], removed );
+              _size = 0;
+              _next = time_point::maximum();
+              _next_valid = true;
+           }
+
+           /** Calls @p f on every node in the wheel, @p f must not insert or remove nodes */
+           template<typename Functor>
+           void for_each( Functor&& f )const
+           {
+              for_each_in_slot( _overflow, f );
+              for( uint32_t i = 0; i < root_size; ++i )
+                 for_each_in_slot( _root[i], f );
+              for( uint32_t l = 0; l < num_levels; ++l )
+                 for( uint32_t i = 0; i < level_size; ++i )
+                    for_each_in_slot( _levels[l][i], f );
+           }
+
+        private:
+           enum {
+              tick_us    = 1000,
+              root_bits  = 8,
+              root_size  = 1 << root_bits,
+              root_mask  = root_size - 1,
+              level_bits = 6,
+              level_size = 1 << level_bits,
+              level_mask = level_size - 1,
+              num_levels = 4
+           };
+
+           timer_wheel( const timer_wheel& );
+           timer_wheel& operator=( const timer_wheel& );
+
+           /** ticks covered by one slot of level l, as a power of two */
+           static uint32_t shift_of( uint32_t l ) { return root_bits + l * level_bits; }
+
+           static uint64_t tick_of( const time_point& t )
+           {
+              int64_t us = t.time_since_epoch().count();
+              return us > 0 ? uint64_t(us) / tick_us : 0;
+           }
+
+           static void reset( hook& sentinel ) { sentinel.prev = sentinel.next = &sentinel; }
+
+           /**
+            *  the scan behind next_deadline(): the earliest deadline in the first populated
+            *  root slot, or the first tick at which a populated level or the overflow list
+            *  gets cascaded if that comes sooner
+            */
+           time_point find_next_deadline()const
+           {
+              if( _size == 0 )
+                 return time_point::maximum();
+
+              time_point first = time_point::maximum();
+              if( _counts[0] )
+              {
+                 for( uint32_t k = 0; k < root_size; ++k )
+                 {
+                    const hook& slot = _root[(_now_tick + k) & root_mask];
+                    if( slot.next == &slot )
+                       continue;
+                    for( const hook* h = slot.next; h != &slot; h = h->next )
+                       first = std::min( first, h->node->*When );
+                    break;
+                 }
+              }
+
+              uint64_t next_tick = uint64_t(-1);
+              for( uint32_t l = 0; l < num_levels; ++l )
+              {
+                 if( !_counts[l+1] )
+                    continue;
+                 const uint32_t shift = shift_of(l);
+                 const uint64_t rotation = _now_tick >> shift;
+                 for( uint32_t k = 1; k <= level_size; ++k )
+                 {
+                    const hook& slot = _levels[l][(rotation + k) & level_mask];
+                    if( slot.next != &slot )
+                    {
+                       next_tick = std::min( next_tick, (rotation + k) << shift );
+                       break;
+                    }
+                 }
+              }
+              if( _counts[num_levels+1] )
+              {
+                 const uint32_t shift = shift_of(num_levels);
+                 next_tick = std::min( next_tick, ((_now_tick >> shift) + 1) << shift );
+              }
+              if( next_tick == uint64_t(-1) )
+                 return first;
+              return std::min( first, time_point( microseconds( int64_t(next_tick * tick_us) ) ) );
+           }
+
+
+           void link( hook& h )
+           {
+              uint64_t t = std::max( tick_of( h.node->*When ), _now_tick );
+              uint64_t delta = t - _now_tick;
+
+              hook* slot = &_overflow;
+              h.level = num_levels + 1;
+              if( delta < root_size )
+              {
+                 slot = &_root[t & root_mask];
+                 h.level = 0;
+              }
+              else
+              {
+                 for( uint32_t l = 0; l < num_levels; ++l )
+                 {
+                    if( delta < (uint64_t(1) << shift_of(l+1)) )
+                    {
+                       slot = &_levels[l][(t >> shift_of(l)) & level_mask];
+                       h.level = l + 1;
+                       break;
+                    }
+                 }
+              }
+
+              h.prev = slot->prev;
+              h.next = slot;
+              slot->prev->next = &h;
+              slot->prev = &h;
+              ++_counts[h.level];
+           }
+
+           void unlink( hook& h )
+           {
+              h.prev->next = h.next;
+              h.next->prev = h.prev;
+              h.prev = h.next = nullptr;
+              --_counts[h.level];
+           }
+
+           /** moves every node of @p slot back through link(), closer to the root */
+           void relink_slot( hook& slot )
+           {
+              hook* h = slot.next;
+              while( h != &slot )
+              {
+                 hook* next = h->next;
+                 --_counts[h->level];
+                 link( *h );
+                 h = next;
+              }
+           }
+
+           void move_slot( hook& slot )
+           {
+              if( slot.next == &slot )
+                 return;
+              // detach the list first, link() may put nodes back into this very slot
+              hook pending;
+              pending.next = slot.next;
+              pending.prev = slot.prev;
+              pending.next->prev = &pending;
+              pending.prev->next = &pending;
+              reset( slot );
+              relink_slot( pending );
+           }
+
+           /** called whenever _now_tick reaches the start of a root rotation */
+           void cascade()
+           {
+              uint32_t l = 0;
+              for( ; l < num_levels; ++l )
+              {
+                 uint32_t index = (_now_tick >> shift_of(l)) & level_mask;
+                 move_slot( _levels[l][index] );
+                 if( index != 0 )
+                    break;
+              }
+              if( l == num_levels )
+                 move_slot( _overflow );
+           }
+
+           void clear_slot( hook& slot, std::vector<Node*>& removed )
+           {
+              for( hook* h = slot.next; h != &slot; )
+              {
+                 hook* next = h->next;
+                 --_counts[h->level];
+                 h->prev = h->next = nullptr;
+                 removed.push_back( h->node );
+                 h = next;
+              }
+              reset( slot );
+           }
+
+           template<typename Functor>
+           static void for_each_in_slot( const hook& slot, Functor& f )
+           {
+              for( const hook* h = slot.next; h != &slot; h = h->next )
+                 f( h->node );
+           }
+
+           uint64_t   _now_tick;                  // the tick whose root slot expire() looks at first
+           size_t     _size;
+           mutable time_point _next;              // never later than the first deadline, while _next_valid
+           mutable bool       _next_valid;
+           uint32_t   _counts[num_levels + 2];    // nodes per level, the last entry is the overflow list
+           hook       _root[root_size];
+           hook       _levels[num_levels][level_size];
+           hook       _overflow;
+    };
+
+} // namespace fc
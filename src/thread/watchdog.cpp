@@ -0,0 +1,362 @@
+#include <fc/thread/watchdog.hpp>
+#include <fc/variant_object.hpp>
+#include <fc/log/logger.hpp>
+#include "thread_d.hpp"
+
+#include <boost/thread.hpp>
+#include <boost/thread/tss.hpp>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#if defined(__linux__) && defined(__GLIBC__)
+# define FC_WATCHDOG_BACKTRACES
+# include <execinfo.h>
+# include <errno.h>
+# include <pthread.h>
+# include <signal.h>
+# include <stdlib.h>
+# include <string.h>
+#endif
+
+namespace fc {
+
+   boost::atomic<uint32_t> watchdogs_running(0);
+   boost::atomic<int64_t>  watchdog_start_us(0);
+
+   namespace {
+      typedef std::map<std::string,task_slice_tracker::totals> totals_by_desc;
+
+      struct watched_thread
+      {
+         thread_d*  td;
+#ifdef FC_WATCHDOG_BACKTRACES
+         pthread_t  native;
+#endif
+         uint32_t   pins;   // watchdogs using td without the registry lock, td outlives them
+      };
+
+      /** every live thread_d, a thread stays in here until its OS thread exits */
+      struct registry
+      {
+         boost::mutex                 lock;
+         boost::condition_variable    unpinned;
+         std::vector<watched_thread>  threads;
+         totals_by_desc               retired;   // non-yielding time of threads that are gone
+
+         std::vector<watched_thread>::iterator find( thread_d* t )
+         {
+            return std::find_if( threads.begin(), threads.end(),
+                                 [t]( const watched_thread& w ){ return w.td == t; } );
+         }
+
+         static registry& instance()
+         {
+            // leaked on purpose, threads unregister while static destructors run
+            static registry* r = new registry();
+            return *r;
+         }
+      };
+
+      void add_totals( totals_by_desc& out, const char* desc, const task_slice_tracker::totals& t )
+      {
+         task_slice_tracker::totals& sum = out[desc];
+         sum.total_us += t.total_us;
+         sum.max_us = std::max( sum.max_us, t.max_us );
+         sum.count += t.count;
+      }
+
+      void collect_totals( totals_by_desc& out, task_slice_tracker& s )
+      {
+         synchronized( s.lock )
+         {
+            for( const auto& item : s.non_yielding )
+               add_totals( out, item.first, item.second );
+         }
+      }
+
+#ifdef _MSC_VER
+      static __declspec(thread) task_slice_tracker* current_tracker = nullptr;
+#else
+      static __thread task_slice_tracker* current_tracker = nullptr;
+#endif
+
+      /** unregisters the thread_d of a thread when the thread exits, even if nobody quit() it */
+      struct exit_guard
+      {
+         exit_guard( thread_d* t ):td(t){}
+         ~exit_guard() { if( td ) unregister_watched_thread( td ); }
+         thread_d* td;
+      };
+
+      boost::thread_specific_ptr<exit_guard>& exit_guards()
+      {
+         static boost::thread_specific_ptr<exit_guard>* guards = new boost::thread_specific_ptr<exit_guard>();
+         return *guards;
+      }
+
+#ifdef FC_WATCHDOG_BACKTRACES
+      const int backtrace_signal = SIGURG;
+      struct sigaction previous_action; // what the process had for backtrace_signal, every other SIGURG goes there
+
+      void on_backtrace_signal( int sig, siginfo_t* info, void* context )
+      {
+         int saved_errno = errno;
+         task_slice_tracker* t = current_tracker;
+         if( t && t->frame_count.load( boost::memory_order_acquire ) == -1 )
+            t->frame_count.store( backtrace( t->frames, task_slice_tracker::max_frames ), boost::memory_order_release );
+         else if( previous_action.sa_flags & SA_SIGINFO )
+            previous_action.sa_sigaction( sig, info, context );
+         else if( previous_action.sa_handler != SIG_DFL && previous_action.sa_handler != SIG_IGN )
+            previous_action.sa_handler( sig );
+         errno = saved_errno;
+      }
+
+      void install_backtrace_handler()
+      {
+         static boost::once_flag once = BOOST_ONCE_INIT;
+         boost::call_once( once, [](){
+            // backtrace() loads libgcc the first time, which is not safe in a signal handler
+            void* frame;
+            backtrace( &frame, 1 );
+
+            struct sigaction sa;
+            memset( &sa, 0, sizeof(sa) );
+            sa.sa_sigaction = &on_backtrace_signal;
+            sa.sa_flags = SA_RESTART | SA_SIGINFO;
+            sigemptyset( &sa.sa_mask );
+            sigaction( backtrace_signal, &sa, &previous_action );
+         } );
+      }
+
+      /**
+       *  interrupts @p w and has it record its own stack, waiting up to 100ms for it.
+       *  The caller has pinned @p w but does not hold the registry lock.
+       */
+      std::string capture_backtrace( const watched_thread& w )
+      {
+         task_slice_tracker& s = w.td->slices;
+         s.frame_count.store( -1, boost::memory_order_release );
+         if( pthread_kill( w.native, backtrace_signal ) != 0 )
+            return std::string();
+
+         int frames = -1;
+         for( int i = 0; i < 100 && frames < 0; ++i )
+         {
+            boost::this_thread::sleep_for( boost::chrono::milliseconds(1) );
+            frames = s.frame_count.load( boost::memory_order_acquire );
+         }
+         if( frames <= 0 )
+            return std::string();
+
+         std::string result;
+         char** symbols = backtrace_symbols( s.frames, frames );
+         if( symbols )
+         {
+            for( int i = 0; i < frames; ++i )
+               result += std::string("\n    ") + symbols[i];
+            free( symbols );
+         }
+         return result;
+      }
+#endif
+   }
+
+   void register_watched_thread( thread_d* t )
+   {
+      watched_thread w;
+      w.td = t;
+      w.pins = 0;
+#ifdef FC_WATCHDOG_BACKTRACES
+      w.native = pthread_self();
+#endif
+      current_tracker = &t->slices;
+      exit_guards().reset( new exit_guard( t ) );
+
+      registry& r = registry::instance();
+      boost::unique_lock<boost::mutex> l( r.lock );
+      r.threads.push_back( w );
+   }
+
+   void unregister_watched_thread( thread_d* t )
+   {
+      if( current_tracker == &t->slices )
+      {
+         current_tracker = nullptr;
+         if( exit_guard* g = exit_guards().get() )
+            g->td = nullptr;
+      }
+
+      registry& r = registry::instance();
+      boost::unique_lock<boost::mutex> l( r.lock );
+      auto itr = r.find( t );
+      // a watchdog capturing this thread's backtrace keeps t alive until it is done
+      while( itr != r.threads.end() && itr->pins )
+      {
+         r.unpinned.wait( l );
+         itr = r.find( t );
+      }
+      if( itr == r.threads.end() )
+         return;
+      collect_totals( r.retired, t->slices );
+      r.threads.erase( itr );
+   }
+
+   namespace detail {
+      class watchdog_impl
+      {
+         public:
+            watchdog_impl( const microseconds& threshold, const microseconds& interval, bool backtraces )
+            :_threshold(threshold),
+             _interval(interval),
+             _backtraces(backtraces),
+             _stopping(false)
+            {
+#ifdef FC_WATCHDOG_BACKTRACES
+               if( _backtraces )
+                  install_backtrace_handler();
+#endif
+               if( watchdogs_running.load() == 0 )
+                  watchdog_start_us.store( time_point::now().time_since_epoch().count() );
+               ++watchdogs_running;
+               _thread.reset( new boost::thread( [this](){ run(); } ) );
+            }
+
+            ~watchdog_impl()
+            {
+               {
+                  boost::unique_lock<boost::mutex> l( _stop_mutex );
+                  _stopping = true;
+               }
+               _stop.notify_one();
+               _thread->join();
+               --watchdogs_running;
+            }
+
+         private:
+            struct stall
+            {
+               std::string desc;
+               std::string thread_name;
+               int64_t     running_ms;
+               std::string backtrace;
+            };
+
+            void run()
+            {
+               boost::unique_lock<boost::mutex> l( _stop_mutex );
+               while( !_stopping )
+               {
+                  _stop.wait_for( l, boost::chrono::microseconds( _interval.count() ) );
+                  if( _stopping )
+                     break;
+                  l.unlock();
+                  check();
+                  l.lock();
+               }
+            }
+
+            void check()
+            {
+               std::vector<stall> stalls;
+               std::vector<watched_thread> pinned;   // the threads to take a backtrace of, same order as stalls
+               registry& r = registry::instance();
+               {
+                  boost::unique_lock<boost::mutex> l( r.lock );
+                  std::map<thread_d*,uint64_t> reported;
+                  int64_t now = time_point::now().time_since_epoch().count();
+                  for( watched_thread& w : r.threads )
+                  {
+                     task_slice_tracker& s = w.td->slices;
+                     uint64_t id = s.id.load( boost::memory_order_acquire );
+                     const char* desc = s.desc.load( boost::memory_order_relaxed );
+                     int64_t started = std::max( s.start_us.load( boost::memory_order_relaxed ),
+                                                 watchdog_start_us.load( boost::memory_order_relaxed ) );
+                     if( !desc || now - started < _threshold.count() )
+                        continue;
+
+                     // report every stall once, however many checks it lasts
+                     reported[w.td] = id;
+                     auto last = _reported.find( w.td );
+                     if( last != _reported.end() && last->second == id )
+                        continue;
+
+                     stall st;
+                     st.desc = desc;
+                     st.thread_name = w.td->name;
+                     st.running_ms = (now - started) / 1000;
+                     stalls.push_back( st );
+#ifdef FC_WATCHDOG_BACKTRACES
+                     if( _backtraces )
+                     {
+                        ++w.pins;
+                        pinned.push_back( w );
+                     }
+#endif
+                  }
+                  _reported.swap( reported );
+               }
+
+#ifdef FC_WATCHDOG_BACKTRACES
+               // capturing waits for each thread to answer the signal, without the registry
+               // lock so threads can still start and exit meanwhile
+               for( size_t i = 0; i < pinned.size(); ++i )
+                  stalls[i].backtrace = capture_backtrace( pinned[i] );
+               if( !pinned.empty() )
+               {
+                  {
+                     boost::unique_lock<boost::mutex> l( r.lock );
+                     for( const watched_thread& w : pinned )
+                        --r.find( w.td )->pins;
+                  }
+                  r.unpinned.notify_all();
+               }
+#endif
+
+               // log without the registry lock, a log appender may start threads of its own
+               for( const stall& st : stalls )
+                  elog( "task '${desc}' on thread ${thread} has been running for ${ms} ms without yielding${backtrace}",
+                        ("desc", st.desc)("thread", st.thread_name)("ms", st.running_ms)("backtrace", st.backtrace) );
+            }
+
+            microseconds                     _threshold;
+            microseconds                     _interval;
+            bool                             _backtraces;
+            bool                             _stopping;
+            boost::mutex                     _stop_mutex;
+            boost::condition_variable        _stop;
+            std::unique_ptr<boost::thread>   _thread;
+            std::map<thread_d*,uint64_t>     _reported;  // slice id last reported per thread
+      };
+   }
+
+   watchdog::watchdog( const microseconds& threshold, const microseconds& check_interval, bool capture_backtraces )
+   :my( new detail::watchdog_impl( threshold, check_interval, capture_backtraces ) )
+   {
+   }
+
+   watchdog::~watchdog()
+   {
+   }
+
+   variant_object watchdog::non_yielding_time()const
+   {
+      totals_by_desc totals;
+      {
+         registry& r = registry::instance();
+         boost::unique_lock<boost::mutex> l( r.lock );
+         totals = r.retired;
+         for( const watched_thread& w : r.threads )
+            collect_totals( totals, w.td->slices );
+      }
+
+      mutable_variant_object result;
+      for( const auto& item : totals )
+         result( item.first, mutable_variant_object()
+                                ( "total_us", item.second.total_us )
+                                ( "max_us", item.second.max_us )
+                                ( "count", item.second.count ) );
+      return result;
+   }
+
+} // namespace fc
@@ -0,0 +1,86 @@
+#pragma once
+#include <fc/time.hpp>
+#include <fc/thread/spin_lock.hpp>
+#include <fc/thread/unique_lock.hpp>
+#include <boost/atomic.hpp>
+#include <unordered_map>
+
+namespace fc {
+    class thread_d;
+
+    /** number of fc::watchdog instances running, threads only track slices while it is not zero */
+    extern boost::atomic<uint32_t> watchdogs_running;
+    /** when the first running watchdog started, in microseconds since the epoch */
+    extern boost::atomic<int64_t>  watchdog_start_us;
+
+    /**
+     *  What one thread is running right now, as seen by the watchdog.
+     *
+     *  A slice is a stretch of time that a fiber runs without yielding.  A new
+     *  slice starts whenever the thread switches contexts or picks up a task.
+     *  The owning thread writes the current slice, the watchdog thread reads it.
+     */
+    struct task_slice_tracker {
+        struct totals {
+           totals():total_us(0),max_us(0),count(0){}
+           uint64_t total_us;
+           uint64_t max_us;
+           uint64_t count;
+        };
+
+        task_slice_tracker()
+        :id(0),
+         desc(nullptr),
+         start_us(0),
+         frame_count(0)
+        {}
+
+        /** starts a new slice running @p new_desc, nullptr while the scheduler itself runs */
+        void begin( const char* new_desc )
+        {
+           if( !watchdogs_running.load( boost::memory_order_relaxed ) )
+           {
+              // forget the slice, a later watchdog must not mistake it for a stall
+              if( desc.load( boost::memory_order_relaxed ) )
+                 desc.store( nullptr, boost::memory_order_relaxed );
+              return;
+           }
+
+           int64_t now = time_point::now().time_since_epoch().count();
+           const char* prev = desc.load( boost::memory_order_relaxed );
+           if( prev )
+           {
+              int64_t started = std::max( start_us.load( boost::memory_order_relaxed ),
+                                          watchdog_start_us.load( boost::memory_order_relaxed ) );
+              uint64_t us = now > started ? uint64_t(now - started) : 0;
+              synchronized( lock )
+              {
+                 totals& t = non_yielding[prev];
+                 t.total_us += us;
+                 t.max_us = std::max( t.max_us, us );
+                 ++t.count;
+              }
+           }
+           desc.store( new_desc, boost::memory_order_relaxed );
+           start_us.store( now, boost::memory_order_relaxed );
+           id.store( id.load( boost::memory_order_relaxed ) + 1, boost::memory_order_release );
+        }
+
+        boost::atomic<uint64_t>     id;        // changes with every slice
+        boost::atomic<const char*>  desc;      // get_desc() of the running task
+        boost::atomic<int64_t>      start_us;
+
+        fc::spin_lock                                  lock;
+        std::unordered_map<const char*,totals>         non_yielding;  // keyed by get_desc()
+
+        // filled in by the signal handler when the watchdog asks for a backtrace
+        enum { max_frames = 64 };
+        void*                       frames[max_frames];
+        boost::atomic<int>          frame_count;   // -1 while a capture is pending
+    };
+
+    /** makes @p t visible to watchdogs until the thread exits */
+    void register_watched_thread( thread_d* t );
+    void unregister_watched_thread( thread_d* t );
+
+} // namespace fc
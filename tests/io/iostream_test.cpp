@@ -0,0 +1,133 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/io/buffered_iostream.hpp>
+#include <fc/io/iostream.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+   /** takes at most @c limit bytes per writesome(), the gathered one only if @c gathers */
+   class chunky_ostream : public fc::ostream
+   {
+      public:
+         chunky_ostream( size_t l, bool g = false ):limit(l),gathers(g),writes(0),flushes(0){}
+
+         virtual size_t writesome( const char* buf, size_t len )
+         {
+            BOOST_REQUIRE( len > 0 );
+            ++writes;
+            const size_t n = std::min( len, limit );
+            data.append( buf, n );
+            return n;
+         }
+         virtual size_t writesome( const std::shared_ptr<const char>& buf, size_t len, size_t offset )
+         {
+            return writesome( buf.get() + offset, len );
+         }
+         virtual size_t writesome( const fc::const_buffer* buffers, size_t count )
+         {
+            if( !gathers )
+               return fc::ostream::writesome( buffers, count );
+            ++writes;
+            size_t written = 0;
+            for( size_t i = 0; i < count && written < limit; ++i )
+            {
+               const size_t n = std::min( buffers[i].size, limit - written );
+               data.append( buffers[i].data, n );
+               written += n;
+            }
+            return written;
+         }
+         virtual void close() {}
+         virtual void flush() { ++flushes; }
+
+         size_t      limit;
+         bool        gathers;
+         size_t      writes;
+         size_t      flushes;
+         std::string data;
+   };
+
+   fc::const_buffers pieces( const std::vector<std::string>& strings )
+   {
+      fc::const_buffers buffers;
+      for( const std::string& s : strings )
+         buffers.push_back( fc::const_buffer( s.data(), s.size() ) );
+      return buffers;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(fc_io)
+
+BOOST_AUTO_TEST_CASE( default_gathered_writesome )
+{
+   const std::vector<std::string> strings = { "", "abc", "de" };
+   const fc::const_buffers buffers = pieces( strings );
+
+   // writes from the first nonempty buffer only
+   chunky_ostream out( 100 );
+   BOOST_CHECK_EQUAL( out.writesome( buffers.data(), buffers.size() ), 3u );
+   BOOST_CHECK_EQUAL( out.data, "abc" );
+
+   // nothing to write is not a write
+   BOOST_CHECK_EQUAL( out.writesome( buffers.data(), 1 ), 0u );
+   BOOST_CHECK_EQUAL( out.writesome( buffers.data(), 0 ), 0u );
+   BOOST_CHECK_EQUAL( out.writes, 1u );
+}
+
+BOOST_AUTO_TEST_CASE( write_all_across_buffer_boundaries )
+{
+   const std::vector<std::string> strings = { "ab", "", "cdefg", "", "", "h", "ijklmnop", "" };
+   const fc::const_buffers buffers = pieces( strings );
+
+   for( size_t limit = 1; limit <= 17; ++limit )
+   {
+      chunky_ostream one_at_a_time( limit ), gathering( limit, true );
+      one_at_a_time.write_all( buffers );
+      gathering.write_all( buffers );
+      BOOST_CHECK_EQUAL( one_at_a_time.data, "abcdefghijklmnop" );
+      BOOST_CHECK_EQUAL( gathering.data, "abcdefghijklmnop" );
+      // each gathered write ends wherever the limit falls, mid buffer or not
+      BOOST_CHECK_EQUAL( gathering.writes, (16 + limit - 1) / limit );
+   }
+
+   // only empty buffers, or none
+   const std::vector<std::string> empty = { "", "" };
+   chunky_ostream out( 4, true );
+   out.write_all( pieces( empty ) );
+   out.write_all( fc::const_buffers() );
+   BOOST_CHECK_EQUAL( out.writes, 0u );
+   BOOST_CHECK( out.data.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( buffered_ostream_gathers_and_flushes )
+{
+   std::shared_ptr<chunky_ostream> sink = std::make_shared<chunky_ostream>( 1000 );
+   fc::buffered_ostream out( sink );
+
+   const std::vector<std::string> strings = { "ab", "", "cde" };
+   const fc::const_buffers buffers = pieces( strings );
+   BOOST_CHECK_EQUAL( out.writesome( buffers.data(), buffers.size() ), 5u );
+   BOOST_CHECK_EQUAL( out.writesome( buffers.data(), 0 ), 0u );
+   BOOST_CHECK( sink->data.empty() );
+   out.flush();
+   BOOST_CHECK_EQUAL( sink->data, "abcde" );
+   BOOST_CHECK_EQUAL( sink->flushes, 1u );
+
+   // a big flush goes out in bounded pieces, in order
+   std::string big( 300 * 1024, 'x' );
+   for( size_t i = 0; i < big.size(); ++i )
+      big[i] = char( 'a' + i % 26 );
+   out.write( big.data(), big.size() );
+   out.flush();
+   BOOST_CHECK( sink->data == "abcde" + big );
+
+   // and nothing buffered is nothing written
+   const size_t writes = sink->writes;
+   out.flush();
+   BOOST_CHECK_EQUAL( sink->writes, writes );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
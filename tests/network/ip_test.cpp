@@ -0,0 +1,176 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/network/ip.hpp>
+#include <fc/network/tcp_socket.hpp>
+#include <fc/network/udp_socket.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/variant.hpp>
+
+#include <string.h>
+
+BOOST_AUTO_TEST_SUITE(fc_network)
+
+BOOST_AUTO_TEST_CASE( any_address_strings )
+{
+   const fc::ip::any_address v4( fc::string( "192.168.1.2" ) );
+   BOOST_CHECK( v4.is_v4() );
+   BOOST_CHECK( v4 == fc::ip::any_address( fc::ip::address( "192.168.1.2" ) ) );
+   BOOST_CHECK( v4 == fc::ip::any_address( fc::string( "::ffff:192.168.1.2" ) ) );
+   BOOST_CHECK_EQUAL( fc::string( v4 ), "192.168.1.2" );
+   BOOST_CHECK( v4.to_v4() == fc::ip::address( "192.168.1.2" ) );
+   BOOST_CHECK( v4.is_private_address() );
+
+   const fc::ip::any_address v6( fc::string( "2001:DB8:0:0:0:0:0:1" ) );
+   BOOST_CHECK( v6.is_v6() );
+   BOOST_CHECK_EQUAL( fc::string( v6 ), "2001:db8::1" );
+   BOOST_CHECK_THROW( v6.to_v4(), fc::invalid_operation_exception );
+   BOOST_CHECK( v6.is_public_address() );
+   BOOST_CHECK( fc::ip::any_address::v6_loopback().is_loopback_address() );
+   BOOST_CHECK( fc::ip::any_address( fc::string( "fe80::1" ) ).is_private_address() );
+   BOOST_CHECK( fc::ip::any_address( fc::string( "ff02::1" ) ).is_multicast_address() );
+
+   const fc::ip::any_endpoint ep = fc::ip::any_endpoint::from_string( "[2001:db8::1]:8090" );
+   BOOST_CHECK( ep.get_address() == v6 );
+   BOOST_CHECK_EQUAL( ep.port(), 8090 );
+   BOOST_CHECK_EQUAL( fc::string( ep ), "[2001:db8::1]:8090" );
+   BOOST_CHECK_EQUAL( fc::string( fc::ip::any_endpoint::from_string( "10.0.0.1:80" ) ), "10.0.0.1:80" );
+   BOOST_CHECK( fc::ip::any_endpoint::from_string( "10.0.0.1:80" ) == fc::ip::endpoint::from_string( "10.0.0.1:80" ) );
+
+   fc::ip::any_endpoint from_var;
+   fc::from_variant( fc::variant( ep ), from_var );
+   BOOST_CHECK( from_var == ep );
+}
+
+BOOST_AUTO_TEST_CASE( any_endpoint_raw )
+{
+   const fc::ip::any_endpoint ep = fc::ip::any_endpoint::from_string( "[::1]:1776" );
+   const std::vector<char> packed = fc::raw::pack( ep );
+   BOOST_CHECK_EQUAL( packed.size(), 18u );
+   BOOST_CHECK( fc::raw::unpack<fc::ip::any_endpoint>( packed ) == ep );
+
+   // the IPv4 only types keep their 4 byte address
+   BOOST_CHECK_EQUAL( fc::raw::pack( fc::ip::endpoint::from_string( "127.0.0.1:1776" ) ).size(), 6u );
+}
+
+BOOST_AUTO_TEST_CASE( ipv6_loopback_sockets )
+{
+   fc::tcp_server server;
+   try
+   {
+      server.listen( fc::ip::any_endpoint( fc::ip::any_address::v6_loopback() ) );
+   }
+   catch( const fc::exception& )
+   {
+      BOOST_TEST_MESSAGE( "no IPv6 loopback, skipping" );
+      return;
+   }
+   const fc::ip::any_endpoint server_ep = server.get_local_any_endpoint();
+   BOOST_CHECK( server_ep.get_address() == fc::ip::any_address::v6_loopback() );
+
+   fc::tcp_socket accepted, client;
+   fc::future<void> accepting = fc::async( [&](){ server.accept( accepted ); } );
+   client.connect_to( server_ep );
+   accepting.wait();
+   BOOST_CHECK( accepted.remote_any_endpoint() == client.local_any_endpoint() );
+   BOOST_CHECK_THROW( client.remote_endpoint(), fc::exception );
+
+   client.write( "ping", 4 );
+   char buf[4];
+   accepted.read( buf, 4 );
+   BOOST_CHECK( !memcmp( buf, "ping", 4 ) );
+
+   fc::udp_socket receiver, sender;
+   receiver.open( true );
+   receiver.bind( fc::ip::any_endpoint( fc::ip::any_address::v6_loopback() ) );
+   sender.open( true );
+   BOOST_CHECK_EQUAL( sender.send_to( "pong", 4, receiver.local_any_endpoint() ), 4u );
+   fc::ip::any_endpoint from;
+   BOOST_CHECK_EQUAL( receiver.receive_from( buf, sizeof(buf), from ), 4u );
+   BOOST_CHECK( !memcmp( buf, "pong", 4 ) );
+   BOOST_CHECK( from.is_v6() );
+}
+
+BOOST_AUTO_TEST_CASE( ipv4_peers_of_a_dual_stack_server )
+{
+   fc::tcp_server server;
+   try
+   {
+      server.listen( fc::ip::any_endpoint( fc::ip::any_address::v6_any() ) );
+   }
+   catch( const fc::exception& )
+   {
+      BOOST_TEST_MESSAGE( "no IPv6, skipping" );
+      return;
+   }
+   fc::tcp_socket accepted, client;
+   fc::future<void> accepting = fc::async( [&](){ server.accept( accepted ); } );
+   client.connect_to( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), server.get_port() ) );
+   accepting.wait();
+
+   // the accepted socket is IPv6, its IPv4 addresses come back unmapped
+   BOOST_CHECK( accepted.remote_any_endpoint().is_v4() );
+   BOOST_CHECK( accepted.remote_endpoint() == client.local_endpoint() );
+   BOOST_CHECK( accepted.local_endpoint() == client.remote_endpoint() );
+   BOOST_CHECK_THROW( server.get_local_endpoint(), fc::exception );
+}
+
+BOOST_AUTO_TEST_CASE( tcp_gathered_writes )
+{
+   fc::tcp_server server;
+   server.listen( fc::ip::endpoint::from_string( "127.0.0.1:0" ) );
+   fc::tcp_socket accepted, client;
+   fc::future<void> accepting = fc::async( [&](){ server.accept( accepted ); } );
+   client.connect_to( server.get_local_endpoint() );
+   accepting.wait();
+
+   // more buffers than one gathered write takes, empty ones, and one big
+   // enough to fill the socket so writes end in the middle of a buffer
+   std::vector<std::string> pieces;
+   std::string expected;
+   for( int i = 0; i < 20; ++i )
+   {
+      pieces.push_back( i % 3 == 1 ? std::string() : std::string( size_t( i + 1 ), char( 'a' + i ) ) );
+      if( i == 10 )
+         pieces.push_back( std::string( 4 * 1024 * 1024, 'z' ) );
+   }
+   fc::const_buffers buffers;
+   for( const std::string& p : pieces )
+   {
+      buffers.push_back( fc::const_buffer( p.data(), p.size() ) );
+      expected += p;
+   }
+
+   std::string received( expected.size(), '\0' );
+   fc::future<void> reading = fc::async( [&](){ accepted.read( &received[0], received.size() ); } );
+   client.write_all( buffers );
+   client.write_all( buffers.data(), 0 );
+   reading.wait();
+   BOOST_CHECK( received == expected );
+}
+
+BOOST_AUTO_TEST_CASE( tcp_reads_that_never_wait_still_yield )
+{
+   fc::tcp_server server;
+   server.listen( fc::ip::endpoint::from_string( "127.0.0.1:0" ) );
+   fc::tcp_socket accepted, client;
+   fc::future<void> accepting = fc::async( [&](){ server.accept( accepted ); } );
+   client.connect_to( server.get_local_endpoint() );
+   accepting.wait();
+
+   std::string sent( 16 * 1024, 'x' );
+   client.write( sent.data(), sent.size() );
+   fc::usleep( fc::milliseconds(20) );
+
+   // every read finds data waiting, the other fiber still gets to run
+   bool ran = false;
+   fc::future<void> other = fc::async( [&](){ ran = true; } );
+   char buf[16];
+   for( int i = 0; i < 100; ++i )
+      BOOST_REQUIRE_GT( accepted.readsome( buf, sizeof(buf) ), 0u );
+   BOOST_CHECK( ran );
+   other.wait();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
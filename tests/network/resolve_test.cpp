@@ -0,0 +1,105 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/network/resolve.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+BOOST_AUTO_TEST_SUITE(fc_network)
+
+BOOST_AUTO_TEST_CASE( resolve_cache )
+{
+   fc::clear_resolve_cache();
+
+   const std::vector<fc::ip::any_endpoint> first = fc::resolve_any( "localhost", 80 );
+   BOOST_REQUIRE( !first.empty() );
+   for( const auto& ep : first )
+   {
+      BOOST_CHECK( ep.get_address().is_loopback_address() );
+      BOOST_CHECK_EQUAL( ep.port(), 80 );
+   }
+   // the cached answer only changes the port
+   const std::vector<fc::ip::any_endpoint> second = fc::resolve_any( "localhost", 8080 );
+   BOOST_REQUIRE_EQUAL( second.size(), first.size() );
+   for( size_t i = 0; i < first.size(); ++i )
+      BOOST_CHECK( second[i].get_address() == first[i].get_address() );
+
+   // fibers of different threads asking at once share a lookup
+   fc::clear_resolve_cache();
+   fc::thread other( "resolve_test" );
+   fc::future<std::vector<fc::ip::endpoint>> theirs = other.async( [](){ return fc::resolve( "127.0.0.1", 1 ); } );
+   const std::vector<fc::ip::endpoint> mine = fc::resolve( "127.0.0.1", 1 );
+   BOOST_REQUIRE_EQUAL( mine.size(), 1u );
+   BOOST_CHECK( theirs.wait() == mine );
+   BOOST_CHECK( mine.front() == fc::ip::endpoint::from_string( "127.0.0.1:1" ) );
+
+   // failures are cached too, RFC 6761 guarantees .invalid does not resolve
+   BOOST_CHECK_THROW( fc::resolve( "fc-resolve-test.invalid", 80 ), fc::exception );
+   BOOST_CHECK_THROW( fc::resolve_any( "fc-resolve-test.invalid", 80 ), fc::exception );
+
+   fc::set_resolve_cache_ttl( fc::microseconds(), fc::microseconds() );
+   BOOST_CHECK( !fc::resolve_any( "localhost", 80 ).empty() );
+   fc::set_resolve_cache_ttl( fc::seconds(60), fc::seconds(10) );
+}
+
+BOOST_AUTO_TEST_CASE( resolve_cache_lookups )
+{
+   std::atomic<int>  lookups( 0 );
+   std::atomic<bool> fail( false );
+   fc::set_host_resolver( [&]( const std::string& host ) {
+      const int n = ++lookups;
+      std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+      if( fail )
+         FC_THROW( "no such host ${host}", ("host", host) );
+      return std::vector<fc::ip::any_address>{ fc::ip::any_address( "10.0.0." + std::to_string( n ) ) };
+   } );
+   fc::clear_resolve_cache();
+   fc::set_resolve_cache_ttl( fc::seconds(1), fc::milliseconds(200) );
+
+   // fibers of two threads asking while the lookup is in flight share it
+   fc::thread other( "resolve_test" );
+   std::vector<fc::future<std::vector<fc::ip::any_endpoint>>> asked;
+   for( int i = 0; i < 2; ++i )
+   {
+      asked.push_back( fc::async( [](){ return fc::resolve_any( "fc.test", 80 ); } ) );
+      asked.push_back( other.async( [](){ return fc::resolve_any( "fc.test", 80 ); } ) );
+   }
+   for( auto& f : asked )
+   {
+      const std::vector<fc::ip::any_endpoint> eps = f.wait();
+      BOOST_REQUIRE_EQUAL( eps.size(), 1u );
+      BOOST_CHECK_EQUAL( fc::string( eps.front().get_address() ), "10.0.0.1" );
+   }
+   BOOST_CHECK_EQUAL( lookups.load(), 1 );
+
+   // then the answer is cached
+   BOOST_CHECK_EQUAL( fc::string( fc::resolve_any( "fc.test", 80 ).front().get_address() ), "10.0.0.1" );
+   BOOST_CHECK_EQUAL( lookups.load(), 1 );
+
+   // in the last fifth of the TTL the cached answer comes back at once and is refreshed behind it
+   fc::usleep( fc::milliseconds(850) );
+   BOOST_CHECK_EQUAL( fc::string( fc::resolve_any( "fc.test", 80 ).front().get_address() ), "10.0.0.1" );
+   fc::usleep( fc::milliseconds(200) );
+   BOOST_CHECK_EQUAL( lookups.load(), 2 );
+   BOOST_CHECK_EQUAL( fc::string( fc::resolve_any( "fc.test", 80 ).front().get_address() ), "10.0.0.2" );
+   BOOST_CHECK_EQUAL( lookups.load(), 2 );
+
+   // a failure is kept for the negative TTL only
+   fail = true;
+   BOOST_CHECK_THROW( fc::resolve_any( "bad.fc.test", 80 ), fc::exception );
+   BOOST_CHECK_THROW( fc::resolve_any( "bad.fc.test", 80 ), fc::exception );
+   BOOST_CHECK_EQUAL( lookups.load(), 3 );
+   fail = false;
+   fc::usleep( fc::milliseconds(250) );
+   BOOST_CHECK_EQUAL( fc::string( fc::resolve_any( "bad.fc.test", 80 ).front().get_address() ), "10.0.0.4" );
+   BOOST_CHECK_EQUAL( lookups.load(), 4 );
+
+   fc::set_host_resolver( fc::host_resolver() );
+   fc::set_resolve_cache_ttl( fc::seconds(60), fc::seconds(10) );
+   fc::clear_resolve_cache();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,108 @@
+#include <fc/asio.hpp>
+#include <fc/io/uring.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/time.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/**
+ *  Measures request/response latency of small messages over loopback TCP,
+ *  an echo server on one fc::thread and a client on another:
+ *   - opportunistic: fc::asio::read_some()/write_some(), which try the socket
+ *     without waiting before going through the io_service
+ *   - async only: every read and write goes through the io_service and a
+ *     promise, what read_some()/write_some() did before
+ *   - io_uring: fc::uring::recv()/send(), if the kernel supports it
+ *
+ *  usage: rpc_latency_benchmark [iterations] [message size]
+ */
+
+typedef boost::asio::ip::tcp::socket socket_type;
+
+enum mode { async_only, opportunistic, io_uring };
+
+static void transfer( socket_type& s, char* buf, size_t len, bool write, mode m )
+{
+   size_t done = 0;
+   while( done < len )
+   {
+      if( m == opportunistic )
+         done += write ? fc::asio::write_some( s, buf + done, len - done ).wait()
+                       : fc::asio::read_some( s, buf + done, len - done ).wait();
+      else if( m == io_uring )
+         done += write ? fc::uring::send( s.native_handle(), buf + done, len - done ).wait()
+                       : fc::uring::recv( s.native_handle(), buf + done, len - done ).wait();
+      else
+      {
+         fc::promise<size_t>::ptr p( new fc::promise<size_t>( "rpc_latency_benchmark" ) );
+         if( write )
+            fc::asio::async_write_some( s, buf + done, len - done, p );
+         else
+            fc::asio::async_read_some( s, buf + done, len - done, p );
+         done += p->wait();
+      }
+   }
+}
+
+static void run( const char* what, uint64_t iterations, size_t message_size, mode m )
+{
+   fc::thread server_thread( "server" );
+   fc::thread client_thread( "client" );
+
+   boost::asio::ip::tcp::acceptor acceptor( fc::asio::socket_io_service(),
+                                            boost::asio::ip::tcp::endpoint( boost::asio::ip::address_v4::loopback(), 0 ) );
+   const uint16_t port = acceptor.local_endpoint().port();
+
+   fc::future<void> served = server_thread.async( [&](){
+      socket_type s( fc::asio::socket_io_service() );
+      fc::asio::tcp::accept( acceptor, s );
+      s.set_option( boost::asio::ip::tcp::no_delay(true) );
+      std::vector<char> buf( message_size );
+      for( uint64_t i = 0; i < iterations; ++i )
+      {
+         transfer( s, buf.data(), buf.size(), false, m );
+         transfer( s, buf.data(), buf.size(), true, m );
+      }
+   }, "serve" );
+
+   std::vector<int64_t> latencies = client_thread.async( [&](){
+      socket_type s( fc::asio::socket_io_service() );
+      fc::asio::tcp::connect( s, boost::asio::ip::tcp::endpoint( boost::asio::ip::address_v4::loopback(), port ) );
+      s.set_option( boost::asio::ip::tcp::no_delay(true) );
+      std::vector<char> buf( message_size, 'x' );
+      std::vector<int64_t> us;
+      us.reserve( iterations );
+      for( uint64_t i = 0; i < iterations; ++i )
+      {
+         fc::time_point start = fc::time_point::now();
+         transfer( s, buf.data(), buf.size(), true, m );
+         transfer( s, buf.data(), buf.size(), false, m );
+         us.push_back( (fc::time_point::now() - start).count() );
+      }
+      return us;
+   }, "call" ).wait();
+   served.wait();
+
+   int64_t total = 0;
+   for( int64_t l : latencies )
+      total += l;
+   std::sort( latencies.begin(), latencies.end() );
+   std::cout << what << ": " << iterations << " round trips of " << message_size << " bytes, "
+             << double(total) / iterations << " us/round trip, p50 " << latencies[latencies.size() / 2]
+             << " us, p99 " << latencies[latencies.size() * 99 / 100] << " us\n";
+}
+
+int main( int argc, char** argv )
+{
+   uint64_t iterations   = argc > 1 ? strtoull( argv[1], nullptr, 10 ) : 20000;
+   size_t   message_size = argc > 2 ? strtoul( argv[2], nullptr, 10 )  : 64;
+
+   run( "async only", iterations, message_size, async_only );
+   run( "opportunistic", iterations, message_size, opportunistic );
+   if( fc::uring::available() )
+      run( "io_uring", iterations, message_size, io_uring );
+   return 0;
+}
@@ -0,0 +1,159 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/network/udp_socket.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <string.h>
+
+namespace {
+   /** receives until @p datagrams datagrams or GRO segments have arrived, @return the bytes received */
+   size_t receive_datagrams( fc::udp_socket& s, size_t datagrams )
+   {
+      std::vector<std::vector<char>> storage( 4, std::vector<char>( 65536 ) );
+      size_t bytes = 0;
+      while( datagrams > 0 )
+      {
+         std::vector<fc::udp_message> batch;
+         for( auto& buf : storage )
+            batch.push_back( fc::udp_message( buf.data(), buf.size() ) );
+         const size_t n = s.receive_batch( batch.data(), batch.size() );
+         BOOST_REQUIRE( n > 0 && n <= batch.size() );
+         for( size_t i = 0; i < n; ++i )
+         {
+            const size_t segment = batch[i].segment_size ? batch[i].segment_size : batch[i].size;
+            const size_t segments = (batch[i].size + segment - 1) / segment;
+            BOOST_REQUIRE( segments <= datagrams );
+            datagrams -= segments;
+            bytes += batch[i].size;
+         }
+      }
+      return bytes;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(fc_network)
+
+BOOST_AUTO_TEST_CASE( udp_batches )
+{
+   fc::udp_socket receiver, sender;
+   receiver.open();
+   receiver.bind( fc::ip::endpoint::from_string( "127.0.0.1:0" ) );
+   sender.open();
+   sender.bind( fc::ip::endpoint::from_string( "127.0.0.1:0" ) );
+   const fc::ip::any_endpoint to = receiver.local_any_endpoint();
+
+   char payloads[8][4];
+   std::vector<fc::udp_message> out;
+   for( int i = 0; i < 8; ++i )
+   {
+      memcpy( payloads[i], "msg", 3 );
+      payloads[i][3] = char('0' + i);
+      out.push_back( fc::udp_message( payloads[i], 4 ) );
+      out.back().endpoint = to;
+   }
+   BOOST_CHECK_EQUAL( sender.send_batch( out.data(), out.size() ), 8u );
+
+   // all 8 were queued before the first receive, they arrive in order
+   std::vector<std::vector<char>> storage( 16, std::vector<char>( 16 ) );
+   size_t got = 0;
+   while( got < 8 )
+   {
+      std::vector<fc::udp_message> in;
+      for( auto& buf : storage )
+         in.push_back( fc::udp_message( buf.data(), buf.size() ) );
+      const size_t n = receiver.receive_batch( in.data(), in.size() );
+      BOOST_REQUIRE( n > 0 && got + n <= 8 );
+      for( size_t i = 0; i < n; ++i, ++got )
+      {
+         BOOST_CHECK_EQUAL( in[i].size, 4u );
+         BOOST_CHECK( !memcmp( in[i].data, payloads[got], 4 ) );
+         BOOST_CHECK( in[i].endpoint == sender.local_any_endpoint() );
+         BOOST_CHECK( !in[i].truncated );
+      }
+   }
+
+   // a receive waits for the next datagram, one larger than its buffer is cut off
+   fc::udp_message small( storage[0].data(), 8 );
+   fc::future<size_t> waiting = fc::async( [&](){ return receiver.receive_batch( &small, 1 ); } );
+   fc::usleep( fc::milliseconds(10) );
+   BOOST_CHECK( !waiting.ready() );
+   char big[32] = {};
+   fc::udp_message large( big, sizeof(big) );
+   large.endpoint = to;
+   sender.send_batch( &large, 1 );
+   BOOST_CHECK_EQUAL( waiting.wait(), 1u );
+   BOOST_CHECK_EQUAL( small.size, 8u );
+   BOOST_CHECK( small.truncated );
+
+   // two fibers waiting on the same socket each receive into their own buffers
+   char first_buf[8] = {}, second_buf[8] = {};
+   fc::udp_message first_in( first_buf, sizeof(first_buf) ), second_in( second_buf, sizeof(second_buf) );
+   fc::future<size_t> first = fc::async( [&](){ return receiver.receive_batch( &first_in, 1 ); } );
+   fc::usleep( fc::milliseconds(20) );
+   fc::future<size_t> second = fc::async( [&](){ return receiver.receive_batch( &second_in, 1 ); } );
+   fc::usleep( fc::milliseconds(20) );
+   char a[] = "aaaa", b[] = "bbbb";
+   fc::udp_message out_a( a, 4 ), out_b( b, 4 );
+   out_a.endpoint = out_b.endpoint = to;
+   sender.send_batch( &out_a, 1 );
+   sender.send_batch( &out_b, 1 );
+   BOOST_CHECK_EQUAL( first.wait(), 1u );
+   BOOST_CHECK_EQUAL( second.wait(), 1u );
+   BOOST_REQUIRE_EQUAL( first_in.size, 4u );
+   BOOST_REQUIRE_EQUAL( second_in.size, 4u );
+   BOOST_CHECK( !memcmp( first_buf, a, 4 ) );
+   BOOST_CHECK( !memcmp( second_buf, b, 4 ) );
+}
+
+BOOST_AUTO_TEST_CASE( udp_segmentation_offload )
+{
+   fc::udp_socket receiver, sender;
+   receiver.open();
+   receiver.bind( fc::ip::endpoint::from_string( "127.0.0.1:0" ) );
+   sender.open();
+   try
+   {
+      receiver.set_gro( true );
+   }
+   catch( ... )
+   {
+      BOOST_TEST_MESSAGE( "UDP GRO is not supported, skipping" );
+      return;
+   }
+
+   std::vector<char> payload( 3000 );
+   for( size_t i = 0; i < payload.size(); ++i )
+      payload[i] = char(i);
+   fc::udp_message segmented( payload.data(), payload.size() );
+   segmented.segment_size = 1000;
+   segmented.endpoint     = receiver.local_any_endpoint();
+   BOOST_CHECK_EQUAL( sender.send_batch( &segmented, 1 ), 1u );
+
+   // with GRO the three segments may come back as one message
+   BOOST_CHECK_EQUAL( receive_datagrams( receiver, 3 ), payload.size() );
+}
+
+BOOST_AUTO_TEST_CASE( udp_socket_dropped_with_a_receive_pending )
+{
+   // the aborted receive gives its operation back to the socket's handler
+   // memory after the socket is gone
+   for( int i = 0; i < 8; ++i )
+   {
+      std::unique_ptr<fc::udp_socket> s( new fc::udp_socket() );
+      s->open();
+      s->bind( fc::ip::endpoint::from_string( "127.0.0.1:0" ) );
+      std::shared_ptr<char> buf( new char[64], std::default_delete<char[]>() );
+      fc::future<size_t> receiving = fc::async( [&](){
+         fc::ip::any_endpoint from;
+         return s->receive_from( buf, 64, from );
+      }, "receive" );
+      fc::usleep( fc::milliseconds(20) );
+      receiving.cancel_and_wait( "dropping the socket" );
+      s->close();
+      s.reset();
+   }
+   fc::usleep( fc::milliseconds(50) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,139 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/asio.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/io/uring.hpp>
+#include <fc/network/ip.hpp>
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <boost/filesystem.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+namespace {
+   struct socket_pair
+   {
+      socket_pair()
+      :acceptor( fc::asio::default_io_service(),
+                 boost::asio::ip::tcp::endpoint( boost::asio::ip::address_v4::loopback(), 0 ) ),
+       client( fc::asio::default_io_service() ),
+       server( fc::asio::default_io_service() )
+      {
+         fc::future<void> accepted = fc::async( [&](){ fc::asio::tcp::accept( acceptor, server ); } );
+         fc::asio::tcp::connect( client, acceptor.local_endpoint() );
+         accepted.wait();
+      }
+
+      boost::asio::ip::tcp::acceptor  acceptor;
+      boost::asio::ip::tcp::socket    client;
+      boost::asio::ip::tcp::socket    server;
+   };
+}
+
+BOOST_AUTO_TEST_SUITE(fc_network)
+
+BOOST_AUTO_TEST_CASE( uring_socket_io )
+{
+   if( !fc::uring::available() )
+   {
+      BOOST_TEST_MESSAGE( "io_uring is not available, skipping" );
+      return;
+   }
+   socket_pair s;
+
+   // the reactor has put both sockets in non blocking mode, the read has to wait anyway
+   char buf[16] = {};
+   fc::future<size_t> received = fc::uring::recv( s.server.native_handle(), buf, sizeof(buf) );
+   fc::usleep( fc::milliseconds(20) );
+   BOOST_CHECK( !received.ready() );
+   BOOST_CHECK_EQUAL( fc::uring::send( s.client.native_handle(), "hello", 5 ).wait(), 5u );
+   BOOST_CHECK_EQUAL( received.wait(), 5u );
+   BOOST_CHECK( !memcmp( buf, "hello", 5 ) );
+
+   // a gathered send arrives as one stream
+   const fc::const_buffer pieces[] = { fc::const_buffer( "he", 2 ), fc::const_buffer(), fc::const_buffer( "llo", 3 ) };
+   BOOST_CHECK_EQUAL( fc::uring::send( s.client.native_handle(), pieces, 3 ).wait(), 5u );
+   size_t got = 0;
+   while( got < 5 )
+      got += fc::uring::recv( s.server.native_handle(), buf + got, sizeof(buf) - got ).wait();
+   BOOST_CHECK( !memcmp( buf, "hello", 5 ) );
+
+   // canceling fails the read in flight
+   received = fc::uring::recv( s.server.native_handle(), buf, sizeof(buf) );
+   fc::uring::cancel( s.server.native_handle() );
+   BOOST_CHECK_THROW( received.wait(), fc::exception );
+
+   s.client.close();
+   BOOST_CHECK_THROW( fc::uring::recv( s.server.native_handle(), buf, sizeof(buf) ).wait(), fc::eof_exception );
+}
+
+BOOST_AUTO_TEST_CASE( uring_file_io )
+{
+   if( !fc::uring::available() )
+   {
+      BOOST_TEST_MESSAGE( "io_uring is not available, skipping" );
+      return;
+   }
+   const boost::filesystem::path file = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+   const int fd = ::open( file.string().c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600 );
+   BOOST_REQUIRE( fd >= 0 );
+
+   fc::future<size_t> first  = fc::uring::write( fd, "abc", 3, 0 );
+   fc::future<size_t> second = fc::uring::write( fd, "def", 3, 3 );
+   BOOST_CHECK_EQUAL( first.wait() + second.wait(), 6u );
+
+   std::vector<char> fixed( 4096 );
+   fc::uring::register_buffers( { { fixed.data(), fixed.size() } } );
+   BOOST_CHECK_EQUAL( fc::uring::read_fixed( fd, fixed.data(), 6, 0, 0 ).wait(), 6u );
+   BOOST_CHECK( !memcmp( fixed.data(), "abcdef", 6 ) );
+   memcpy( fixed.data(), "xyz", 3 );
+   BOOST_CHECK_EQUAL( fc::uring::write_fixed( fd, fixed.data(), 3, 6, 0 ).wait(), 3u );
+   fc::uring::unregister_buffers();
+
+   char buf[16] = {};
+   BOOST_CHECK_EQUAL( fc::uring::read( fd, buf, sizeof(buf), 0 ).wait(), 9u );
+   BOOST_CHECK_EQUAL( std::string( buf ), "abcdefxyz" );
+
+   ::close( fd );
+   boost::filesystem::remove( file );
+}
+
+BOOST_AUTO_TEST_CASE( uring_read_canceled_after_backend_switch )
+{
+   if( !fc::uring::available() )
+   {
+      BOOST_TEST_MESSAGE( "io_uring is not available, skipping" );
+      return;
+   }
+   fc::tcp_server server;
+   server.listen( fc::ip::endpoint::from_string( "127.0.0.1:0" ) );
+   fc::tcp_socket accepted, client;
+   fc::future<void> accepting = fc::async( [&](){ server.accept( accepted ); } );
+   client.connect_to( server.get_local_endpoint() );
+   accepting.wait();
+
+   fc::asio::set_io_backend( fc::asio::io_backend::io_uring );
+   char buf[4];
+   fc::future<size_t> reading = fc::async( [&](){ return accepted.readsome( buf, sizeof(buf) ); } );
+   fc::usleep( fc::milliseconds(20) );
+
+   // the read in flight went through the ring, closing has to cancel it there
+   fc::asio::set_io_backend( fc::asio::io_backend::reactor );
+   accepted.close();
+   try
+   {
+      reading.wait( fc::seconds(5) );
+      BOOST_ERROR( "the read returned data nobody sent" );
+   }
+   catch( const fc::timeout_exception& )
+   {
+      BOOST_FAIL( "the read was left in flight on the ring" );
+   }
+   catch( const fc::exception& )
+   {
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,62 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/thread/thread.hpp>
+#include <fc/thread/affinity.hpp>
+#include <fc/exception/exception.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#ifdef __linux__
+# include <sched.h>
+#endif
+
+namespace {
+  /** the first cpu the process may run on */
+  uint32_t allowed_cpu()
+  {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    if( sched_getaffinity( 0, sizeof(set), &set ) == 0 )
+      for( uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu )
+        if( CPU_ISSET( cpu, &set ) )
+          return cpu;
+#endif
+    return fc::numa_node_cpus( 0 ).front();
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(fc_affinity)
+
+BOOST_AUTO_TEST_CASE( pin_thread_to_numa_node )
+{
+  BOOST_REQUIRE_GE( fc::numa_node_count(), 1u );
+  BOOST_REQUIRE( !fc::numa_node_cpus( 0 ).empty() );
+  BOOST_CHECK_THROW( fc::numa_node_cpus( fc::numa_node_count() ), fc::invalid_arg_exception );
+
+  // a cpu the test may run on, containers often leave some of node 0 out
+  const uint32_t cpu = allowed_cpu();
+  uint32_t node = 0;
+  for( uint32_t n = 0; n < fc::numa_node_count(); ++n )
+  {
+    const std::vector<uint32_t> cpus = fc::numa_node_cpus( n );
+    if( std::find( cpus.begin(), cpus.end(), cpu ) != cpus.end() )
+      node = n;
+  }
+
+  fc::thread worker( "numa_worker" );
+  BOOST_CHECK_EQUAL( worker.numa_node(), -1 );
+  worker.set_numa_node( node );
+  BOOST_CHECK_EQUAL( worker.numa_node(), int(node) );
+  worker.set_cpu_affinity( std::vector<uint32_t>( 1, cpu ) );
+
+  // fibers and promises keep working after the caches were let go
+  std::vector<fc::future<int>> results;
+  for( int i = 0; i < 100; ++i )
+    results.push_back( worker.async( [i](){ fc::yield(); return i; } ) );
+  for( int i = 0; i < 100; ++i )
+    BOOST_CHECK_EQUAL( results[i].wait(), i );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,73 @@
+#include <fc/thread/thread.hpp>
+#include <fc/time.hpp>
+
+#include <boost/atomic.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/**
+ *  Measures the cost of handing work to another fc::thread:
+ *   - round trip: async() a no-op and wait for it, one at a time
+ *   - throughput: one or more producer threads post no-ops as fast as they can
+ *
+ *  usage: async_benchmark [iterations] [producers]
+ */
+
+static void report( const char* what, uint64_t count, const fc::microseconds& elapsed )
+{
+   double us = double(elapsed.count());
+   std::cout << what << ": " << count << " tasks in " << us / 1000.0 << " ms, "
+             << us * 1000.0 / count << " ns/task, "
+             << uint64_t(count * 1000000.0 / us) << " tasks/s\n";
+}
+
+int main( int argc, char** argv )
+{
+   uint64_t iterations = argc > 1 ? strtoull( argv[1], nullptr, 10 ) : 100000;
+   uint32_t producers  = argc > 2 ? strtoul( argv[2], nullptr, 10 )  : 4;
+
+   fc::thread target("target");
+
+   {
+      fc::time_point start = fc::time_point::now();
+      for( uint64_t i = 0; i < iterations; ++i )
+         target.async( [](){}, "round_trip" ).wait();
+      report( "round trip", iterations, fc::time_point::now() - start );
+   }
+
+   {
+      boost::atomic<uint64_t> done(0);
+      fc::time_point start = fc::time_point::now();
+      for( uint64_t i = 0; i < iterations; ++i )
+         target.async( [&done](){ done.fetch_add(1, boost::memory_order_relaxed); }, "single_producer" );
+      target.async( [](){}, "drain" ).wait();
+      report( "1 producer throughput", done.load(), fc::time_point::now() - start );
+   }
+
+   {
+      boost::atomic<uint64_t> done(0);
+      std::vector<fc::thread*> threads;
+      for( uint32_t p = 0; p < producers; ++p )
+         threads.push_back( new fc::thread( "producer" ) );
+
+      fc::time_point start = fc::time_point::now();
+      std::vector<fc::future<void>> posted;
+      for( fc::thread* t : threads )
+         posted.push_back( t->async( [&target,&done,iterations](){
+            for( uint64_t i = 0; i < iterations; ++i )
+               target.async( [&done](){ done.fetch_add(1, boost::memory_order_relaxed); }, "multi_producer" );
+         }, "produce" ) );
+      for( fc::future<void>& f : posted )
+         f.wait();
+      while( done.load() < iterations * producers )
+         target.async( [](){}, "drain" ).wait();
+      report( (fc::to_string(uint64_t(producers)) + " producer throughput").c_str(), done.load(), fc::time_point::now() - start );
+
+      for( fc::thread* t : threads )
+         delete t;
+   }
+
+   target.quit();
+   return 0;
+}
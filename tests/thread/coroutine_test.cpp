@@ -0,0 +1,110 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/thread/coroutine.hpp>
+#include <fc/exception/exception.hpp>
+
+// built with -std=c++20 only, see CMakeLists.txt
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+namespace {
+   /** counts the frames that were unwound */
+   struct frame_guard
+   {
+      explicit frame_guard( int& d ):destroyed(d){}
+      ~frame_guard() { ++destroyed; }
+      int& destroyed;
+   };
+
+   fc::co_task<int> add( fc::future<int> a, fc::future<int> b )
+   {
+      const int x = co_await a;
+      const int y = co_await b;
+      co_return x + y;
+   }
+
+   fc::co_task<fc::thread*> resume_thread( fc::thread* other )
+   {
+      co_await other->async( [](){ fc::usleep( fc::milliseconds(10) ); }, "remote" );
+      co_return &fc::thread::current();
+   }
+
+   fc::co_task<> rethrow( fc::future<void> f )
+   {
+      co_await f;
+   }
+
+   fc::co_task<fc::microseconds> sleep_for( fc::microseconds d, int& destroyed )
+   {
+      frame_guard guard( destroyed );
+      const fc::time_point start = fc::time_point::now();
+      co_await fc::co_sleep( d );
+      co_return fc::time_point::now() - start;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(fc_coroutine)
+
+BOOST_AUTO_TEST_CASE( await_ready_and_pending_futures )
+{
+   fc::promise<int>::ptr ready( new fc::promise<int>( "ready" ) );
+   ready->set_value( 2 );
+   fc::promise<int>::ptr pending( new fc::promise<int>( "pending" ) );
+
+   fc::future<int> sum = add( fc::future<int>( ready ), fc::future<int>( pending ) );
+   // ran synchronously through the ready future and suspended on the pending one
+   BOOST_CHECK( !sum.ready() );
+   pending->set_value( 3 );
+   BOOST_CHECK_EQUAL( sum.wait(), 5 );
+}
+
+BOOST_AUTO_TEST_CASE( await_a_future_with_a_continuation )
+{
+   fc::promise<int>::ptr pending( new fc::promise<int>( "pending" ) );
+   fc::promise<int>::ptr ready( new fc::promise<int>( "ready" ) );
+   ready->set_value( 1 );
+   fc::future<int> shared( pending );
+   fc::future<int> doubled = shared.then( []( int v ){ return v * 2; } );
+
+   // awaiting adds a handler next to the continuation instead of replacing it
+   fc::future<int> sum = add( shared, fc::future<int>( ready ) );
+   pending->set_value( 4 );
+   BOOST_CHECK_EQUAL( sum.wait( fc::seconds(1) ), 5 );
+   BOOST_CHECK_EQUAL( doubled.wait( fc::seconds(1) ), 8 );
+}
+
+BOOST_AUTO_TEST_CASE( resumes_on_originating_thread )
+{
+   fc::thread other( "coroutine_test" );
+   fc::thread* origin = &fc::thread::current();
+   BOOST_CHECK( resume_thread( &other ).get_future().wait() == origin );
+
+   // and a coroutine started on another thread comes back there
+   fc::future<fc::thread*> there = other.async( [&](){ return resume_thread( origin ).get_future().wait(); } );
+   BOOST_CHECK( there.wait() == &other );
+   other.quit();
+}
+
+BOOST_AUTO_TEST_CASE( exceptions_propagate )
+{
+   fc::future<void> failing = fc::async( [](){ FC_THROW_EXCEPTION( fc::invalid_arg_exception, "boom" ); } );
+   BOOST_CHECK_THROW( rethrow( failing ).get_future().wait(), fc::invalid_arg_exception );
+}
+
+BOOST_AUTO_TEST_CASE( co_sleep )
+{
+   int destroyed = 0;
+   BOOST_CHECK( sleep_for( fc::milliseconds(20), destroyed ).get_future().wait() >= fc::milliseconds(20) );
+   BOOST_CHECK_EQUAL( destroyed, 1 );
+
+   // a thread that quits during the sleep fails the coroutine and unwinds its frame
+   fc::thread* sleeper = new fc::thread( "co_sleep" );
+   fc::future<fc::microseconds> slept = sleeper->async( [&](){ return sleep_for( fc::seconds(60), destroyed ).get_future(); } ).wait();
+   sleeper->quit();
+   delete sleeper;
+   BOOST_CHECK_THROW( slept.wait(), fc::canceled_exception );
+   BOOST_CHECK_EQUAL( destroyed, 2 );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif
@@ -0,0 +1,99 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/thread/thread.hpp>
+#include <fc/thread/future.hpp>
+#include <fc/exception/exception.hpp>
+
+#include <string>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(fc_future)
+
+BOOST_AUTO_TEST_CASE( ready_futures_and_continuations )
+{
+  fc::future<int> ready = fc::make_ready_future( 20 );
+  BOOST_CHECK( ready.valid() );
+  BOOST_CHECK( ready.ready() );
+  BOOST_CHECK_EQUAL( ready.wait(), 20 );
+  BOOST_CHECK( !ready.canceled() );
+  static_assert( sizeof(fc::future<std::string>) == sizeof(void*), "a future is just its promise pointer" );
+
+  // a ready future runs an inline continuation right away
+  fc::future<std::string> text = ready.then( []( int v ){ return std::to_string( v + 1 ); } );
+  BOOST_CHECK( text.ready() );
+  BOOST_CHECK_EQUAL( text.wait(), "21" );
+
+  fc::thread worker( "then_worker" );
+  fc::future<int> chained = worker.async( [](){ fc::usleep( fc::milliseconds(10) ); return 1; } )
+     .then( []( int v ){ return v * 2; } )
+     .then( [&worker]( int v ){
+        BOOST_CHECK( &fc::thread::current() == &worker );
+        return worker.async( [v](){ return v + 3; } );
+     }, worker );
+  BOOST_CHECK_EQUAL( chained.wait(), 5 );
+
+  bool ran = false;
+  fc::future<void> after = worker.async( [](){ FC_THROW( "oops" ); } ).then( [&](){ ran = true; } );
+  BOOST_CHECK_THROW( after.wait(), fc::exception );
+  BOOST_CHECK( !ran );
+}
+
+BOOST_AUTO_TEST_CASE( when_all_collects_values )
+{
+  fc::thread worker( "when_all_worker" );
+  std::vector<fc::future<int>> parts;
+  for( int i = 0; i < 5; ++i )
+    parts.push_back( worker.async( [i](){ fc::usleep( fc::milliseconds(5 - i) ); return i; } ) );
+  parts.push_back( fc::make_ready_future( 5 ) );
+
+  std::vector<int> values = fc::when_all( parts ).wait();
+  BOOST_REQUIRE_EQUAL( values.size(), 6u );
+  for( int i = 0; i < 6; ++i )
+    BOOST_CHECK_EQUAL( values[i], i );
+
+  fc::future<void> mixed = fc::when_all( worker.async( [](){ return std::string("a"); } ),
+                                         worker.async( [](){ fc::usleep( fc::milliseconds(5) ); } ),
+                                         fc::make_ready_future( 1 ) );
+  mixed.wait();
+
+  std::vector<fc::future<int>> failing;
+  failing.push_back( worker.async( [](){ fc::usleep( fc::seconds(5) ); return 0; } ) );
+  failing.push_back( worker.async( []() -> int { FC_THROW( "oops" ); } ) );
+  // fails as soon as one part does, without waiting for the slow one
+  fc::time_point start = fc::time_point::now();
+  BOOST_CHECK_THROW( fc::when_all( failing ).wait(), fc::exception );
+  BOOST_CHECK_LT( (fc::time_point::now() - start).count(), 1000000 );
+  failing[0].cancel_and_wait();
+}
+
+BOOST_AUTO_TEST_CASE( several_handlers_on_one_future )
+{
+  fc::promise<int>::ptr p( new fc::promise<int>( "shared" ) );
+  fc::future<int> f( p );
+
+  // two continuations, when_all over the same future twice and over one that has them
+  fc::future<int> plus_one = f.then( []( int v ){ return v + 1; } );
+  fc::future<int> times_two = f.then( []( int v ){ return v * 2; } );
+  std::vector<fc::future<int>> twice( 2, f );
+  fc::future<std::vector<int>> both = fc::when_all( twice );
+  std::vector<int> order;
+  f.on_complete( [&order]( const int&, const fc::exception_ptr& ){ order.push_back( 1 ); } );
+  f.on_complete( [&order]( const int&, const fc::exception_ptr& ){ order.push_back( 2 ); } );
+  BOOST_CHECK( !plus_one.ready() );
+
+  p->set_value( 10 );
+  BOOST_CHECK_EQUAL( plus_one.wait( fc::seconds(1) ), 11 );
+  BOOST_CHECK_EQUAL( times_two.wait( fc::seconds(1) ), 20 );
+  const std::vector<int> values = both.wait( fc::seconds(1) );
+  BOOST_REQUIRE_EQUAL( values.size(), 2u );
+  BOOST_CHECK_EQUAL( values[0], 10 );
+  BOOST_CHECK_EQUAL( values[1], 10 );
+  BOOST_REQUIRE_EQUAL( order.size(), 2u );
+  BOOST_CHECK_EQUAL( order[0], 1 );
+  BOOST_CHECK_EQUAL( order[1], 2 );
+
+  // installed after it completed, they run right away
+  BOOST_CHECK_EQUAL( f.then( []( int v ){ return v - 1; } ).wait(), 9 );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
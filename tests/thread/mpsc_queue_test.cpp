@@ -0,0 +1,87 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../../src/thread/mpsc_queue.hpp"
+
+#include <boost/thread.hpp>
+
+#include <vector>
+
+namespace {
+  struct node
+  {
+    node():producer(0),sequence(0),next(nullptr){}
+
+    int   producer;
+    int   sequence;
+    node* next;
+  };
+
+  typedef fc::mpsc_queue<node, &node::next> queue;
+}
+
+BOOST_AUTO_TEST_SUITE(fc_mpsc_queue)
+
+BOOST_AUTO_TEST_CASE( pop_all_returns_posting_order )
+{
+  queue q;
+  BOOST_CHECK( q.empty() );
+  BOOST_CHECK( q.pop_all() == nullptr );
+
+  node nodes[5];
+  for( int i = 0; i < 5; ++i )
+  {
+    nodes[i].sequence = i;
+    // only the push onto an empty queue reports it, that is when a parked consumer needs a wakeup
+    BOOST_CHECK_EQUAL( q.push( &nodes[i] ), i == 0 );
+  }
+  BOOST_CHECK( !q.empty() );
+
+  int expected = 0;
+  for( node* n = q.pop_all(); n; n = n->next )
+    BOOST_CHECK_EQUAL( n->sequence, expected++ );
+  BOOST_CHECK_EQUAL( expected, 5 );
+  BOOST_CHECK( q.empty() );
+
+  // the queue starts over empty
+  BOOST_CHECK( q.push( &nodes[3] ) );
+  BOOST_CHECK( q.pop_all() == &nodes[3] );
+  BOOST_CHECK( nodes[3].next == nullptr );
+}
+
+BOOST_AUTO_TEST_CASE( concurrent_producers )
+{
+  const int producers = 4;
+  const int per_producer = 20000;
+  queue q;
+  std::vector<std::vector<node>> nodes( producers, std::vector<node>( per_producer ) );
+
+  boost::thread_group group;
+  for( int p = 0; p < producers; ++p )
+    group.create_thread( [&q,&nodes,p,per_producer](){
+      for( int i = 0; i < per_producer; ++i )
+      {
+        nodes[p][i].producer = p;
+        nodes[p][i].sequence = i;
+        q.push( &nodes[p][i] );
+      }
+    } );
+
+  // drain while they push, every producer's nodes must come out complete and in order
+  std::vector<int> next( producers, 0 );
+  int received = 0;
+  while( received < producers * per_producer )
+  {
+    for( node* n = q.pop_all(); n; n = n->next )
+    {
+      BOOST_REQUIRE_EQUAL( n->sequence, next[n->producer] );
+      ++next[n->producer];
+      ++received;
+    }
+  }
+  group.join_all();
+  BOOST_CHECK( q.empty() );
+  for( int p = 0; p < producers; ++p )
+    BOOST_CHECK_EQUAL( next[p], per_producer );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
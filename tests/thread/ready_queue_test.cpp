@@ -0,0 +1,100 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../../src/thread/ready_queue.hpp"
+
+#include <vector>
+
+namespace {
+  struct node
+  {
+    node( int p = 0, int s = 0 ):prio(p),sequence(s){}
+
+    fc::priority prio;
+    int          sequence;
+  };
+
+  typedef fc::ready_queue<node, &node::prio> queue;
+}
+
+BOOST_AUTO_TEST_SUITE(fc_ready_queue)
+
+BOOST_AUTO_TEST_CASE( highest_priority_first_then_fifo )
+{
+  queue q;
+  BOOST_CHECK( q.empty() );
+
+  // interleaved priorities, several nodes each
+  std::vector<node> nodes;
+  const int prios[] = { 0, 5, -3, 0, 5, 10000, -3, 0 };
+  for( int i = 0; i < 8; ++i )
+    nodes.push_back( node( prios[i], i ) );
+  for( node& n : nodes )
+    q.push( &n );
+  BOOST_CHECK_EQUAL( q.size(), 8u );
+  BOOST_CHECK( q.contains( &nodes[2] ) );
+
+  const int expected[] = { 5, 1, 4, 0, 3, 7, 2, 6 };
+  for( int i = 0; i < 8; ++i )
+  {
+    BOOST_REQUIRE( !q.empty() );
+    BOOST_CHECK( q.front() == &nodes[expected[i]] );
+    BOOST_CHECK_EQUAL( q.pop_front()->sequence, expected[i] );
+  }
+  BOOST_CHECK( q.empty() );
+  BOOST_CHECK( !q.contains( &nodes[2] ) );
+}
+
+BOOST_AUTO_TEST_CASE( rings_grow_and_wrap )
+{
+  queue q;
+  std::vector<node> nodes( 100 );
+  for( int i = 0; i < 100; ++i )
+    nodes[i].sequence = i;
+
+  // keep the ring partly full while pushing, so it wraps before it grows
+  int next_in = 0, next_out = 0;
+  for( int round = 0; round < 10; ++round )
+  {
+    for( int i = 0; i < 10 && next_in < 100; ++i )
+      q.push( &nodes[next_in++] );
+    for( int i = 0; i < 5; ++i )
+      BOOST_CHECK_EQUAL( q.pop_front()->sequence, next_out++ );
+  }
+  while( !q.empty() )
+    BOOST_CHECK_EQUAL( q.pop_front()->sequence, next_out++ );
+  BOOST_CHECK_EQUAL( next_out, 100 );
+}
+
+BOOST_AUTO_TEST_CASE( empty_levels_make_room_for_new_priorities )
+{
+  queue q;
+  // more distinct priorities over time than there are levels, never at once
+  std::vector<node> nodes;
+  nodes.reserve( 3 * queue::max_levels );
+  for( int i = 0; i < 3 * queue::max_levels; ++i )
+    nodes.push_back( node( i % 2 ? i : -i, i ) );
+  for( size_t i = 0; i < nodes.size(); i += 2 )
+  {
+    q.push( &nodes[i] );
+    q.push( &nodes[i+1] );
+    // the odd one has the higher priority
+    BOOST_CHECK_EQUAL( q.pop_front()->sequence, int(i + 1) );
+    BOOST_CHECK_EQUAL( q.pop_front()->sequence, int(i) );
+  }
+  BOOST_CHECK( q.empty() );
+
+  // a node left waiting keeps its place while the empty levels around it are dropped
+  node stays( -1000000, -1 );
+  q.push( &stays );
+  for( size_t i = 0; i < nodes.size(); ++i )
+  {
+    q.push( &nodes[i] );
+    BOOST_CHECK( q.pop_front() == &nodes[i] );
+    BOOST_REQUIRE( q.front() == &stays );
+  }
+  BOOST_CHECK_EQUAL( q.size(), 1u );
+  q.clear();
+  BOOST_CHECK( q.empty() );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,150 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/thread/thread.hpp>
+#include <fc/thread/shared_mutex.hpp>
+#include <fc/thread/semaphore.hpp>
+#include <fc/thread/scoped_lock.hpp>
+#include <fc/thread/spin_yield_lock.hpp>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(fc_thread_locks)
+
+BOOST_AUTO_TEST_CASE( readers_share_writers_exclude )
+{
+  fc::shared_mutex m;
+  std::atomic<int> readers(0);
+  std::atomic<int> max_readers(0);
+  std::atomic<bool> writer_saw_reader(false);
+
+  std::vector<fc::future<void>> done;
+  for( int i = 0; i < 4; ++i )
+    done.push_back( fc::async( [&](){
+      fc::shared_lock<fc::shared_mutex> l(m);
+      int now = ++readers;
+      if( now > max_readers ) max_readers = now;
+      fc::usleep( fc::milliseconds(20) );
+      --readers;
+    }, "reader" ) );
+  done.push_back( fc::async( [&](){
+    fc::scoped_lock<fc::shared_mutex> l(m);
+    if( readers ) writer_saw_reader = true;
+  }, "writer" ) );
+
+  for( auto& f : done )
+    f.wait();
+  BOOST_CHECK_EQUAL( max_readers.load(), 4 );
+  BOOST_CHECK( !writer_saw_reader );
+}
+
+BOOST_AUTO_TEST_CASE( waiting_writer_goes_before_later_readers )
+{
+  fc::shared_mutex m;
+  fc::thread other( "lock_thread" );
+  std::string order;
+
+  m.lock_shared();
+  fc::future<void> writer = other.async( [&](){
+    fc::scoped_lock<fc::shared_mutex> l(m);
+    order += 'w';
+  }, "writer" );
+  while( m.try_lock_shared() ) // wait for the writer to queue up
+  {
+    m.unlock_shared();
+    fc::usleep( fc::milliseconds(1) );
+  }
+  fc::future<void> reader = fc::async( [&](){
+    fc::shared_lock<fc::shared_mutex> l(m);
+    order += 'r';
+  }, "reader" );
+  fc::yield();
+  BOOST_CHECK_EQUAL( order, "" );
+
+  m.unlock_shared();
+  writer.wait();
+  reader.wait();
+  BOOST_CHECK_EQUAL( order, "wr" );
+}
+
+BOOST_AUTO_TEST_CASE( semaphore_limits_concurrency )
+{
+  fc::semaphore slots(2);
+  fc::thread other( "semaphore_thread" );
+  std::atomic<int> inside(0);
+  std::atomic<int> max_inside(0);
+
+  std::vector<fc::future<void>> done;
+  for( int i = 0; i < 8; ++i )
+  {
+    auto work = [&](){
+      slots.wait();
+      int now = ++inside;
+      if( now > max_inside ) max_inside = now;
+      fc::usleep( fc::milliseconds(15) );
+      --inside;
+      slots.post();
+    };
+    done.push_back( i % 2 ? other.async( work, "semaphore_user" ) : fc::async( work, "semaphore_user" ) );
+  }
+  for( auto& f : done )
+    f.wait();
+
+  BOOST_CHECK_EQUAL( max_inside.load(), 2 );
+  BOOST_CHECK( slots.try_wait() );
+  BOOST_CHECK( slots.try_wait() );
+  BOOST_CHECK( !slots.try_wait() );
+}
+
+BOOST_AUTO_TEST_CASE( semaphore_wakes_waiters_in_order )
+{
+  fc::semaphore sem;
+  std::string order;
+  std::vector<fc::future<void>> done;
+  for( char c = 'a'; c < 'e'; ++c )
+    done.push_back( fc::async( [&sem,&order,c](){ sem.wait(); order += c; }, "waiter" ) );
+  fc::yield();
+  BOOST_CHECK_EQUAL( order, "" );
+
+  sem.post( 4 );
+  for( auto& f : done )
+    f.wait();
+  BOOST_CHECK_EQUAL( order, "abcd" );
+}
+
+BOOST_AUTO_TEST_CASE( spin_yield_lock_under_contention )
+{
+  fc::spin_yield_lock l;
+  fc::thread a( "spin_thread_a" );
+  fc::thread b( "spin_thread_b" );
+  uint64_t counter = 0;
+
+  auto hammer = [&](){
+    for( int i = 0; i < 20000; ++i )
+    {
+      fc::scoped_lock<fc::spin_yield_lock> guard(l);
+      ++counter;
+      if( i % 1000 == 0 )
+        fc::yield(); // let fibers of the same thread run into the held lock too
+    }
+  };
+  std::vector<fc::future<void>> done;
+  for( int i = 0; i < 2; ++i )
+  {
+    done.push_back( a.async( hammer, "spin_a" ) );
+    done.push_back( b.async( hammer, "spin_b" ) );
+  }
+  for( auto& f : done )
+    f.wait();
+  BOOST_CHECK_EQUAL( counter, 80000u );
+
+#ifndef NDEBUG
+  fc::spin_yield_lock::stats s = l.get_stats();
+  BOOST_CHECK_EQUAL( s.acquisitions, 80000u );
+  BOOST_CHECK_GT( s.contended, 0u );
+  BOOST_CHECK_GT( s.yields, 0u );
+#endif
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,29 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/thread/thread.hpp>
+
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(fc_stack_pool)
+
+BOOST_AUTO_TEST_CASE( tasks_with_small_stacks )
+{
+  // lots of fibers blocked at once, half of them on small stacks
+  fc::promise<void>::ptr go( new fc::promise<void>("go") );
+  fc::future<void> go_future( go );
+  std::vector<fc::future<int>> tasks;
+  for( int i = 0; i < 2000; ++i )
+    tasks.push_back( fc::async( [go_future,i]() mutable {
+      char buffer[1024];
+      buffer[0] = char(i);
+      go_future.wait();
+      return int(buffer[0]) + i - char(i);
+    }, "small_stack_task", fc::priority(), i % 2 ? 64 * 1024 : 0 ) );
+
+  fc::usleep( fc::milliseconds(100) );
+  go->set_value();
+  for( int i = 0; i < 2000; ++i )
+    BOOST_CHECK_EQUAL( tasks[i].wait(), i );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
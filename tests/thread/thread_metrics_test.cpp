@@ -0,0 +1,25 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/thread/thread.hpp>
+#include <fc/variant_object.hpp>
+
+BOOST_AUTO_TEST_SUITE(fc_thread_metrics)
+
+BOOST_AUTO_TEST_CASE( scheduler_metrics )
+{
+  fc::thread worker( "metrics_worker" );
+  for( int i = 0; i < 10; ++i )
+    worker.async( [](){ fc::usleep( fc::milliseconds(20) ); }, "metrics_task" ).wait();
+
+  fc::variant_object metrics = worker.get_metrics();
+  BOOST_CHECK_EQUAL( metrics["name"].as_string(), "metrics_worker" );
+  BOOST_CHECK_GE( metrics["tasks_run"].as_uint64(), 10u );
+  BOOST_CHECK_GE( metrics["context_switches"].as_uint64(), 10u );
+  BOOST_CHECK_GE( metrics["idle_time_us"].as_uint64(), 100000u );
+  fc::variant_object run_time = metrics["run_time_us"].get_object();
+  BOOST_CHECK_GE( run_time["count"].as_uint64(), 10u );
+  BOOST_CHECK_GE( run_time["p50_below_us"].as_uint64(), 16384u );
+  worker.log_metrics();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
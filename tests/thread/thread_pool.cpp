@@ -0,0 +1,139 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/thread/thread_pool.hpp>
+#include <fc/thread/parallel.hpp>
+#include <fc/exception/exception.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(fc_thread_pool)
+
+BOOST_AUTO_TEST_CASE( run_tasks_on_pool )
+{
+  fc::thread_pool pool( 4, "test_pool" );
+  BOOST_CHECK_EQUAL( pool.size(), 4u );
+
+  std::vector<fc::future<int>> results;
+  for( int i = 0; i < 100; ++i )
+    results.push_back( pool.async( [i](){ return i * 2; }, "double" ) );
+
+  for( int i = 0; i < 100; ++i )
+    BOOST_CHECK_EQUAL( results[i].wait(), i * 2 );
+}
+
+BOOST_AUTO_TEST_CASE( idle_worker_steals_queued_task )
+{
+  fc::thread_pool pool( 2, "steal_pool" );
+
+  // both tasks are queued on worker 0 because they are posted from it.  The first
+  // one never yields, so the second one can only finish if worker 1 steals it.
+  fc::thread* ran_on[2] = { nullptr, nullptr };
+  pool.get_thread(0).async( [&](){
+    fc::future<void> busy = pool.async( [&](){
+      ran_on[0] = &fc::thread::current();
+      fc::time_point end = fc::time_point::now() + fc::milliseconds(300);
+      while( fc::time_point::now() < end ) {}
+    }, "busy" );
+    fc::future<void> quick = pool.async( [&](){ ran_on[1] = &fc::thread::current(); }, "quick" );
+    busy.wait();
+    quick.wait();
+  }, "post_from_worker" ).wait();
+
+  BOOST_REQUIRE( ran_on[0] && ran_on[1] );
+  BOOST_CHECK( ran_on[0] != ran_on[1] );
+}
+
+BOOST_AUTO_TEST_CASE( schedule_on_pool )
+{
+  fc::thread_pool pool( 2, "schedule_pool" );
+  fc::time_point start = fc::time_point::now();
+  fc::future<fc::time_point> ran = pool.schedule( [](){ return fc::time_point::now(); },
+                                                  start + fc::milliseconds(200), "scheduled" );
+  BOOST_CHECK( ran.wait() >= start + fc::milliseconds(200) );
+
+  fc::future<void> canceled = pool.schedule( [](){}, fc::time_point::now() + fc::seconds(60), "never" );
+  canceled.cancel( "test cancel" );
+  pool.quit();
+  BOOST_CHECK( canceled.canceled() );
+}
+
+BOOST_AUTO_TEST_CASE( parallel_for_visits_every_index )
+{
+  fc::thread_pool pool( 3, "parallel_pool" );
+  std::vector<uint64_t> squares( 10000 );
+  fc::parallel_for( size_t(0), squares.size(), [&]( size_t i ){ squares[i] = i * i; }, 64, pool );
+  for( size_t i = 0; i < squares.size(); ++i )
+    BOOST_REQUIRE_EQUAL( squares[i], i * i );
+
+  BOOST_CHECK_THROW( fc::parallel_for( 0, 1000, []( int i ){ if( i == 500 ) FC_THROW( "bad element" ); }, 10, pool ),
+                     fc::exception );
+}
+
+BOOST_AUTO_TEST_CASE( parallel_transform_reduce_keeps_order )
+{
+  std::vector<int> v( 5000 );
+  for( size_t i = 0; i < v.size(); ++i )
+    v[i] = int(i % 10);
+
+  uint64_t sum = fc::parallel_transform_reduce( v.begin(), v.end(), uint64_t(0),
+                                                []( uint64_t a, uint64_t b ){ return a + b; },
+                                                []( int x ){ return uint64_t(x) * x; }, 100 );
+  BOOST_CHECK_EQUAL( sum, 500u * 285u );
+
+  // concatenation is associative but not commutative
+  std::string digits = fc::parallel_transform_reduce( v.begin(), v.end(), std::string(">"),
+                                                      []( std::string a, const std::string& b ){ return a + b; },
+                                                      []( int x ){ return std::string( 1, char('0' + x) ); }, 100 );
+  std::string expected = ">";
+  for( int x : v )
+    expected += char('0' + x);
+  BOOST_CHECK( digits == expected );
+}
+
+BOOST_AUTO_TEST_CASE( parallel_sort_sorts )
+{
+  std::vector<uint32_t> v( 100000 );
+  uint32_t x = 12345;
+  for( auto& e : v )
+    e = x = x * 1103515245u + 12345u;
+  std::vector<uint32_t> expected = v;
+  std::sort( expected.begin(), expected.end() );
+
+  fc::parallel_sort( v.begin(), v.end(), std::less<uint32_t>(), 1000 );
+  BOOST_CHECK( v == expected );
+
+  fc::parallel_sort( v.begin(), v.end(), std::greater<uint32_t>(), 777 );
+  BOOST_CHECK( std::equal( v.begin(), v.end(), expected.rbegin() ) );
+}
+
+BOOST_AUTO_TEST_CASE( canceled_parallel_for_waits_for_its_chunks )
+{
+  fc::thread_pool pool( 2, "cancel_pool" );
+  std::atomic<int> finished( 0 );
+  int finished_at_return = -1;
+  fc::future<void> caller = fc::async( [&](){
+    std::vector<int> touched( 2 );
+    try
+    {
+      // the cancellation interrupts the wait for the first, slowest chunk
+      fc::parallel_for( 0, 2, [&]( int i ){
+        fc::usleep( fc::milliseconds( i == 0 ? 150 : 50 ) );
+        touched[i] = 1;
+        ++finished;
+      }, 1, pool );
+    }
+    catch( const fc::canceled_exception& )
+    {
+      finished_at_return = finished.load();
+      throw;
+    }
+  }, "parallel_for caller" );
+  fc::usleep( fc::milliseconds(20) );
+  caller.cancel_and_wait( "test" );
+  BOOST_CHECK_EQUAL( finished_at_return, 2 );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,140 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/thread/thread.hpp>
+#include <fc/exception/exception.hpp>
+
+#include "../../src/thread/timer_wheel.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+  struct timer
+  {
+    timer( const fc::time_point& w ):when(w){}
+
+    fc::detail::timer_hook<timer> hook;
+    fc::time_point                when;
+  };
+
+  typedef fc::timer_wheel<timer, &timer::hook, &timer::when> wheel;
+
+  /** a time on a root rotation boundary after now, the wheel counts its ticks from there */
+  fc::time_point rotation_start()
+  {
+    const int64_t rotation_us = 256 * 1000;
+    return fc::time_point( fc::microseconds( (fc::time_point::now().time_since_epoch().count() / rotation_us + 1) * rotation_us ) );
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(fc_timer_wheel)
+
+BOOST_AUTO_TEST_CASE( next_deadline_sees_levels_behind_the_root )
+{
+  wheel w;
+  std::vector<timer*> expired;
+  const fc::time_point start = rotation_start();
+  w.expire( start, expired ); // nothing in it, only moves the wheel to start
+
+  timer a( start + fc::milliseconds(50) );   // root
+  timer t2( start + fc::milliseconds(300) ); // level 0, cascaded at tick 256
+  w.insert( &a );
+  w.insert( &t2 );
+  w.expire( start + fc::milliseconds(100), expired );
+  BOOST_REQUIRE_EQUAL( expired.size(), 1u );
+  BOOST_CHECK( expired.front() == &a );
+
+  timer t1( start + fc::milliseconds(350) ); // root again
+  w.insert( &t1 );
+  // the root slot of t1 must not hide the cascade t2 is waiting for
+  BOOST_CHECK( w.next_deadline() <= t2.when );
+
+  expired.clear();
+  w.expire( t2.when, expired );
+  BOOST_REQUIRE_EQUAL( expired.size(), 1u );
+  BOOST_CHECK( expired.front() == &t2 );
+  BOOST_CHECK( w.next_deadline() == t1.when );
+
+  expired.clear();
+  w.clear( expired );
+  BOOST_CHECK_EQUAL( expired.size(), 1u );
+  BOOST_CHECK( w.empty() );
+}
+
+BOOST_AUTO_TEST_CASE( next_deadline_never_passes_the_earliest_timer )
+{
+  wheel w;
+  std::vector<timer*> expired;
+  fc::time_point now = rotation_start();
+  w.expire( now, expired );
+
+  std::srand( 42 );
+  std::vector<timer*> pending;
+  for( int step = 0; step < 2000; ++step )
+  {
+    // deadlines from the root out to the second level
+    for( int i = std::rand() % 3; i > 0; --i )
+    {
+      pending.push_back( new timer( now + fc::microseconds( int64_t(std::rand() % 20000) * 1000 + std::rand() % 1000 ) ) );
+      w.insert( pending.back() );
+    }
+    if( !pending.empty() && std::rand() % 4 == 0 )
+    {
+      const size_t i = std::rand() % pending.size();
+      BOOST_CHECK( w.remove( pending[i] ) );
+      delete pending[i];
+      pending.erase( pending.begin() + i );
+    }
+
+    fc::time_point earliest = fc::time_point::maximum();
+    for( timer* t : pending )
+      earliest = std::min( earliest, t->when );
+    BOOST_REQUIRE( w.next_deadline() <= earliest );
+
+    // jump to the wheel's own answer, whatever is due by then has to come out
+    if( w.next_deadline() != fc::time_point::maximum() )
+      now = std::max( now, w.next_deadline() );
+    now += fc::milliseconds( std::rand() % 3 );
+    expired.clear();
+    w.expire( now, expired );
+    for( timer* t : expired )
+    {
+      BOOST_CHECK( t->when <= now );
+      pending.erase( std::find( pending.begin(), pending.end(), t ) );
+      delete t;
+    }
+    for( timer* t : pending )
+      BOOST_REQUIRE( t->when > now );
+  }
+  expired.clear();
+  w.clear( expired );
+  BOOST_CHECK_EQUAL( expired.size(), pending.size() );
+  for( timer* t : pending )
+    delete t;
+}
+
+BOOST_AUTO_TEST_CASE( scheduled_tasks_run_in_time_order )
+{
+  // spread the deadlines past the first rotation of the timer wheel so some of
+  // them have to be cascaded down before they fire
+  std::vector<int> order;
+  std::vector<fc::future<void>> tasks;
+  fc::time_point start = fc::time_point::now();
+  for( int i = 9; i >= 0; --i )
+    tasks.push_back( fc::schedule( [&order,i](){ order.push_back(i); },
+                                   start + fc::milliseconds(100 + 70 * i), "ordered_task" ) );
+  fc::future<void> far_away = fc::schedule( [](){}, start + fc::seconds(3600), "far_away_task" );
+
+  for( fc::future<void>& t : tasks )
+    t.wait();
+  BOOST_REQUIRE_EQUAL( order.size(), 10u );
+  for( int i = 0; i < 10; ++i )
+    BOOST_CHECK_EQUAL( order[i], i );
+
+  // canceling a task that is still waiting for its time should finish it right away
+  far_away.cancel( "test cancel" );
+  BOOST_CHECK_THROW( far_away.wait( fc::seconds(1) ), fc::canceled_exception );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
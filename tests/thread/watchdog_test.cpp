@@ -0,0 +1,73 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/thread/thread.hpp>
+#include <fc/thread/watchdog.hpp>
+#include <fc/variant_object.hpp>
+
+#ifdef __linux__
+# include <signal.h>
+# include <string.h>
+#endif
+
+BOOST_AUTO_TEST_SUITE(fc_watchdog)
+
+#ifdef __linux__
+namespace {
+  volatile sig_atomic_t urgent_signals = 0;
+  void count_urgent_signal( int ) { ++urgent_signals; }
+}
+
+// first in the file, the watchdog installs its handler once per process
+BOOST_AUTO_TEST_CASE( watchdog_passes_on_foreign_sigurg )
+{
+  struct sigaction sa, old;
+  sigaction( SIGURG, nullptr, &old );
+  if( old.sa_handler != SIG_DFL )
+  {
+    BOOST_TEST_MESSAGE( "SIGURG is already taken, skipping" );
+    return;
+  }
+  // the application's handler, installed before the first watchdog
+  memset( &sa, 0, sizeof(sa) );
+  sa.sa_handler = &count_urgent_signal;
+  sigemptyset( &sa.sa_mask );
+  sigaction( SIGURG, &sa, nullptr );
+
+  {
+    fc::watchdog dog( fc::milliseconds(20), fc::milliseconds(5) );
+    fc::thread worker( "stalled_worker" );
+    worker.async( [](){
+       fc::time_point end = fc::time_point::now() + fc::milliseconds(100);
+       while( fc::time_point::now() < end ) {}
+    }, "stalled_task" ).wait();
+  }
+
+  // a SIGURG the watchdog did not send still reaches the application
+  const int before = urgent_signals;
+  raise( SIGURG );
+  BOOST_CHECK_EQUAL( urgent_signals, before + 1 );
+}
+#endif
+
+BOOST_AUTO_TEST_CASE( watchdog_measures_non_yielding_time )
+{
+  fc::watchdog dog( fc::milliseconds(50), fc::milliseconds(10) );
+  fc::thread worker( "watchdog_worker" );
+  worker.async( [](){
+     // hog the thread without ever yielding
+     fc::time_point end = fc::time_point::now() + fc::milliseconds(200);
+     while( fc::time_point::now() < end ) {}
+  }, "busy_task" ).wait();
+  worker.async( [](){}, "quick_task" ).wait();
+  // the slice of a task closes just after its promise is set, let the worker get past it
+  worker.async( [](){} ).wait();
+
+  fc::variant_object times = dog.non_yielding_time();
+  BOOST_REQUIRE( times.contains( "busy_task" ) );
+  BOOST_CHECK_GE( times["busy_task"].get_object()["max_us"].as_uint64(), 200000u );
+  BOOST_CHECK_GE( times["busy_task"].get_object()["count"].as_uint64(), 1u );
+  BOOST_REQUIRE( times.contains( "quick_task" ) );
+  BOOST_CHECK_LT( times["quick_task"].get_object()["max_us"].as_uint64(), 50000u );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,29 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/reflect/typename.hpp>
+#include <fc/static_variant.hpp>
+
+#include <string.h>
+
+namespace {
+   struct unnamed_type { int32_t value; };
+}
+
+BOOST_AUTO_TEST_SUITE(fc_reflect)
+
+BOOST_AUTO_TEST_CASE( composed_typenames )
+{
+   typedef std::vector<std::map<fc::string,int32_t>> nested_type;
+   const char* n = fc::get_typename<nested_type>::name();
+   BOOST_CHECK_EQUAL( n, "std::vector<std::map<string,int32_t>>" );
+   BOOST_CHECK( fc::get_typename<nested_type>::name() == n );
+
+   typedef fc::static_variant<int32_t, fc::string, std::vector<bool>> variant_type;
+   BOOST_CHECK_EQUAL( fc::get_typename<variant_type>::name(), "fc::static_variant<int32_t,string,std::vector<bool>>" );
+   BOOST_CHECK( fc::get_typename<variant_type>::name() == fc::get_typename<variant_type>::name() );
+
+   // types without a get_typename<> of their own still have a name
+   BOOST_CHECK( strlen( fc::get_typename<unnamed_type>::name() ) > 0 );
+}
+
+BOOST_AUTO_TEST_SUITE_END()